@@ -0,0 +1,53 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ABWDOCUMENTHANDLE_H
+#define ABWDOCUMENTHANDLE_H
+
+#include <librevenge/librevenge.h>
+
+#include "libabw_api.h"
+
+namespace libabw
+{
+
+class AbiDocument;
+
+/**
+A document parsed by AbiDocument::load. It can be written to any number
+of librevenge::RVNGTextInterface implementations without parsing the
+document again. Writing does not change the handle, so several threads
+may write the same handle at the same time.
+*/
+class ABWAPI ABWDocumentHandle
+{
+  friend class AbiDocument;
+
+public:
+  ~ABWDocumentHandle();
+
+  /** Makes the same callbacks to @a textInterface that AbiDocument::parse
+    * would have made.
+    */
+  bool write(librevenge::RVNGTextInterface *textInterface) const;
+
+private:
+  struct Impl;
+
+  explicit ABWDocumentHandle(Impl *impl);
+  ABWDocumentHandle(const ABWDocumentHandle &);
+  ABWDocumentHandle &operator=(const ABWDocumentHandle &);
+
+  Impl *m_impl;
+};
+
+} // namespace libabw
+
+#endif /* ABWDOCUMENTHANDLE_H */
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,104 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ABWEVENT_H
+#define ABWEVENT_H
+
+#include <librevenge/librevenge.h>
+
+#include "libabw_api.h"
+
+namespace libabw
+{
+
+class ABWEventReader;
+
+/**
+One callback of librevenge::RVNGTextInterface, as read by ABWEventReader.
+*/
+class ABWAPI ABWEvent
+{
+  friend class ABWEventReader;
+
+public:
+  /** The callbacks libabw makes. */
+  enum Type
+  {
+    ABW_CLOSE_ENDNOTE,
+    ABW_CLOSE_FOOTER,
+    ABW_CLOSE_FOOTNOTE,
+    ABW_CLOSE_FRAME,
+    ABW_CLOSE_HEADER,
+    ABW_CLOSE_LINK,
+    ABW_CLOSE_LIST_ELEMENT,
+    ABW_CLOSE_ORDERED_LIST_LEVEL,
+    ABW_CLOSE_PAGE_SPAN,
+    ABW_CLOSE_PARAGRAPH,
+    ABW_CLOSE_SECTION,
+    ABW_CLOSE_SPAN,
+    ABW_CLOSE_TABLE,
+    ABW_CLOSE_TABLE_CELL,
+    ABW_CLOSE_TABLE_ROW,
+    ABW_CLOSE_UNORDERED_LIST_LEVEL,
+    ABW_END_DOCUMENT,
+    ABW_INSERT_BINARY_OBJECT,
+    ABW_INSERT_COVERED_TABLE_CELL,
+    ABW_INSERT_LINE_BREAK,
+    ABW_INSERT_SPACE,
+    ABW_INSERT_TAB,
+    ABW_INSERT_TEXT,
+    ABW_OPEN_ENDNOTE,
+    ABW_OPEN_FOOTER,
+    ABW_OPEN_FOOTNOTE,
+    ABW_OPEN_FRAME,
+    ABW_OPEN_HEADER,
+    ABW_OPEN_LINK,
+    ABW_OPEN_LIST_ELEMENT,
+    ABW_OPEN_ORDERED_LIST_LEVEL,
+    ABW_OPEN_PAGE_SPAN,
+    ABW_OPEN_PARAGRAPH,
+    ABW_OPEN_SECTION,
+    ABW_OPEN_SPAN,
+    ABW_OPEN_TABLE,
+    ABW_OPEN_TABLE_CELL,
+    ABW_OPEN_TABLE_ROW,
+    ABW_OPEN_UNORDERED_LIST_LEVEL,
+    ABW_SET_DOCUMENT_META_DATA,
+    ABW_START_DOCUMENT
+  };
+
+  ABWEvent();
+  ABWEvent(const ABWEvent &other);
+  ~ABWEvent();
+  ABWEvent &operator=(const ABWEvent &other);
+
+  Type getType() const;
+
+  /** Returns the properties the callback is made with. They are empty
+    * for callbacks without properties.
+    */
+  const librevenge::RVNGPropertyList &getPropertyList() const;
+
+  /** Returns the text of an ABW_INSERT_TEXT event, or an empty string.
+    */
+  const librevenge::RVNGString &getText() const;
+
+  /** Makes the callback to @a textInterface.
+    */
+  void write(librevenge::RVNGTextInterface *textInterface) const;
+
+private:
+  struct Impl;
+  Impl *m_impl;
+};
+
+} // namespace libabw
+
+#endif /* ABWEVENT_H */
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
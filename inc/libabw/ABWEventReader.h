@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ABWEVENTREADER_H
+#define ABWEVENTREADER_H
+
+#include <librevenge/librevenge.h>
+
+#include "libabw_api.h"
+#include "ABWEvent.h"
+#include "ABWParseOptions.h"
+
+namespace libabw
+{
+
+/**
+Reads the callbacks AbiDocument::parse would make, one at a time. The
+body of the document is parsed only as far as needed for the next
+event, so a caller that stops early does not pay for the rest of it.
+What comes before the body, e.g., styles, lists and headers and footers,
+is read from the whole document before the first event.
+
+The input stream has to be kept until the reader is destroyed.
+*/
+class ABWAPI ABWEventReader
+{
+public:
+  explicit ABWEventReader(librevenge::RVNGInputStream *input);
+
+  /** Reads the events with settings that change how the document is
+    * parsed. Threads are not used to collect sections or to write
+    * events, and the cache directory is not used. The fingerprint is
+    * taken when the last event has been read; until then, it is empty.
+    * The rest of the settings work as with AbiDocument::parse.
+    */
+  ABWEventReader(librevenge::RVNGInputStream *input, const ABWParseOptions &options);
+  ~ABWEventReader();
+
+  /** Reads the next event into @a event. Returns false when there are
+    * no more events, or if the document could not be parsed.
+    */
+  bool next(ABWEvent &event);
+
+  /** Returns whether reading has stopped because the document could
+    * not be parsed.
+    */
+  bool isFailed() const;
+
+private:
+  struct Impl;
+
+  ABWEventReader(const ABWEventReader &);
+  ABWEventReader &operator=(const ABWEventReader &);
+
+  Impl *m_impl;
+};
+
+} // namespace libabw
+
+#endif /* ABWEVENTREADER_H */
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,60 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ABWFINGERPRINT_H
+#define ABWFINGERPRINT_H
+
+#include "libabw_api.h"
+
+namespace libabw
+{
+
+class AbiDocument;
+class ABWEventReader;
+
+/**
+Hashes of a document, taken by AbiDocument::fingerprint or while it is
+parsed. They are fast to compute, so that they can be used to find
+documents that are the same, but they do not protect against documents
+made to have the same hash.
+*/
+class ABWAPI ABWFingerprint
+{
+  friend class AbiDocument;
+  friend class ABWEventReader;
+
+public:
+  ABWFingerprint();
+  ABWFingerprint(const ABWFingerprint &other);
+  ~ABWFingerprint();
+  ABWFingerprint &operator=(const ABWFingerprint &other);
+
+  /** Returns whether no fingerprint has been taken. */
+  bool isEmpty() const;
+
+  /** Returns a 128 bit hash of the bytes of the input stream, as 32
+    * hexadecimal digits, or an empty string.
+    */
+  const char *getDataDigest() const;
+
+  /** Returns a 128 bit hash of the document after it has been
+    * inflated, as 32 hexadecimal digits, or an empty string. It is the
+    * same as the data digest if the document is not compressed.
+    */
+  const char *getContentDigest() const;
+
+private:
+  struct Impl;
+  Impl *m_impl;
+};
+
+} // namespace libabw
+
+#endif /* ABWFINGERPRINT_H */
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,107 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ABWPARSEOPTIONS_H
+#define ABWPARSEOPTIONS_H
+
+#include "libabw_api.h"
+
+namespace libabw
+{
+
+class ABWFingerprint;
+
+/**
+Settings that change how AbiDocument::parse works. The defaults give the
+same result as parsing without options.
+*/
+class ABWAPI ABWParseOptions
+{
+public:
+  ABWParseOptions();
+  ABWParseOptions(const ABWParseOptions &other);
+  ~ABWParseOptions();
+  ABWParseOptions &operator=(const ABWParseOptions &other);
+
+  /** Sets the maximum number of bytes of uncompressed document data kept
+    * in memory, or 0 for no limit. Data past the limit are stored in a
+    * temporary file. Events that are collected before they are written,
+    * e.g., by AbiDocument::load or by several threads, are limited to
+    * about the same number of bytes: those of the body past it are
+    * stored in a temporary file, too. Headers and footers are always
+    * kept in memory.
+    */
+  void setMemoryLimit(unsigned long limit);
+  unsigned long getMemoryLimit() const;
+
+  /** Sets whether redundant events are left out: a span closed and
+    * reopened with the same properties, an empty span, or text split
+    * into several insertText calls. The document looks the same, but
+    * the interface gets fewer calls.
+    */
+  void setCompactEvents(bool compact);
+  bool getCompactEvents() const;
+
+  /** Sets how many threads may collect the sections of the body at the
+    * same time. With more than 1, the document is written out only when
+    * it has been collected completely. The result is the same. 1 is the
+    * default; the setting is ignored if libabw was built without
+    * thread support.
+    */
+  void setThreadCount(unsigned count);
+  unsigned getThreadCount() const;
+
+  /** Sets whether a compressed document is inflated on a thread of its
+    * own while it is parsed, instead of completely before. Ignored if
+    * a memory limit is set, or if libabw was built without thread
+    * support.
+    */
+  void setPipelinedInflate(bool pipelined);
+  bool getPipelinedInflate() const;
+
+  /** Sets whether the text interface is called on a thread of its own,
+    * so that it works at the same time as the parser. Events are passed
+    * to it in the same order. parse returns only after the interface
+    * has got the last one. Ignored if libabw was built without thread
+    * support, and when the sections are collected by several threads.
+    */
+  void setPipelinedOutput(bool pipelined);
+  bool getPipelinedOutput() const;
+
+  /** Sets a directory where parsed documents are kept, or an empty
+    * string or NULL for none. A document that is found there, with the
+    * same data and compact events setting, is written from there without
+    * parsing it. Otherwise it is collected completely before it is
+    * written, and then stored. A document whose data are larger than
+    * the memory limit is not collected, but parsed as without a cache
+    * directory, and not stored; neither is one whose events go past
+    * it. Kept documents larger than the memory limit are not used.
+    * The directory has to exist.
+    */
+  void setCacheDirectory(const char *directory);
+  const char *getCacheDirectory() const;
+
+  /** Sets where AbiDocument::parse and AbiDocument::load put the
+    * fingerprint of the document, or NULL for nowhere. It is taken
+    * while the document is read and inflated, like
+    * AbiDocument::fingerprint does, and left empty if the document
+    * could not be parsed. @a fingerprint has to be kept until then.
+    */
+  void setFingerprint(ABWFingerprint *fingerprint);
+  ABWFingerprint *getFingerprint() const;
+
+private:
+  struct Impl;
+  Impl *m_impl;
+};
+
+} // namespace libabw
+
+#endif /* ABWPARSEOPTIONS_H */
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,78 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ABWPARSEPOOL_H
+#define ABWPARSEPOOL_H
+
+#include <librevenge/librevenge.h>
+
+#include "libabw_api.h"
+#include "ABWParseOptions.h"
+
+namespace libabw
+{
+
+/**
+Is told when a parse queued in an ABWParsePool has ended.
+*/
+class ABWAPI ABWParseCallback
+{
+public:
+  virtual ~ABWParseCallback() {}
+
+  /** Called on the thread that has parsed the document. It must not
+    * wait for the pool or destroy it.
+    * @param result What AbiDocument::parse would have returned
+    * @param queueTime The seconds the parse has waited for a thread
+    * @param runTime The seconds the parse has taken
+    */
+  virtual void parsed(bool result, double queueTime, double runTime) = 0;
+};
+
+/**
+Threads that parse documents, so that the callers do not have to wait
+for it. Without thread support, documents are parsed right away by the
+caller.
+*/
+class ABWAPI ABWParsePool
+{
+public:
+  /** Creates a pool of @a threadCount threads. At most @a queueLength
+    * parses wait for a thread at a time.
+    */
+  ABWParsePool(unsigned threadCount, unsigned queueLength);
+  /** Waits for all queued parses to end. */
+  ~ABWParsePool();
+
+  /** Queues a parse of @a input to @a textInterface, like
+    * AbiDocument::parse. @a callback is called when it has ended. The
+    * input, the interface and the callback have to be kept until then.
+    * Returns false, without calling @a callback, if the queue is full.
+    */
+  bool parse(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *textInterface,
+             ABWParseCallback *callback);
+  bool parse(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *textInterface,
+             const ABWParseOptions &options, ABWParseCallback *callback);
+
+  /** Waits until there are no queued or running parses. */
+  void wait();
+
+private:
+  struct Impl;
+
+  ABWParsePool(const ABWParsePool &);
+  ABWParsePool &operator=(const ABWParsePool &);
+
+  Impl *m_impl;
+};
+
+} // namespace libabw
+
+#endif /* ABWPARSEPOOL_H */
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
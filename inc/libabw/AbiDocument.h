@@ -12,19 +12,10 @@
 
 #include <librevenge/librevenge.h>
 
-#ifdef DLL_EXPORT
-#ifdef LIBABW_BUILD
-#define ABWAPI __declspec(dllexport)
-#else
-#define ABWAPI __declspec(dllimport)
-#endif
-#else // !DLL_EXPORT
-#ifdef LIBABW_VISIBILITY
-#define ABWAPI __attribute__((visibility("default")))
-#else
-#define ABWAPI
-#endif
-#endif
+#include "libabw_api.h"
+#include "ABWDocumentHandle.h"
+#include "ABWFingerprint.h"
+#include "ABWParseOptions.h"
 
 namespace libabw
 {
@@ -39,6 +30,11 @@ class AbiDocument
 public:
   static ABWAPI bool isFileFormatSupported(librevenge::RVNGInputStream *input);
   static ABWAPI bool parse(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *documentInterface);
+  static ABWAPI bool parse(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *documentInterface, const ABWParseOptions &options);
+  static ABWAPI ABWDocumentHandle *load(librevenge::RVNGInputStream *input);
+  static ABWAPI ABWDocumentHandle *load(librevenge::RVNGInputStream *input, const ABWParseOptions &options);
+  static ABWAPI bool fingerprint(librevenge::RVNGInputStream *input, ABWFingerprint &fingerprint);
+  static ABWAPI void setSharedDataLimit(unsigned long limit);
 };
 
 } // namespace libabw
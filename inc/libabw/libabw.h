@@ -11,6 +11,12 @@
 #ifndef LIBABW_H
 #define LIBABW_H
 
+#include "ABWDocumentHandle.h"
+#include "ABWEvent.h"
+#include "ABWEventReader.h"
+#include "ABWFingerprint.h"
+#include "ABWParseOptions.h"
+#include "ABWParsePool.h"
 #include "AbiDocument.h"
 
 #endif /* LIBABW_H */
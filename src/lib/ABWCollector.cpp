@@ -7,82 +7,243 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
-#include <boost/algorithm/string.hpp>
-#include <boost/spirit/include/classic.hpp>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include "ABWCollector.h"
+#include "libabw_internal.h"
 
-bool libabw::findInt(const std::string &str, int &res)
+namespace libabw
+{
+
+namespace
+{
+
+struct ABWUnitName
+{
+  const char *name;
+  ABWUnit unit;
+};
+
+// Order matters: "inch" has to be tried before "in".
+const ABWUnitName UNITS[] =
+{
+  { "cm", ABW_CM },
+  { "inch", ABW_IN },
+  { "in", ABW_IN },
+  { "mm", ABW_MM },
+  { "pi", ABW_PI },
+  { "pt", ABW_PT },
+  { "px", ABW_PT },
+  { "%", ABW_PERCENT }
+};
+
+bool isSpace(const char c)
+{
+  return ' ' == c || '\t' == c || '\n' == c || '\v' == c || '\f' == c || '\r' == c;
+}
+
+bool isDigit(const char c)
+{
+  return '0' <= c && '9' >= c;
+}
+
+const char *skipSpaces(const char *p, const char *const end)
 {
-  using namespace ::boost::spirit::classic;
+  while (p != end && isSpace(*p))
+    ++p;
+  return p;
+}
+
+bool matchLiteral(const char *&p, const char *const end, const char *literal)
+{
+  const char *q = p;
+  for (; *literal; ++literal, ++q)
+  {
+    if (q == end || *q != *literal)
+      return false;
+  }
+  p = q;
+  return true;
+}
 
-  if (str.empty())
+/* Reads an unsigned decimal number. The digits are accumulated in the
+ * target type, so that the result is bit-identical to what the former
+ * grammar based parser produced. Fails on overflow.
+ */
+template<typename T>
+bool parseUnsigned(const char *&p, const char *const end, T &value, std::size_t &digits)
+{
+  const T max = (std::numeric_limits<T>::max)();
+  T n = 0;
+  const char *q = p;
+  for (; q != end && isDigit(*q); ++q)
+  {
+    const T digit = T(*q - '0');
+    if (n > max / 10)
+      return false;
+    n *= 10;
+    if (n > max - digit)
+      return false;
+    n += digit;
+  }
+  if (q == p)
     return false;
+  digits = std::size_t(q - p);
+  value = n;
+  p = q;
+  return true;
+}
 
-  return parse(str.c_str(),
-               //  Begin grammar
-               (
-                 int_p[assign_a(res)]
-               ) >> end_p,
-               //  End grammar
-               space_p).full;
+template<typename T>
+bool parseSigned(const char *&p, const char *const end, T &value)
+{
+  const char *q = p;
+  bool negative = false;
+  if (q != end && ('-' == *q || '+' == *q))
+  {
+    negative = '-' == *q;
+    ++q;
+  }
+
+  const T min = (std::numeric_limits<T>::is_integer ? (std::numeric_limits<T>::min)() : -(std::numeric_limits<T>::max)());
+  const T max = (std::numeric_limits<T>::max)();
+  T n = 0;
+  const char *const first = q;
+  for (; q != end && isDigit(*q); ++q)
+  {
+    const T digit = T(*q - '0');
+    if (negative)
+    {
+      if (n < min / 10)
+        return false;
+      n *= 10;
+      if (n < min + digit)
+        return false;
+      n -= digit;
+    }
+    else
+    {
+      if (n > max / 10)
+        return false;
+      n *= 10;
+      if (n > max - digit)
+        return false;
+      n += digit;
+    }
+  }
+  if (q == first)
+    return false;
+  value = n;
+  p = q;
+  return true;
 }
 
-void libabw::parsePropString(const std::string &str, ABWPropertyMap &props)
+/* Reads a real number: [sign] digits [. [digits]] [(e|E) [sign] digits],
+ * where either the integral or the fractional part may be omitted.
+ */
+bool parseReal(const char *&p, const char *const end, double &value)
 {
-  if (str.empty())
-    return;
+  const char *q = p;
+  bool negative = false;
+  if (q != end && ('-' == *q || '+' == *q))
+  {
+    negative = '-' == *q;
+    ++q;
+  }
+
+  double n = 0.0;
+  std::size_t digits = 0;
+  const bool gotNumber = parseUnsigned(q, end, n, digits);
+  if (negative)
+    n = -n;
 
-  std::string propString(boost::trim_copy(str));
-  std::vector<std::string> strVec;
-  boost::algorithm::split(strVec, propString, boost::is_any_of(";"), boost::token_compress_on);
-  for (std::vector<std::string>::size_type i = 0; i < strVec.size(); ++i)
+  if (q != end && '.' == *q)
   {
-    boost::algorithm::trim(strVec[i]);
-    std::vector<std::string> tmpVec;
-    boost::algorithm::split(tmpVec, strVec[i], boost::is_any_of(":"), boost::token_compress_on);
-    if (tmpVec.size() == 2)
-      props[tmpVec[0]] = tmpVec[1];
+    ++q;
+    double frac = 0.0;
+    if (parseUnsigned(q, end, frac, digits))
+    {
+      frac *= std::pow(double(10), double(-std::ptrdiff_t(digits)));
+      if (negative)
+        n -= frac;
+      else
+        n += frac;
+    }
+    else if (!gotNumber)
+      return false;
   }
+  else if (!gotNumber)
+    return false;
+
+  if (q != end && ('e' == *q || 'E' == *q))
+  {
+    ++q;
+    double exponent = 0.0;
+    if (!parseSigned(q, end, exponent))
+      return false;
+    n *= std::pow(double(10), exponent);
+  }
+
+  value = n;
+  p = q;
+  return true;
 }
 
-bool libabw::findDouble(const std::string &str, double &res, ABWUnit &unit)
+} // anonymous namespace
+
+} // namespace libabw
+
+bool libabw::findInt(const char *str, std::size_t len, int &res)
 {
-  using namespace ::boost::spirit::classic;
+  if (!str || !len)
+    return false;
 
-  if (str.empty())
+  const char *const end = str + len;
+  const char *p = skipSpaces(str, end);
+  int value = 0;
+  if (!parseSigned(p, end, value))
+    return false;
+  res = value;
+  return skipSpaces(p, end) == end;
+}
+
+bool libabw::findInt(const char *str, int &res)
+{
+  return str && findInt(str, std::strlen(str), res);
+}
+
+bool libabw::findInt(const std::string &str, int &res)
+{
+  return findInt(str.data(), str.size(), res);
+}
+
+bool libabw::findDouble(const char *str, std::size_t len, double &res, ABWUnit &unit)
+{
+  if (!str || !len)
     return false;
 
   unit = ABW_NONE;
 
-  if (!parse(str.c_str(),
-             //  Begin grammar
-             (
-               real_p[assign_a(res)] >>
-               (
-                 str_p("cm")[assign_a(unit,ABW_CM)]
-                 |
-                 str_p("inch")[assign_a(unit,ABW_IN)]
-                 |
-                 str_p("in")[assign_a(unit,ABW_IN)]
-                 |
-                 str_p("mm")[assign_a(unit,ABW_MM)]
-                 |
-                 str_p("pi")[assign_a(unit,ABW_PI)]
-                 |
-                 str_p("pt")[assign_a(unit,ABW_PT)]
-                 |
-                 str_p("px")[assign_a(unit,ABW_PT)]
-                 |
-                 str_p("%")[assign_a(unit,ABW_PERCENT)]
-                 |
-                 eps_p
-               )
-             ) >> end_p,
-             //  End grammar
-             space_p).full)
-  {
+  const char *p = skipSpaces(str, str + len);
+  const char *const end = str + len;
+  double value = 0.0;
+  if (!parseReal(p, end, value))
     return false;
+  res = value;
+
+  p = skipSpaces(p, end);
+  for (std::size_t i = 0; i < ABW_NUM_ELEMENTS(UNITS); ++i)
+  {
+    if (matchLiteral(p, end, UNITS[i].name))
+    {
+      unit = UNITS[i].unit;
+      break;
+    }
   }
+  if (skipSpaces(p, end) != end)
+    return false;
 
   if (unit == ABW_PERCENT)
     res /= 100.0;
@@ -112,6 +273,60 @@ bool libabw::findDouble(const std::string &str, double &res, ABWUnit &unit)
   return true;
 }
 
+bool libabw::findDouble(const char *str, double &res, ABWUnit &unit)
+{
+  return str && findDouble(str, std::strlen(str), res, unit);
+}
+
+bool libabw::findDouble(const std::string &str, double &res, ABWUnit &unit)
+{
+  return findDouble(str.data(), str.size(), res, unit);
+}
+
+bool libabw::findBool(const char *str, bool &res)
+{
+  if (!str || !*str)
+    return false;
+
+  static const struct
+  {
+    const char *name;
+    bool value;
+  } BOOLS[] =
+  {
+    { "true", true },
+    { "false", false },
+    { "yes", true },
+    { "no", false },
+    { "TRUE", true },
+    { "FALSE", false }
+  };
+
+  while (isspace((unsigned char) *str))
+    ++str;
+  for (std::size_t i = 0; i < ABW_NUM_ELEMENTS(BOOLS); ++i)
+  {
+    const std::size_t len = strlen(BOOLS[i].name);
+    if (!strncmp(str, BOOLS[i].name, len))
+    {
+      res = BOOLS[i].value;
+      str += len;
+      while (isspace((unsigned char) *str))
+        ++str;
+      return !*str;
+    }
+  }
+  return false;
+}
+
+void libabw::ABWData::writeOut(librevenge::RVNGPropertyList &propList) const
+{
+  if (m_base64)
+    propList.insert("office:binary-data", *m_base64);
+  else
+    propList.insert("office:binary-data", m_binaryData);
+}
+
 void libabw::ABWListElement::writeOut(librevenge::RVNGPropertyList &propList) const
 {
   if (m_listLevel > 0)
@@ -10,9 +10,12 @@
 #ifndef __ABWCOLLECTOR_H__
 #define __ABWCOLLECTOR_H__
 
+#include <cstddef>
 #include <string>
 #include <map>
+#include <boost/shared_ptr.hpp>
 #include <librevenge/librevenge.h>
+#include "ABWPropertyMap.h"
 
 namespace libabw
 {
@@ -35,24 +38,40 @@ enum ABWListType
   ABW_UNORDERED
 };
 
-typedef std::map<std::string, std::string> ABWPropertyMap;
-
+/* The numeric parsers skip white space around the value and require
+ * the whole string to be consumed. Like the grammar they replaced, they
+ * may leave partially parsed values in the output arguments on failure.
+ */
+bool findInt(const char *str, std::size_t len, int &res);
+bool findInt(const char *str, int &res);
 bool findInt(const std::string &str, int &res);
+bool findDouble(const char *str, std::size_t len, double &res, ABWUnit &unit);
+bool findDouble(const char *str, double &res, ABWUnit &unit);
 bool findDouble(const std::string &str, double &res, ABWUnit &unit);
-void parsePropString(const std::string &str, ABWPropertyMap &props);
+bool findBool(const char *str, bool &res);
 
 struct ABWData
 {
   ABWData()
-    : m_mimeType(), m_binaryData() {}
+    : m_mimeType(), m_binaryData(), m_base64() {}
   ABWData(const ABWData &data)
-    : m_mimeType(data.m_mimeType), m_binaryData(data.m_binaryData) {}
+    : m_mimeType(data.m_mimeType), m_binaryData(data.m_binaryData), m_base64(data.m_base64) {}
   ABWData(const librevenge::RVNGString &mimeType, const librevenge::RVNGBinaryData binaryData)
-    : m_mimeType(mimeType), m_binaryData(binaryData) {}
+    : m_mimeType(mimeType), m_binaryData(binaryData), m_base64() {}
   ~ABWData() {}
 
+  /** Inserts the data as office:binary-data. Text kept in base64 is
+    * inserted as it is; a generator gets the same from getStr() as for
+    * binary data, without decoding and encoding it again.
+    */
+  void writeOut(librevenge::RVNGPropertyList &propList) const;
+
   librevenge::RVNGString m_mimeType;
   librevenge::RVNGBinaryData m_binaryData;
+  /* The data as librevenge would encode them, if the document has them
+   * so. m_binaryData is empty then.
+   */
+  boost::shared_ptr<const librevenge::RVNGString> m_base64;
 };
 
 struct ABWListElement
@@ -138,7 +157,7 @@ public:
   virtual void collectList(const char *id, const char *listDecimal, const char *listDelim,
                            const char *parentid, const char *startValue, const char *type) = 0;
 
-  virtual void collectData(const char *name, const char *mimeType, const librevenge::RVNGBinaryData &data) = 0;
+  virtual void collectData(const char *name, const ABWData &data) = 0;
   virtual void collectHeaderFooter(const char *id, const char *type) = 0;
 
   virtual void openTable(const char *props) = 0;
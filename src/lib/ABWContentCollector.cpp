@@ -8,8 +8,15 @@
  */
 
 #include <cassert>
+#include <cstring>
 #include <locale>
+#include <set>
 #include <sstream>
+#include <vector>
+
+#if defined __SSE2__ && defined __GNUC__
+#include <emmintrin.h>
+#endif
 
 #include <boost/spirit/include/classic.hpp>
 #include <boost/algorithm/string.hpp>
@@ -48,71 +55,80 @@ static std::string getColor(const std::string &s)
   return out;
 }
 
-static void separateTabsAndInsertText(ABWOutputElements &outputElements, const librevenge::RVNGString &text)
+/* Returns the first character in [pos, end) that ends a text run: a tab,
+ * a line break or a space following another space. The characters
+ * looked for are ASCII, so the UTF-8 text can be scanned byte by byte.
+ */
+static const char *findTextRunEnd(const char *const begin, const char *pos, const char *const end)
 {
-  if (text.empty())
-    return;
-  librevenge::RVNGString tmpText;
-  librevenge::RVNGString::Iter i(text);
-  for (i.rewind(); i.next();)
+#if defined __SSE2__ && defined __GNUC__
+  if (pos == begin && pos != end)
   {
-    if (*(i()) == '\t')
-    {
-      if (!tmpText.empty())
-      {
-        outputElements.addInsertText(tmpText);
-        tmpText.clear();
-      }
-      outputElements.addInsertTab();
-    }
-    else if (*(i()) == '\n'|| *(i()) == (char)0x0a)
-    {
-      if (!tmpText.empty())
-      {
-        outputElements.addInsertText(tmpText);
-        tmpText.clear();
-      }
-      outputElements.addInsertLineBreak();
-    }
-    else
+    if (*pos == '\t' || *pos == '\n')
+      return pos;
+    ++pos;
+  }
+  {
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i lineBreaks = _mm_set1_epi8('\n');
+    for (; end - pos >= 16; pos += 16)
     {
-      tmpText.append(i());
+      const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+      const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos - 1));
+      const __m128i found = _mm_or_si128(
+                              _mm_or_si128(_mm_cmpeq_epi8(current, tabs), _mm_cmpeq_epi8(current, lineBreaks)),
+                              _mm_and_si128(_mm_cmpeq_epi8(current, spaces), _mm_cmpeq_epi8(previous, spaces)));
+      const int mask = _mm_movemask_epi8(found);
+      if (mask)
+        return pos + __builtin_ctz(unsigned(mask));
     }
   }
-  if (!tmpText.empty())
-    outputElements.addInsertText(tmpText);
+#endif
+  for (; pos != end; ++pos)
+  {
+    if (*pos == '\t' || *pos == '\n' || (*pos == ' ' && pos != begin && pos[-1] == ' '))
+      return pos;
+  }
+  return end;
 }
 
-static void separateSpacesAndInsertText(ABWOutputElements &outputElements, const librevenge::RVNGString &text)
+/* Inserts text, turning tabs and line breaks into their own elements and
+ * every space after the first one of a run into an explicit space.
+ */
+static void separateSpacesAndInsertText(ABWOutputElements &outputElements, const char *const text)
 {
-  if (text.empty())
+  const std::size_t length = std::strlen(text);
+  const char *const end = text + length;
+  const char *runEnd = findTextRunEnd(text, text, end);
+  if (runEnd == end)
   {
-    outputElements.addInsertText(text);
+    outputElements.addInsertText(librevenge::RVNGString(text));
     return;
   }
-  librevenge::RVNGString tmpText;
-  int numConsecutiveSpaces = 0;
-  librevenge::RVNGString::Iter i(text);
-  for (i.rewind(); i.next();)
-  {
-    if (*(i()) == ' ')
-      numConsecutiveSpaces++;
-    else
-      numConsecutiveSpaces = 0;
 
-    if (numConsecutiveSpaces > 1)
+  // a copy that can be cut into NUL-terminated runs
+  std::vector<char> buffer(text, end + 1);
+  std::size_t runStart = 0;
+  while (runEnd != end)
+  {
+    const std::size_t pos = std::size_t(runEnd - text);
+    if (runStart != pos)
     {
-      if (!tmpText.empty())
-      {
-        separateTabsAndInsertText(outputElements, tmpText);
-        tmpText.clear();
-      }
-      outputElements.addInsertSpace();
+      buffer[pos] = '\0';
+      outputElements.addInsertText(librevenge::RVNGString(&buffer[runStart]));
     }
+    if (*runEnd == '\t')
+      outputElements.addInsertTab();
+    else if (*runEnd == '\n')
+      outputElements.addInsertLineBreak();
     else
-      tmpText.append(i());
+      outputElements.addInsertSpace();
+    runStart = pos + 1;
+    runEnd = findTextRunEnd(text, runEnd + 1, end);
   }
-  separateTabsAndInsertText(outputElements, tmpText);
+  if (runStart != length)
+    outputElements.addInsertText(librevenge::RVNGString(&buffer[runStart]));
 }
 
 static void separateSpacesAndReturnsListOfArgs(std::string const &attrib, std::vector<std::string> &listArg)
@@ -299,23 +315,162 @@ static std::string decodeUrl(const std::string &str)
   return str;
 }
 
+std::string findProperty(const ABWPropertyMap &propMap, const int id)
+{
+  const char *const value = propMap.find(id);
+  return value ? value : std::string();
+}
+
 std::string findProperty(const ABWPropertyMap &propMap, const char *const name)
 {
   if (!name)
     return std::string();
-  ABWPropertyMap::const_iterator iter = propMap.find(name);
-  if (iter != propMap.end())
-    return iter->second;
-  return std::string();
+  const char *const value = propMap.find(name);
+  return value ? value : std::string();
+}
+
+std::string findCharacterProperty(const ABWPropertyMap &characterStyle, const ABWPropertyMap &paragraphStyle, const int id)
+{
+  const char *value = characterStyle.find(id);
+  if (!value || !*value)
+    value = paragraphStyle.find(id);
+  return value ? value : std::string();
 }
 
 } // anonymous namespace
 
 } // namespace libabw
 
+libabw::ABWParagraphFormat::ABWParagraphFormat() :
+  m_properties(),
+  m_marginRight(),
+  m_marginTop(),
+  m_marginBottom(),
+  m_marginLeft(),
+  m_textIndent(),
+  m_outlineLevel(),
+  m_textAlign(),
+  m_lineHeight(),
+  m_lineHeightUnit(librevenge::RVNG_INCH),
+  m_lineHeightAtLeast(false),
+  m_orphans(),
+  m_widows(),
+  m_tabStops(),
+  m_writingMode(),
+  m_borders()
+{
+}
+
+libabw::ABWParagraphFormat::~ABWParagraphFormat()
+{
+}
+
+void libabw::ABWParagraphFormat::write(librevenge::RVNGPropertyList &propList, const bool isListElement) const
+{
+  if (m_marginRight)
+    propList.insert("fo:margin-right", get(m_marginRight));
+  if (m_marginTop)
+    propList.insert("fo:margin-top", get(m_marginTop));
+  if (m_marginBottom)
+    propList.insert("fo:margin-bottom", get(m_marginBottom));
+
+  if (!isListElement)
+  {
+    if (m_marginLeft)
+      propList.insert("fo:margin-left", get(m_marginLeft));
+    if (m_textIndent)
+      propList.insert("fo:text-indent", get(m_textIndent));
+    if (!m_outlineLevel.empty())
+      propList.insert("text:outline-level", m_outlineLevel.c_str());
+  }
+
+  if (!m_textAlign.empty())
+    propList.insert("fo:text-align", m_textAlign.c_str());
+  if (m_lineHeight)
+    propList.insert(m_lineHeightAtLeast ? "style:line-height-at-least" : "fo:line-height", get(m_lineHeight), m_lineHeightUnit);
+  if (m_orphans)
+    propList.insert("fo:orphans", get(m_orphans));
+  if (m_widows)
+    propList.insert("fo:widows", get(m_widows));
+  if (m_tabStops.count())
+    propList.insert("style:tab-stops", m_tabStops);
+  if (!m_writingMode.empty())
+    propList.insert("style:writing-mode", m_writingMode.c_str());
+
+  librevenge::RVNGPropertyList::Iter i(m_borders);
+  for (i.rewind(); i.next();)
+    propList.insert(i.key(), i()->getStr());
+}
+
+libabw::ABWCharacterFormat::ABWCharacterFormat() :
+  m_fontSize(),
+  m_fontName(),
+  m_fontStyle(),
+  m_fontWeight(),
+  m_hidden(false),
+  m_rightToLeft(false),
+  m_underline(false),
+  m_lineThrough(false),
+  m_overline(false),
+  m_color(),
+  m_backgroundColor(),
+  m_textPosition(),
+  m_language(),
+  m_country(),
+  m_script()
+{
+}
+
+libabw::ABWCharacterFormat::~ABWCharacterFormat()
+{
+}
+
+void libabw::ABWCharacterFormat::write(librevenge::RVNGPropertyList &propList) const
+{
+  if (m_fontSize)
+    propList.insert("fo:font-size", get(m_fontSize));
+  if (!m_fontName.empty())
+    propList.insert("style:font-name", m_fontName.c_str());
+  if (!m_fontStyle.empty())
+    propList.insert("fo:font-style", m_fontStyle.c_str());
+  if (!m_fontWeight.empty())
+    propList.insert("fo:font-weight", m_fontWeight.c_str());
+  if (m_hidden)
+    propList.insert("text:display", "none");
+  if (m_rightToLeft)
+    propList.insert("style:writing-mode", "rl-tb");
+  if (m_underline)
+  {
+    propList.insert("style:text-underline-type", "single");
+    propList.insert("style:text-underline-style", "solid");
+  }
+  if (m_lineThrough)
+  {
+    propList.insert("style:text-line-through-type", "single");
+    propList.insert("style:text-line-through-style", "solid");
+  }
+  if (m_overline)
+  {
+    propList.insert("style:text-overline-type", "single");
+    propList.insert("style:text-overline-style", "solid");
+  }
+  if (!m_color.empty())
+    propList.insert("fo:color", m_color.c_str());
+  if (!m_backgroundColor.empty())
+    propList.insert("fo:background-color", m_backgroundColor.c_str());
+  if (!m_textPosition.empty())
+    propList.insert("style:text-position", m_textPosition.c_str());
+  if (m_language)
+    propList.insert("fo:language", get(m_language).c_str());
+  if (m_country)
+    propList.insert("fo:country", get(m_country).c_str());
+  if (m_script)
+    propList.insert("fo:script", get(m_script).c_str());
+}
+
 libabw::ABWContentTableState::ABWContentTableState() :
-  m_currentTableProperties(),
-  m_currentCellProperties(),
+  m_currentTableProperties(0),
+  m_currentCellProperties(0),
 
   m_currentTableCol(-1),
   m_currentTableRow(-1),
@@ -362,8 +517,8 @@ libabw::ABWContentParsingState::ABWContentParsingState() :
   m_inParagraphOrListElement(false),
 
   m_currentSectionStyle(),
-  m_currentParagraphStyle(),
-  m_currentCharacterStyle(),
+  m_currentParagraphFormat(0),
+  m_currentCharacterStyle(0),
 
   m_pageWidth(0.0),
   m_pageHeight(0.0),
@@ -409,7 +564,7 @@ libabw::ABWContentParsingState::ABWContentParsingState(const ABWContentParsingSt
   m_inParagraphOrListElement(ps.m_inParagraphOrListElement),
 
   m_currentSectionStyle(ps.m_currentSectionStyle),
-  m_currentParagraphStyle(ps.m_currentParagraphStyle),
+  m_currentParagraphFormat(ps.m_currentParagraphFormat),
   m_currentCharacterStyle(ps.m_currentCharacterStyle),
 
   m_pageWidth(ps.m_pageWidth),
@@ -447,22 +602,76 @@ libabw::ABWContentParsingState::~ABWContentParsingState()
 {
 }
 
+libabw::ABWSectionBoundary::ABWSectionBoundary()
+  : m_isClean(true)
+  , m_isPageSpanOpened(false)
+  , m_pageMarginTop(0.0)
+  , m_pageMarginBottom(0.0)
+  , m_pageMarginLeft(0.0)
+  , m_pageMarginRight(0.0)
+  , m_deferredPageBreak(false)
+  , m_deferredColumnBreak(false)
+  , m_isFirstTextInListElement(false)
+  , m_parsingContext(ABW_SECTION)
+  , m_currentHeaderFooterId(-1)
+  , m_currentHeaderFooterOccurrence()
+  , m_tableCounter(0)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    m_footerIds[i] = -1;
+    m_headerIds[i] = -1;
+  }
+}
+
+bool libabw::ABWSectionBoundary::operator==(const ABWSectionBoundary &other) const
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    if (m_footerIds[i] != other.m_footerIds[i] || m_headerIds[i] != other.m_headerIds[i])
+      return false;
+  }
+  return m_isClean == other.m_isClean
+         && m_isPageSpanOpened == other.m_isPageSpanOpened
+         && fabs(m_pageMarginTop - other.m_pageMarginTop) < ABW_EPSILON
+         && fabs(m_pageMarginBottom - other.m_pageMarginBottom) < ABW_EPSILON
+         && fabs(m_pageMarginLeft - other.m_pageMarginLeft) < ABW_EPSILON
+         && fabs(m_pageMarginRight - other.m_pageMarginRight) < ABW_EPSILON
+         && m_deferredPageBreak == other.m_deferredPageBreak
+         && m_deferredColumnBreak == other.m_deferredColumnBreak
+         && m_isFirstTextInListElement == other.m_isFirstTextInListElement
+         && m_parsingContext == other.m_parsingContext
+         && m_currentHeaderFooterId == other.m_currentHeaderFooterId
+         && m_currentHeaderFooterOccurrence == other.m_currentHeaderFooterOccurrence
+         && m_tableCounter == other.m_tableCounter;
+}
+
 libabw::ABWContentCollector::ABWContentCollector(librevenge::RVNGTextInterface *iface, const std::map<int, int> &tableSizes,
                                                  const std::map<std::string, ABWData> &data,
-                                                 const std::map<int, ABWListElement *> &listElements) :
+                                                 const std::map<int, ABWListElement *> &listElements,
+                                                 ABWPropertyCache &propertyCache) :
   m_ps(new ABWContentParsingState),
   m_iface(iface),
   m_parsingStates(),
-  m_dontLoop(),
   m_textStyles(),
+  m_resolvedTextStyles(),
+  m_paragraphFormats(),
+  m_characterStyles(),
+  m_characterFormats(),
+  m_paragraphFormatIndex(),
+  m_characterStyleIndex(),
+  m_characterFormatIndex(),
   m_documentStyle(),
   m_metadata(),
   m_data(data),
   m_tableSizes(tableSizes),
   m_tableCounter(0),
-  m_outputElements(),
+  m_headerFooterTableIds(0),
+  m_headerFooterCounter(0),
+  m_outputElements(new ABWOutputElements()),
   m_listElements(listElements),
-  m_dummyListElements()
+  m_dummyListElements(),
+  m_propertyCache(propertyCache)
 {
 }
 
@@ -482,73 +691,252 @@ void libabw::ABWContentCollector::collectTextStyle(const char *name, const char
   if (props)
     parsePropString(props, style.properties);
   if (name)
+  {
     m_textStyles[name] = style;
+    m_resolvedTextStyles.clear();
+    _resetFormats();
+  }
 }
 
-void libabw::ABWContentCollector::_recurseTextProperties(const char *name, ABWPropertyMap &styleProps)
+const libabw::ABWPropertyMap &libabw::ABWContentCollector::_getTextStyle(const char *name)
 {
-  if (name)
+  std::map<std::string, ABWPropertyMap>::const_iterator it = m_resolvedTextStyles.find(name);
+  if (it != m_resolvedTextStyles.end())
+    return it->second;
+
+  ABWPropertyMap &styleProps = m_resolvedTextStyles[name];
+
+  // Collect the basedon chain, stopping at the first style seen already.
+  std::vector<const std::string *> chain;
+  std::set<std::string> seen;
+  std::string current(name);
+  chain.push_back(&*seen.insert(current).first);
+  for (;;)
+  {
+    std::map<std::string, ABWStyle>::const_iterator iter = m_textStyles.find(current);
+    if (iter == m_textStyles.end() || iter->second.basedon.empty() || seen.count(iter->second.basedon))
+      break;
+    current = iter->second.basedon;
+    chain.push_back(&*seen.insert(current).first);
+  }
+
+  for (std::vector<const std::string *>::const_reverse_iterator link = chain.rbegin(); link != chain.rend(); ++link)
   {
-    m_dontLoop.insert(name);
-    std::map<std::string, ABWStyle>::const_iterator iter = m_textStyles.find(name);
-    if (iter != m_textStyles.end() && !(iter->second.basedon.empty()) && !m_dontLoop.count(iter->second.basedon))
-      _recurseTextProperties(iter->second.basedon.c_str(), styleProps);
+    std::map<std::string, ABWStyle>::const_iterator iter = m_textStyles.find(**link);
     if (iter != m_textStyles.end())
-    {
-      for (ABWPropertyMap::const_iterator i = iter->second.properties.begin(); i != iter->second.properties.end(); ++i)
-        styleProps[i->first] = i->second;
-    }
+      styleProps.merge(iter->second.properties);
 
     // Styles based on "Heading X" style are recognized as headings.
-    if (boost::starts_with(name, "Heading "))
+    if (boost::starts_with(**link, "Heading "))
     {
       int level = 0;
-      const std::string levelStr = std::string(name).substr(8);
+      const std::string levelStr = (*link)->substr(8);
       if (findInt(levelStr, level))
       {
         // Abiword only has 4 levels of headings, but allow some more
         if ((0 < level) && (10 > level))
-          styleProps["libabw:outline-level"] = levelStr;
+          styleProps.set(PROP_LIBABW_OUTLINE_LEVEL, levelStr.c_str());
       }
     }
   }
-  if (!m_dontLoop.empty())
-    m_dontLoop.clear();
+
+  return styleProps;
 }
 
-std::string libabw::ABWContentCollector::_findDocumentProperty(const char *const name)
+const libabw::ABWParagraphFormat &libabw::ABWContentCollector::_getParagraphFormat(const char *const style, const char *const props)
 {
-  return findProperty(m_documentStyle, name);
+  const ABWPropertyMap &styleProps = style ? _getTextStyle(style) : m_propertyCache.get(0);
+  const ABWPropertyMap &paragraphProps = m_propertyCache.get(props);
+  const StyleKey_t key(&styleProps, &paragraphProps);
+  const boost::unordered_map<StyleKey_t, const ABWParagraphFormat *, boost::hash<StyleKey_t> >::const_iterator it = m_paragraphFormatIndex.find(key);
+  if (it != m_paragraphFormatIndex.end())
+    return *it->second;
+
+  m_paragraphFormats.push_back(ABWParagraphFormat());
+  ABWParagraphFormat &format = m_paragraphFormats.back();
+  m_paragraphFormatIndex[key] = &format;
+
+  format.m_properties = styleProps;
+  format.m_properties.merge(paragraphProps);
+  const ABWPropertyMap &properties = format.m_properties;
+
+  ABWUnit unit(ABW_NONE);
+  double value(0.0);
+  int intValue(0);
+  std::string sValue;
+
+  if (findDouble(findProperty(properties, PROP_MARGIN_RIGHT), value, unit) && unit == ABW_IN)
+    format.m_marginRight = value;
+
+  if (findDouble(findProperty(properties, PROP_MARGIN_TOP), value, unit) && unit == ABW_IN)
+    format.m_marginTop = value;
+
+  if (findDouble(findProperty(properties, PROP_MARGIN_BOTTOM), value, unit) && unit == ABW_IN)
+    format.m_marginBottom = value;
+
+  if (findDouble(findProperty(properties, PROP_MARGIN_LEFT), value, unit) && unit == ABW_IN)
+    format.m_marginLeft = value;
+
+  if (findDouble(findProperty(properties, PROP_TEXT_INDENT), value, unit) && unit == ABW_IN)
+    format.m_textIndent = value;
+
+  // TODO: Numbered headings should probably not be handled as lists.
+  // Just do not make them headings for now.
+  format.m_outlineLevel = findProperty(properties, PROP_LIBABW_OUTLINE_LEVEL);
+
+  sValue = findProperty(properties, PROP_TEXT_ALIGN);
+  if (sValue == "left")
+    format.m_textAlign = "start";
+  else if (sValue == "right")
+    format.m_textAlign = "end";
+  else
+    format.m_textAlign = sValue;
+
+  sValue = findProperty(properties, PROP_LINE_HEIGHT);
+  if (!sValue.empty())
+  {
+    size_t position = sValue.find_last_of('+');
+    if (position && position != std::string::npos)
+    {
+      format.m_lineHeightAtLeast = true;
+      sValue.erase(position);
+    }
+    if (findDouble(sValue, value, unit))
+    {
+      if (ABW_IN == unit)
+      {
+        format.m_lineHeight = value;
+        format.m_lineHeightUnit = librevenge::RVNG_INCH;
+      }
+      else if (ABW_PERCENT == unit)
+      {
+        format.m_lineHeight = value;
+        format.m_lineHeightUnit = librevenge::RVNG_PERCENT;
+      }
+    }
+  }
+
+  if (findInt(findProperty(properties, PROP_ORPHANS), intValue))
+    format.m_orphans = intValue;
+
+  if (findInt(findProperty(properties, PROP_WIDOWS), intValue))
+    format.m_widows = intValue;
+
+  parseTabStops(findProperty(properties, PROP_TABSTOPS), format.m_tabStops);
+
+  sValue = findProperty(properties, PROP_DOM_DIR);
+  if (sValue == "ltr")
+    format.m_writingMode = "lr-tb";
+  else if (sValue == "rtl")
+    format.m_writingMode = "rl-tb";
+
+  _addBorderProperties(properties, format.m_borders);
+
+  return format;
 }
 
-std::string libabw::ABWContentCollector::_findParagraphProperty(const char *name)
+const libabw::ABWParagraphFormat &libabw::ABWContentCollector::_getCurrentParagraphFormat()
 {
-  return findProperty(m_ps->m_currentParagraphStyle, name);
+  if (!m_ps->m_currentParagraphFormat)
+    m_ps->m_currentParagraphFormat = &_getParagraphFormat(0, 0);
+  return *m_ps->m_currentParagraphFormat;
 }
 
-std::string libabw::ABWContentCollector::_findTableProperty(const char *name)
+const libabw::ABWCharacterFormat &libabw::ABWContentCollector::_getCurrentCharacterFormat()
 {
-  assert(!m_ps->m_tableStates.empty());
-  return findProperty(m_ps->m_tableStates.top().m_currentTableProperties, name);
+  const ABWParagraphFormat &paragraphFormat = _getCurrentParagraphFormat();
+  const CharacterFormatKey_t key(&paragraphFormat, m_ps->m_currentCharacterStyle);
+  const boost::unordered_map<CharacterFormatKey_t, const ABWCharacterFormat *, boost::hash<CharacterFormatKey_t> >::const_iterator it = m_characterFormatIndex.find(key);
+  if (it != m_characterFormatIndex.end())
+    return *it->second;
+
+  m_characterFormats.push_back(ABWCharacterFormat());
+  ABWCharacterFormat &format = m_characterFormats.back();
+  m_characterFormatIndex[key] = &format;
+
+  const ABWPropertyMap &characterStyle = m_ps->m_currentCharacterStyle ? *m_ps->m_currentCharacterStyle : m_propertyCache.get(0);
+  const ABWPropertyMap &paragraphStyle = paragraphFormat.m_properties;
+
+  ABWUnit unit(ABW_NONE);
+  double value(0.0);
+
+  if (findDouble(findCharacterProperty(characterStyle, paragraphStyle, PROP_FONT_SIZE), value, unit) && unit == ABW_IN)
+    format.m_fontSize = value;
+
+  format.m_fontName = findCharacterProperty(characterStyle, paragraphStyle, PROP_FONT_FAMILY);
+
+  std::string sValue = findCharacterProperty(characterStyle, paragraphStyle, PROP_FONT_STYLE);
+  if (sValue != "normal")
+    format.m_fontStyle = sValue;
+
+  sValue = findCharacterProperty(characterStyle, paragraphStyle, PROP_FONT_WEIGHT);
+  if (sValue != "normal")
+    format.m_fontWeight = sValue;
+
+  format.m_hidden = findCharacterProperty(characterStyle, paragraphStyle, PROP_DISPLAY) == "none";
+  format.m_rightToLeft = findCharacterProperty(characterStyle, paragraphStyle, PROP_DIR_OVERRIDE) == "rtl";
+
+  sValue = findCharacterProperty(characterStyle, paragraphStyle, PROP_TEXT_DECORATION);
+  std::vector<std::string> listDecorations;
+  separateSpacesAndReturnsListOfArgs(sValue, listDecorations);
+  for (size_t j=0; j<listDecorations.size(); ++j)
+  {
+    std::string const &decoration=listDecorations[j];
+    if (decoration == "underline")
+      format.m_underline = true;
+    else if (decoration == "line-through")
+      format.m_lineThrough = true;
+    else if (decoration == "overline")
+      format.m_overline = true;
+  }
+
+  format.m_color = getColor(findCharacterProperty(characterStyle, paragraphStyle, PROP_COLOR));
+  format.m_backgroundColor = getColor(findCharacterProperty(characterStyle, paragraphStyle, PROP_BGCOLOR));
+
+  sValue = findCharacterProperty(characterStyle, paragraphStyle, PROP_TEXT_POSITION);
+  if (sValue == "subscript")
+    format.m_textPosition = "sub";
+  else if (sValue == "superscript")
+    format.m_textPosition = "super";
+
+  sValue = findCharacterProperty(characterStyle, paragraphStyle, PROP_LANG);
+  if (sValue.empty()) // try document default
+    sValue = _findDocumentProperty(PROP_LANG);
+
+  if (!sValue.empty())
+    parseLang(sValue, format.m_language, format.m_country, format.m_script);
+
+  // do we need to check "font-stretch" here or it is always equal to normal ?
+  return format;
+}
+
+void libabw::ABWContentCollector::_resetFormats()
+{
+  m_paragraphFormatIndex.clear();
+  m_characterStyleIndex.clear();
+  m_characterFormatIndex.clear();
+}
+
+std::string libabw::ABWContentCollector::_findDocumentProperty(const int id)
+{
+  return findProperty(m_documentStyle, id);
 }
 
-std::string libabw::ABWContentCollector::_findCellProperty(const char *name)
+std::string libabw::ABWContentCollector::_findTableProperty(const int id)
 {
   assert(!m_ps->m_tableStates.empty());
-  return findProperty(m_ps->m_tableStates.top().m_currentCellProperties, name);
+  return findProperty(*m_ps->m_tableStates.top().m_currentTableProperties, id);
 }
 
-std::string libabw::ABWContentCollector::_findSectionProperty(const char *name)
+std::string libabw::ABWContentCollector::_findCellProperty(const int id)
 {
-  return findProperty(m_ps->m_currentSectionStyle, name);
+  assert(!m_ps->m_tableStates.empty());
+  return findProperty(*m_ps->m_tableStates.top().m_currentCellProperties, id);
 }
 
-std::string libabw::ABWContentCollector::_findCharacterProperty(const char *name)
+std::string libabw::ABWContentCollector::_findSectionProperty(const int id)
 {
-  std::string prop = findProperty(m_ps->m_currentCharacterStyle, name);
-  if (prop.empty())
-    prop = findProperty(m_ps->m_currentParagraphStyle, name);
-  return prop;
+  return findProperty(m_ps->m_currentSectionStyle, id);
 }
 
 std::string libabw::ABWContentCollector::_findMetadataEntry(const char *const name)
@@ -559,25 +947,29 @@ std::string libabw::ABWContentCollector::_findMetadataEntry(const char *const na
 void libabw::ABWContentCollector::collectDocumentProperties(const char *const props)
 {
   if (props)
+  {
     parsePropString(props, m_documentStyle);
+    _resetFormats();
+  }
 }
 
-void libabw::ABWContentCollector::_addBorderProperties(const std::map<std::string, std::string> &map, librevenge::RVNGPropertyList &propList, const std::string &defaultUndefBorderProp)
+void libabw::ABWContentCollector::_addBorderProperties(const ABWPropertyMap &map, librevenge::RVNGPropertyList &propList, const std::string &defaultUndefBorderProp)
 {
   int setBorders=0;
   static char const *odtWh[4]= {"fo:border-left", "fo:border-right", "fo:border-top", "fo:border-bottom"};
   for (int i=0, depl=1; i<4; ++i, depl*=2)
   {
-    static char const *wh[4]= {"left", "right", "top", "bot"};
-    std::string whString(wh[i]);
-    std::string tmp=whString+"-color";
-    if (map.find(tmp)==map.end()) continue;
-    std::string color=getColor(map.find(tmp)->second);
+    static int const colorWh[4]= {PROP_LEFT_COLOR, PROP_RIGHT_COLOR, PROP_TOP_COLOR, PROP_BOT_COLOR};
+    static int const styleWh[4]= {PROP_LEFT_STYLE, PROP_RIGHT_STYLE, PROP_TOP_STYLE, PROP_BOT_STYLE};
+    static int const thicknessWh[4]= {PROP_LEFT_THICKNESS, PROP_RIGHT_THICKNESS, PROP_TOP_THICKNESS, PROP_BOT_THICKNESS};
+    const char *value=map.find(colorWh[i]);
+    if (!value) continue;
+    std::string color=getColor(value);
     if (color.empty())
       continue;
     int style;
-    tmp=whString+"-style";
-    if (map.find(tmp)==map.end() || !findInt(map.find(tmp)->second, style))
+    value=map.find(styleWh[i]);
+    if (!value || !findInt(value, style))
       style=1;
     else if (style<=0 || style>=4)
     {
@@ -586,8 +978,8 @@ void libabw::ABWContentCollector::_addBorderProperties(const std::map<std::strin
     }
     ABWUnit unit(ABW_NONE);
     double width(0.0);
-    tmp=whString+"-thickness";
-    if (map.find(tmp)==map.end() || !findDouble(map.find(tmp)->second, width, unit))
+    value=map.find(thicknessWh[i]);
+    if (!value || !findDouble(value, width, unit))
       width=0.01;
     else if (width<=0 || unit != ABW_IN)
       continue;
@@ -618,17 +1010,7 @@ void libabw::ABWContentCollector::collectParagraphProperties(const char *level,
   if (!listid || !findInt(listid, m_ps->m_currentListId) || m_ps->m_currentListId < 0)
     m_ps->m_currentListId = 0;
 
-  m_ps->m_currentParagraphStyle.clear();
-  if (style)
-    _recurseTextProperties(style, m_ps->m_currentParagraphStyle);
-  else
-    _recurseTextProperties("Normal", m_ps->m_currentParagraphStyle);
-
-  ABWPropertyMap tmpProps;
-  if (props)
-    parsePropString(props, tmpProps);
-  for (ABWPropertyMap::const_iterator iter = tmpProps.begin(); iter != tmpProps.end(); ++iter)
-    m_ps->m_currentParagraphStyle[iter->first] = iter->second;
+  m_ps->m_currentParagraphFormat = &_getParagraphFormat(style ? style : "Normal", props);
   m_ps->m_inParagraphOrListElement = true;
 }
 
@@ -639,15 +1021,28 @@ void libabw::ABWContentCollector::collectCharacterProperties(const char *style,
   if (m_ps->m_isSpanOpened)
     _closeSpan();
 
-  m_ps->m_currentCharacterStyle.clear();
-  if (style)
-    _recurseTextProperties(style, m_ps->m_currentCharacterStyle);
+  if (!style && !props)
+  {
+    m_ps->m_currentCharacterStyle = 0;
+    return;
+  }
 
-  ABWPropertyMap tmpProps;
-  if (props)
-    parsePropString(props, tmpProps);
-  for (ABWPropertyMap::const_iterator iter = tmpProps.begin(); iter != tmpProps.end(); ++iter)
-    m_ps->m_currentCharacterStyle[iter->first] = iter->second;
+  const StyleKey_t key(style ? &_getTextStyle(style) : 0, props ? &m_propertyCache.get(props) : 0);
+  const boost::unordered_map<StyleKey_t, const ABWPropertyMap *, boost::hash<StyleKey_t> >::const_iterator it = m_characterStyleIndex.find(key);
+  if (it != m_characterStyleIndex.end())
+  {
+    m_ps->m_currentCharacterStyle = it->second;
+    return;
+  }
+
+  m_characterStyles.push_back(ABWPropertyMap());
+  ABWPropertyMap &characterStyle = m_characterStyles.back();
+  if (key.first)
+    characterStyle = *key.first;
+  if (key.second)
+    characterStyle.merge(*key.second);
+  m_characterStyleIndex[key] = &characterStyle;
+  m_ps->m_currentCharacterStyle = &characterStyle;
 }
 
 void libabw::ABWContentCollector::collectSectionProperties(const char *footer, const char *footerLeft, const char *footerFirst, const char *footerLast,
@@ -671,35 +1066,21 @@ void libabw::ABWContentCollector::collectSectionProperties(const char *footer, c
   int footerLastId = m_ps->m_footerLastId;
 
   m_ps->m_currentSectionStyle.clear();
-  ABWPropertyMap tmpProps;
   if (props)
-    parsePropString(props, tmpProps);
+    parsePropString(props, m_ps->m_currentSectionStyle);
 
+  static const int marginIds[4] = { PROP_PAGE_MARGIN_RIGHT, PROP_PAGE_MARGIN_LEFT, PROP_PAGE_MARGIN_TOP, PROP_PAGE_MARGIN_BOTTOM };
+  double *const margins[4] = { &m_ps->m_pageMarginRight, &m_ps->m_pageMarginLeft, &m_ps->m_pageMarginTop, &m_ps->m_pageMarginBottom };
   ABWUnit unit(ABW_NONE);
   double value(0.0);
-  for (ABWPropertyMap::const_iterator iter = tmpProps.begin(); iter != tmpProps.end(); ++iter)
+  for (int i = 0; i < 4; ++i)
   {
-    if (iter->first == "page-margin-right" && !iter->second.empty() && fabs(m_ps->m_pageMarginRight) < ABW_EPSILON)
-    {
-      if (findDouble(iter->second, value, unit) && unit == ABW_IN && value > 0.0 && fabs(value) > ABW_EPSILON)
-        m_ps->m_pageMarginRight = value;
-    }
-    else if (iter->first == "page-margin-left" && !iter->second.empty() && fabs(m_ps->m_pageMarginLeft) < ABW_EPSILON)
-    {
-      if (findDouble(iter->second, value, unit) && unit == ABW_IN && value > 0.0 && fabs(value) > ABW_EPSILON)
-        m_ps->m_pageMarginLeft = value;
-    }
-    else if (iter->first == "page-margin-top" && !iter->second.empty() && fabs(m_ps->m_pageMarginTop) < ABW_EPSILON)
-    {
-      if (findDouble(iter->second, value, unit) && unit == ABW_IN && value > 0.0 && fabs(value) > ABW_EPSILON)
-        m_ps->m_pageMarginTop = value;
-    }
-    else if (iter->first == "page-margin-bottom" && !iter->second.empty() && fabs(m_ps->m_pageMarginBottom) < ABW_EPSILON)
+    const char *const margin = m_ps->m_currentSectionStyle.find(marginIds[i]);
+    if (margin && *margin && fabs(*margins[i]) < ABW_EPSILON)
     {
-      if (findDouble(iter->second, value, unit) && unit == ABW_IN && value > 0.0 && fabs(value) > ABW_EPSILON)
-        m_ps->m_pageMarginBottom = value;
+      if (findDouble(margin, value, unit) && unit == ABW_IN && value > 0.0 && fabs(value) > ABW_EPSILON)
+        *margins[i] = value;
     }
-    m_ps->m_currentSectionStyle[iter->first] = iter->second;
   }
 
   int intValue(0);
@@ -767,6 +1148,9 @@ void libabw::ABWContentCollector::collectSectionProperties(const char *footer, c
 
 void libabw::ABWContentCollector::collectHeaderFooter(const char *id, const char *type)
 {
+  if (m_headerFooterTableIds && m_headerFooterCounter < m_headerFooterTableIds->size())
+    m_tableCounter = (*m_headerFooterTableIds)[m_headerFooterCounter++];
+
   if (!id || !findInt(id, m_ps->m_currentHeaderFooterId))
     m_ps->m_currentHeaderFooterId = -1;
 
@@ -811,14 +1195,99 @@ void libabw::ABWContentCollector::collectPageSize(const char *width, const char
     m_ps->m_pageHeight = value;
 }
 
+void libabw::ABWContentCollector::setHeaderFooterTableIds(const std::vector<int> &tableIds)
+{
+  m_headerFooterTableIds = &tableIds;
+  m_headerFooterCounter = 0;
+}
+
+void libabw::ABWContentCollector::startStreaming(const ABWContentCollector *const headerFooterCollector, const bool pipelined)
+{
+  m_outputElements->startStreaming(m_iface, headerFooterCollector ? headerFooterCollector->m_outputElements.get() : 0, pipelined);
+}
+
+void libabw::ABWContentCollector::setCompactEvents(const bool compact)
+{
+  m_outputElements->setCompactEvents(compact);
+}
+
+void libabw::ABWContentCollector::setMemoryLimit(const unsigned long limit)
+{
+  m_outputElements->setMemoryLimit(limit);
+}
+
+boost::shared_ptr<const libabw::ABWOutputElements> libabw::ABWContentCollector::getOutputElements() const
+{
+  return m_outputElements;
+}
+
+void libabw::ABWContentCollector::continueDocument()
+{
+  m_ps->m_isDocumentStarted = true;
+}
+
+libabw::ABWSectionBoundary libabw::ABWContentCollector::getSectionBoundary() const
+{
+  ABWSectionBoundary boundary;
+  boundary.m_isClean = m_parsingStates.empty() && !m_ps->m_isNote
+                       && !m_ps->m_isSectionOpened && !m_ps->m_isHeaderOpened && !m_ps->m_isFooterOpened
+                       && !m_ps->m_isSpanOpened && !m_ps->m_isParagraphOpened && !m_ps->m_isListElementOpened
+                       && !m_ps->m_inParagraphOrListElement
+                       && m_ps->m_currentListLevel == 0
+                       && m_ps->m_tableStates.empty() && m_ps->m_listLevels.empty();
+  boundary.m_isPageSpanOpened = m_ps->m_isPageSpanOpened;
+  boundary.m_pageMarginTop = m_ps->m_pageMarginTop;
+  boundary.m_pageMarginBottom = m_ps->m_pageMarginBottom;
+  boundary.m_pageMarginLeft = m_ps->m_pageMarginLeft;
+  boundary.m_pageMarginRight = m_ps->m_pageMarginRight;
+  const int footerIds[4] = { m_ps->m_footerId, m_ps->m_footerLeftId, m_ps->m_footerFirstId, m_ps->m_footerLastId };
+  const int headerIds[4] = { m_ps->m_headerId, m_ps->m_headerLeftId, m_ps->m_headerFirstId, m_ps->m_headerLastId };
+  for (int i = 0; i < 4; ++i)
+  {
+    boundary.m_footerIds[i] = footerIds[i];
+    boundary.m_headerIds[i] = headerIds[i];
+  }
+  boundary.m_deferredPageBreak = m_ps->m_deferredPageBreak;
+  boundary.m_deferredColumnBreak = m_ps->m_deferredColumnBreak;
+  boundary.m_isFirstTextInListElement = m_ps->m_isFirstTextInListElement;
+  boundary.m_parsingContext = m_ps->m_parsingContext;
+  boundary.m_currentHeaderFooterId = m_ps->m_currentHeaderFooterId;
+  boundary.m_currentHeaderFooterOccurrence = m_ps->m_currentHeaderFooterOccurrence;
+  boundary.m_tableCounter = m_tableCounter;
+  return boundary;
+}
+
+void libabw::ABWContentCollector::setSectionBoundary(const ABWSectionBoundary &boundary)
+{
+  m_ps->m_isPageSpanOpened = boundary.m_isPageSpanOpened;
+  m_ps->m_pageMarginTop = boundary.m_pageMarginTop;
+  m_ps->m_pageMarginBottom = boundary.m_pageMarginBottom;
+  m_ps->m_pageMarginLeft = boundary.m_pageMarginLeft;
+  m_ps->m_pageMarginRight = boundary.m_pageMarginRight;
+  int *const footerIds[4] = { &m_ps->m_footerId, &m_ps->m_footerLeftId, &m_ps->m_footerFirstId, &m_ps->m_footerLastId };
+  int *const headerIds[4] = { &m_ps->m_headerId, &m_ps->m_headerLeftId, &m_ps->m_headerFirstId, &m_ps->m_headerLastId };
+  for (int i = 0; i < 4; ++i)
+  {
+    *footerIds[i] = boundary.m_footerIds[i];
+    *headerIds[i] = boundary.m_headerIds[i];
+  }
+  m_ps->m_deferredPageBreak = boundary.m_deferredPageBreak;
+  m_ps->m_deferredColumnBreak = boundary.m_deferredColumnBreak;
+  m_ps->m_isFirstTextInListElement = boundary.m_isFirstTextInListElement;
+  m_ps->m_parsingContext = boundary.m_parsingContext;
+  m_ps->m_currentHeaderFooterId = boundary.m_currentHeaderFooterId;
+  m_ps->m_currentHeaderFooterOccurrence = boundary.m_currentHeaderFooterOccurrence;
+  m_tableCounter = boundary.m_tableCounter;
+}
+
 void libabw::ABWContentCollector::startDocument()
 {
   if (!m_ps->m_isNote && m_ps->m_tableStates.empty())
   {
 
-    if (m_iface && !m_ps->m_isDocumentStarted)
+    if (!m_ps->m_isDocumentStarted)
     {
-      m_iface->startDocument(librevenge::RVNGPropertyList());
+      m_outputElements->addStartDocument(librevenge::RVNGPropertyList());
       _setMetadata();
     }
 
@@ -846,11 +1315,9 @@ void libabw::ABWContentCollector::endDocument()
 
     _closePageSpan();
 
+    m_outputElements->addEndDocument();
     if (m_iface)
-    {
-      m_outputElements.write(m_iface);
-      m_iface->endDocument();
-    }
+      m_outputElements->write(m_iface);
   }
 }
 
@@ -881,8 +1348,7 @@ void libabw::ABWContentCollector::_setMetadata()
   if (!prop.empty())
     propList.insert("meta:initial-creator", prop.c_str());
 
-  if (m_iface)
-    m_iface->setDocumentMetaData(propList);
+  m_outputElements->addSetDocumentMetaData(propList);
 }
 
 void libabw::ABWContentCollector::endSection()
@@ -901,7 +1367,7 @@ void libabw::ABWContentCollector::closeParagraphOrListElement()
     _openSpan();
   _closeParagraph();
   _closeListElement();
-  m_ps->m_currentParagraphStyle.clear();
+  m_ps->m_currentParagraphFormat = 0;
   m_ps->m_inParagraphOrListElement = false;
 }
 
@@ -920,7 +1386,7 @@ void libabw::ABWContentCollector::openLink(const char *href)
   librevenge::RVNGPropertyList propList;
   if (href)
     propList.insert("xlink:href", decodeUrl(href).c_str());
-  m_outputElements.addOpenLink(propList);
+  m_outputElements->addOpenLink(propList);
   if (!m_ps->m_isSpanOpened)
     _openSpan();
 }
@@ -929,13 +1395,13 @@ void libabw::ABWContentCollector::closeLink()
 {
   if (m_ps->m_isSpanOpened)
     _closeSpan();
-  m_outputElements.addCloseLink();
+  m_outputElements->addCloseLink();
 }
 
 void libabw::ABWContentCollector::closeSpan()
 {
   _closeSpan();
-  m_ps->m_currentCharacterStyle.clear();
+  m_ps->m_currentCharacterStyle = 0;
 }
 
 void libabw::ABWContentCollector::insertLineBreak()
@@ -943,7 +1409,7 @@ void libabw::ABWContentCollector::insertLineBreak()
   if (!m_ps->m_isSpanOpened)
     _openSpan();
 
-  m_outputElements.addInsertLineBreak();
+  m_outputElements->addInsertLineBreak();
 }
 
 void libabw::ABWContentCollector::insertColumnBreak()
@@ -969,9 +1435,9 @@ void libabw::ABWContentCollector::insertText(const char *text)
   if (!text)
     return;
   if (m_ps->m_isFirstTextInListElement && text[0] == '\t')
-    separateSpacesAndInsertText(m_outputElements, text+1);
+    separateSpacesAndInsertText(*m_outputElements, text+1);
   else
-    separateSpacesAndInsertText(m_outputElements, text);
+    separateSpacesAndInsertText(*m_outputElements, text);
   m_ps->m_isFirstTextInListElement = false;
 }
 
@@ -992,7 +1458,7 @@ void libabw::ABWContentCollector::_openPageSpan()
     propList.insert("fo:margin-bottom", m_ps->m_pageMarginBottom);
 
     if (!m_ps->m_isPageSpanOpened)
-      m_outputElements.addOpenPageSpan(propList,
+      m_outputElements->addOpenPageSpan(propList,
                                        m_ps->m_footerId, m_ps->m_footerLeftId,
                                        m_ps->m_footerFirstId, m_ps->m_footerLastId,
                                        m_ps->m_headerId, m_ps->m_headerLeftId,
@@ -1009,7 +1475,7 @@ void libabw::ABWContentCollector::_closePageSpan()
     _closeFooter();
     _closeSection();
 
-    m_outputElements.addClosePageSpan();
+    m_outputElements->addClosePageSpan();
   }
   m_ps->m_isPageSpanOpened = false;
 }
@@ -1025,25 +1491,25 @@ void libabw::ABWContentCollector::_openSection()
 
     ABWUnit unit(ABW_NONE);
     double value(0.0);
-    if (findDouble(_findSectionProperty("page-margin-right"), value, unit) && unit == ABW_IN)
+    if (findDouble(_findSectionProperty(PROP_PAGE_MARGIN_RIGHT), value, unit) && unit == ABW_IN)
       propList.insert("fo:margin-right", value - m_ps->m_pageMarginRight);
 
-    if (findDouble(_findSectionProperty("page-margin-left"), value, unit) && unit == ABW_IN)
+    if (findDouble(_findSectionProperty(PROP_PAGE_MARGIN_LEFT), value, unit) && unit == ABW_IN)
       propList.insert("fo:margin-left", value - m_ps->m_pageMarginLeft);
 
-    if (findDouble(_findSectionProperty("section-space-after"), value, unit) && unit == ABW_IN)
+    if (findDouble(_findSectionProperty(PROP_SECTION_SPACE_AFTER), value, unit) && unit == ABW_IN)
       propList.insert("librevenge:margin-bottom", value);
 
-    std::string sValue = _findSectionProperty("dom-dir");
+    std::string sValue = _findSectionProperty(PROP_DOM_DIR);
     if (sValue.empty()) // try document default
-      sValue = _findDocumentProperty("dom-dir");
+      sValue = _findDocumentProperty(PROP_DOM_DIR);
     if (sValue == "ltr")
       propList.insert("style:writing-mode", "lr-tb");
     else if (sValue == "rtl")
       propList.insert("style:writing-mode", "rl-tb");
 
     int intValue(0);
-    if (findInt(_findSectionProperty("columns"), intValue) && intValue > 1)
+    if (findInt(_findSectionProperty(PROP_COLUMNS), intValue) && intValue > 1)
     {
       librevenge::RVNGPropertyListVector columns;
       for (int i = 0; i < intValue; ++i)
@@ -1058,7 +1524,7 @@ void libabw::ABWContentCollector::_openSection()
         propList.insert("text:dont-balance-text-columns", true);
       }
     }
-    m_outputElements.addOpenSection(propList);
+    m_outputElements->addOpenSection(propList);
   }
   m_ps->m_isSectionOpened = true;
 }
@@ -1070,7 +1536,7 @@ void libabw::ABWContentCollector::_openFooter()
     librevenge::RVNGPropertyList propList;
     propList.insert("librevenge:occurrence", m_ps->m_currentHeaderFooterOccurrence);
 
-    m_outputElements.addOpenFooter(propList, m_ps->m_currentHeaderFooterId);
+    m_outputElements->addOpenFooter(propList, m_ps->m_currentHeaderFooterId);
   }
   m_ps->m_isFooterOpened = true;
 }
@@ -1082,7 +1548,7 @@ void libabw::ABWContentCollector::_openHeader()
     librevenge::RVNGPropertyList propList;
     propList.insert("librevenge:occurrence", m_ps->m_currentHeaderFooterOccurrence);
 
-    m_outputElements.addOpenHeader(propList, m_ps->m_currentHeaderFooterId);
+    m_outputElements->addOpenHeader(propList, m_ps->m_currentHeaderFooterId);
   }
   m_ps->m_isHeaderOpened = true;
 }
@@ -1090,88 +1556,12 @@ void libabw::ABWContentCollector::_openHeader()
 void libabw::ABWContentCollector::_fillParagraphProperties(librevenge::RVNGPropertyList &propList,
                                                            bool isListElement)
 {
-  ABWUnit unit(ABW_NONE);
-  double value(0.0);
-  int intValue(0);
-  std::string sValue;
-
-  if (findDouble(_findParagraphProperty("margin-right"), value, unit) && unit == ABW_IN)
-    propList.insert("fo:margin-right", value);
-
-  if (findDouble(_findParagraphProperty("margin-top"), value, unit) && unit == ABW_IN)
-    propList.insert("fo:margin-top", value);
-
-  if (findDouble(_findParagraphProperty("margin-bottom"), value, unit) && unit == ABW_IN)
-    propList.insert("fo:margin-bottom", value);
-
-  if (!isListElement)
-  {
-    if (findDouble(_findParagraphProperty("margin-left"), value, unit) && unit == ABW_IN)
-      propList.insert("fo:margin-left", value);
-
-    if (findDouble(_findParagraphProperty("text-indent"), value, unit) && unit == ABW_IN)
-      propList.insert("fo:text-indent", value);
-
-    // TODO: Numbered headings should probably not be handled as lists.
-    // Just do not make them headings for now.
-    sValue = _findParagraphProperty("libabw:outline-level");
-    if (!sValue.empty())
-      propList.insert("text:outline-level", sValue.c_str());
-  }
-
-  sValue = _findParagraphProperty("text-align");
-  if (!sValue.empty())
-  {
-    if (sValue == "left")
-      propList.insert("fo:text-align", "start");
-    else if (sValue == "right")
-      propList.insert("fo:text-align", "end");
-    else
-      propList.insert("fo:text-align", sValue.c_str());
-  }
-
-  sValue = _findParagraphProperty("line-height");
-  if (!sValue.empty())
-  {
-    std::string propName("fo:line-height");
-    size_t position = sValue.find_last_of('+');
-    if (position && position != std::string::npos)
-    {
-      propName = "style:line-height-at-least";
-      sValue.erase(position);
-    }
-    if (findDouble(sValue, value, unit))
-    {
-      if (ABW_IN == unit)
-        propList.insert(propName.c_str(), value);
-      else if (ABW_PERCENT == unit)
-        propList.insert(propName.c_str(), value, librevenge::RVNG_PERCENT);
-    }
-  }
-
-  if (findInt(_findParagraphProperty("orphans"), intValue))
-    propList.insert("fo:orphans", intValue);
-
-  if (findInt(_findParagraphProperty("widows"), intValue))
-    propList.insert("fo:widows", intValue);
-
-  librevenge::RVNGPropertyListVector tabStops;
-  parseTabStops(_findParagraphProperty("tabstops"), tabStops);
-
-  if (tabStops.count())
-    propList.insert("style:tab-stops", tabStops);
-
-  sValue = _findParagraphProperty("dom-dir");
-  if (sValue == "ltr")
-    propList.insert("style:writing-mode", "lr-tb");
-  else if (sValue == "rtl")
-    propList.insert("style:writing-mode", "rl-tb");
+  _getCurrentParagraphFormat().write(propList, isListElement);
 
   if (m_ps->m_deferredPageBreak)
     propList.insert("fo:break-before", "page");
   else if (m_ps->m_deferredColumnBreak)
     propList.insert("fo:break-before", "column");
-  _addBorderProperties(m_ps->m_currentParagraphStyle, propList);
   m_ps->m_deferredPageBreak = false;
   m_ps->m_deferredColumnBreak = false;
 }
@@ -1208,7 +1598,7 @@ void libabw::ABWContentCollector::_openParagraph()
     m_ps->m_deferredPageBreak = false;
     m_ps->m_deferredColumnBreak = false;
 
-    m_outputElements.addOpenParagraph(propList);
+    m_outputElements->addOpenParagraph(propList);
 
     m_ps->m_isParagraphOpened = true;
     if (!m_ps->m_tableStates.empty())
@@ -1245,7 +1635,7 @@ void libabw::ABWContentCollector::_openListElement()
     librevenge::RVNGPropertyList propList;
     _fillParagraphProperties(propList, true);
 
-    m_outputElements.addOpenListElement(propList);
+    m_outputElements->addOpenListElement(propList);
 
     m_ps->m_isListElementOpened = true;
     if (!m_ps->m_tableStates.empty())
@@ -1267,90 +1657,8 @@ void libabw::ABWContentCollector::_openSpan()
     }
 
     librevenge::RVNGPropertyList propList;
-    ABWUnit unit(ABW_NONE);
-    double value(0.0);
-
-    if (findDouble(_findCharacterProperty("font-size"), value, unit) && unit == ABW_IN)
-      propList.insert("fo:font-size", value);
-
-    std::string sValue = _findCharacterProperty("font-family");
-    if (!sValue.empty())
-      propList.insert("style:font-name", sValue.c_str());
-
-    sValue = _findCharacterProperty("font-style");
-    if (!sValue.empty() && sValue != "normal")
-      propList.insert("fo:font-style", sValue.c_str());
-
-    sValue = _findCharacterProperty("font-weight");
-    if (!sValue.empty() && sValue != "normal")
-      propList.insert("fo:font-weight", sValue.c_str());
-
-    sValue = _findCharacterProperty("display");
-    if (!sValue.empty() && sValue == "none")
-      propList.insert("text:display", "none");
-
-    sValue = _findCharacterProperty("dir-override");
-    if (!sValue.empty() && sValue == "rtl")
-      propList.insert("style:writing-mode", "rl-tb");
-
-    sValue = _findCharacterProperty("text-decoration");
-    std::vector<std::string> listDecorations;
-    separateSpacesAndReturnsListOfArgs(sValue, listDecorations);
-    for (size_t j=0; j<listDecorations.size(); ++j)
-    {
-      std::string const &decoration=listDecorations[j];
-      if (decoration == "underline")
-      {
-        propList.insert("style:text-underline-type", "single");
-        propList.insert("style:text-underline-style", "solid");
-      }
-      else if (decoration == "line-through")
-      {
-        propList.insert("style:text-line-through-type", "single");
-        propList.insert("style:text-line-through-style", "solid");
-      }
-      else if (decoration == "overline")
-      {
-        propList.insert("style:text-overline-type", "single");
-        propList.insert("style:text-overline-style", "solid");
-      }
-    }
-    sValue = getColor(_findCharacterProperty("color"));
-    if (!sValue.empty())
-      propList.insert("fo:color", sValue.c_str());
-
-    sValue = getColor(_findCharacterProperty("bgcolor"));
-    if (!sValue.empty())
-      propList.insert("fo:background-color", sValue.c_str());
-
-    sValue = _findCharacterProperty("text-position");
-    if (sValue == "subscript")
-      propList.insert("style:text-position", "sub");
-    else if (sValue == "superscript")
-      propList.insert("style:text-position", "super");
-
-    sValue = _findCharacterProperty("lang");
-    if (sValue.empty()) // try document default
-      sValue = _findDocumentProperty("lang");
-
-    if (!sValue.empty())
-    {
-      optional<std::string> lang;
-      optional<std::string> country;
-      optional<std::string> script;
-
-      parseLang(sValue, lang, country, script);
-
-      if (bool(lang))
-        propList.insert("fo:language", get(lang).c_str());
-      if (bool(country))
-        propList.insert("fo:country", get(country).c_str());
-      if (bool(script))
-        propList.insert("fo:script", get(script).c_str());
-    }
-
-    // do we need to check "font-stretch" here or it is always equal to normal ?
-    m_outputElements.addOpenSpan(propList);
+    _getCurrentCharacterFormat().write(propList);
+    m_outputElements->addOpenSpan(propList);
   }
   m_ps->m_isSpanOpened = true;
 }
@@ -1367,7 +1675,7 @@ void libabw::ABWContentCollector::_closeSection()
     m_ps->m_currentListLevel = 0;
     _changeList();
 
-    m_outputElements.addCloseSection();
+    m_outputElements->addCloseSection();
 
     m_ps->m_isSectionOpened = false;
   }
@@ -1385,7 +1693,7 @@ void libabw::ABWContentCollector::_closeHeader()
     m_ps->m_currentListLevel = 0;
     _changeList();
 
-    m_outputElements.addCloseHeader();
+    m_outputElements->addCloseHeader();
 
     m_ps->m_isHeaderOpened = false;
   }
@@ -1405,7 +1713,7 @@ void libabw::ABWContentCollector::_closeFooter()
     m_ps->m_currentListLevel = 0;
     _changeList();
 
-    m_outputElements.addCloseFooter();
+    m_outputElements->addCloseFooter();
 
     m_ps->m_isFooterOpened = false;
   }
@@ -1420,7 +1728,7 @@ void libabw::ABWContentCollector::_closeParagraph()
     if (m_ps->m_isSpanOpened)
       _closeSpan();
 
-    m_outputElements.addCloseParagraph();
+    m_outputElements->addCloseParagraph();
   }
   m_ps->m_isParagraphOpened = false;
 }
@@ -1428,7 +1736,7 @@ void libabw::ABWContentCollector::_closeParagraph()
 void libabw::ABWContentCollector::_closeSpan()
 {
   if (m_ps->m_isSpanOpened)
-    m_outputElements.addCloseSpan();
+    m_outputElements->addCloseSpan();
 
   m_ps->m_isSpanOpened = false;
 }
@@ -1461,7 +1769,7 @@ void libabw::ABWContentCollector::_openTable()
   m_ps->m_deferredColumnBreak = false;
 
   librevenge::RVNGPropertyListVector tmpColumns;
-  parseTableColumns(_findTableProperty("table-column-props"), tmpColumns);
+  parseTableColumns(_findTableProperty(PROP_TABLE_COLUMN_PROPS), tmpColumns);
   unsigned numColumns = unsigned(tmpColumns.count());
   std::map<int, int>::const_iterator iter = m_tableSizes.find(m_ps->m_tableStates.top().m_currentTableId);
   if (iter != m_tableSizes.end())
@@ -1479,7 +1787,7 @@ void libabw::ABWContentCollector::_openTable()
 
   ABWUnit unit(ABW_NONE);
   double value(0.0);
-  if (findDouble(_findTableProperty("table-column-leftpos"), value, unit) && unit == ABW_IN)
+  if (findDouble(_findTableProperty(PROP_TABLE_COLUMN_LEFTPOS), value, unit) && unit == ABW_IN)
   {
     propList.insert("fo:margin-left", value);
     propList.insert("table:align", "margins");
@@ -1487,7 +1795,7 @@ void libabw::ABWContentCollector::_openTable()
   else
     propList.insert("table:align", "left");
 
-  m_outputElements.addOpenTable(propList);
+  m_outputElements->addOpenTable(propList);
 
   m_ps->m_tableStates.top().m_currentTableRow = (-1);
   m_ps->m_tableStates.top().m_currentTableCol = (-1);
@@ -1501,7 +1809,7 @@ void libabw::ABWContentCollector::_closeTable()
     if (m_ps->m_tableStates.top().m_isTableRowOpened)
       _closeTableRow();
 
-    m_outputElements.addCloseTable();
+    m_outputElements->addCloseTable();
 
     m_ps->m_tableStates.pop();
   }
@@ -1515,7 +1823,7 @@ void libabw::ABWContentCollector::_openTableRow()
   m_ps->m_tableStates.top().m_currentTableCol = 0;
   m_ps->m_tableStates.top().m_currentTableCellNumberInRow = 0;
 
-  m_outputElements.addOpenTableRow(librevenge::RVNGPropertyList());
+  m_outputElements->addOpenTableRow(librevenge::RVNGPropertyList());
 
   m_ps->m_tableStates.top().m_isTableRowOpened = true;
   m_ps->m_tableStates.top().m_isRowWithoutCell = true;
@@ -1532,9 +1840,9 @@ void libabw::ABWContentCollector::_closeTableRow()
     if (m_ps->m_tableStates.top().m_isRowWithoutCell)
     {
       m_ps->m_tableStates.top().m_isRowWithoutCell = false;
-      m_outputElements.addInsertCoveredTableCell(librevenge::RVNGPropertyList());
+      m_outputElements->addInsertCoveredTableCell(librevenge::RVNGPropertyList());
     }
-    m_outputElements.addCloseTableRow();
+    m_outputElements->addCloseTableRow();
   }
   m_ps->m_tableStates.top().m_isTableRowOpened = false;
 }
@@ -1546,20 +1854,20 @@ void libabw::ABWContentCollector::_openTableCell()
   propList.insert("librevenge:row", m_ps->m_tableStates.top().m_currentTableRow);
 
   int rightAttach(0);
-  if (findInt(_findCellProperty("right-attach"), rightAttach))
+  if (findInt(_findCellProperty(PROP_RIGHT_ATTACH), rightAttach))
     propList.insert("table:number-columns-spanned", rightAttach - m_ps->m_tableStates.top().m_currentTableCol);
 
   int botAttach(0);
-  if (findInt(_findCellProperty("bot-attach"), botAttach))
+  if (findInt(_findCellProperty(PROP_BOT_ATTACH), botAttach))
     propList.insert("table:number-rows-spanned", botAttach - m_ps->m_tableStates.top().m_currentTableRow);
 
-  std::string bgColor = getColor(_findCellProperty("background-color"));
+  std::string bgColor = getColor(_findCellProperty(PROP_BACKGROUND_COLOR));
   if (!bgColor.empty())
     propList.insert("fo:background-color", bgColor.c_str());
 
   // by default, table cells have a small border
-  _addBorderProperties(m_ps->m_tableStates.top().m_currentCellProperties, propList,"0.01in solid #000000");
-  m_outputElements.addOpenTableCell(propList);
+  _addBorderProperties(*m_ps->m_tableStates.top().m_currentCellProperties, propList,"0.01in solid #000000");
+  m_outputElements->addOpenTableCell(propList);
 
   m_ps->m_tableStates.top().m_currentTableCellNumberInRow++;
   m_ps->m_tableStates.top().m_isTableCellOpened = true;
@@ -1578,7 +1886,7 @@ void libabw::ABWContentCollector::_closeTableCell()
     m_ps->m_currentListLevel = 0;
     _changeList();
 
-    m_outputElements.addCloseTableCell();
+    m_outputElements->addCloseTableCell();
   }
   m_ps->m_tableStates.top().m_isTableCellOpened = false;
 }
@@ -1592,7 +1900,7 @@ void libabw::ABWContentCollector::openFoot(const char *id)
   librevenge::RVNGPropertyList propList;
   if (id)
     propList.insert("librevenge:number", id);
-  m_outputElements.addOpenFootnote(propList);
+  m_outputElements->addOpenFootnote(propList);
 
   m_parsingStates.push(m_ps);
   m_ps = new ABWContentParsingState();
@@ -1607,7 +1915,7 @@ void libabw::ABWContentCollector::closeFoot()
   m_ps->m_currentListLevel = 0;
   _changeList();
 
-  m_outputElements.addCloseFootnote();
+  m_outputElements->addCloseFootnote();
 
   if (!m_parsingStates.empty())
   {
@@ -1626,7 +1934,7 @@ void libabw::ABWContentCollector::openEndnote(const char *id)
   librevenge::RVNGPropertyList propList;
   if (id)
     propList.insert("librevenge:number", id);
-  m_outputElements.addOpenEndnote(propList);
+  m_outputElements->addOpenEndnote(propList);
 
   m_parsingStates.push(m_ps);
   m_ps = new ABWContentParsingState();
@@ -1641,7 +1949,7 @@ void libabw::ABWContentCollector::closeEndnote()
   m_ps->m_currentListLevel = 0;
   _changeList();
 
-  m_outputElements.addCloseEndnote();
+  m_outputElements->addCloseEndnote();
 
   if (!m_parsingStates.empty())
   {
@@ -1680,8 +1988,8 @@ void libabw::ABWContentCollector::openTable(const char *props)
 
   m_ps->m_tableStates.push(ABWContentTableState());
   m_ps->m_tableStates.top().m_currentTableId = m_tableCounter++;
-  if (props)
-    parsePropString(props, m_ps->m_tableStates.top().m_currentTableProperties);
+  m_ps->m_tableStates.top().m_currentTableProperties = &m_propertyCache.get(props);
+  m_ps->m_tableStates.top().m_currentCellProperties = &m_propertyCache.get(0);
 
   _openTable();
 }
@@ -1699,10 +2007,9 @@ void libabw::ABWContentCollector::openCell(const char *props)
 {
   if (!m_ps->m_tableStates.empty())
   {
-    if (props)
-      parsePropString(props, m_ps->m_tableStates.top().m_currentCellProperties);
+    m_ps->m_tableStates.top().m_currentCellProperties = &m_propertyCache.get(props);
     int currentRow(0);
-    if (!findInt(_findCellProperty("top-attach"), currentRow))
+    if (!findInt(_findCellProperty(PROP_TOP_ATTACH), currentRow))
       currentRow = m_ps->m_tableStates.top().m_currentTableRow + 1;
     while (m_ps->m_tableStates.top().m_currentTableRow < currentRow)
     {
@@ -1711,7 +2018,7 @@ void libabw::ABWContentCollector::openCell(const char *props)
       _openTableRow();
     }
 
-    if (!findInt(_findCellProperty("left-attach"), m_ps->m_tableStates.top().m_currentTableCol))
+    if (!findInt(_findCellProperty(PROP_LEFT_ATTACH), m_ps->m_tableStates.top().m_currentTableCol))
       m_ps->m_tableStates.top().m_currentTableCol++;
   }
 }
@@ -1721,11 +2028,11 @@ void libabw::ABWContentCollector::closeCell()
   if (!m_ps->m_tableStates.empty())
   {
     _closeTableCell();
-    m_ps->m_tableStates.top().m_currentCellProperties.clear();
+    m_ps->m_tableStates.top().m_currentCellProperties = &m_propertyCache.get(0);
   }
 }
 
-void libabw::ABWContentCollector::collectData(const char *, const char *, const librevenge::RVNGBinaryData &)
+void libabw::ABWContentCollector::collectData(const char *, const ABWData &)
 {
 }
 
@@ -1734,9 +2041,7 @@ void libabw::ABWContentCollector::insertImage(const char *dataid, const char *pr
   if (!m_ps->m_isSpanOpened)
     _openSpan();
 
-  ABWPropertyMap properties;
-  if (props)
-    parsePropString(props, properties);
+  const ABWPropertyMap &properties = m_propertyCache.get(props);
   if (dataid)
   {
     std::map<std::string, ABWData>::const_iterator iter = m_data.find(dataid);
@@ -1745,22 +2050,22 @@ void libabw::ABWContentCollector::insertImage(const char *dataid, const char *pr
       librevenge::RVNGPropertyList propList;
       ABWUnit unit(ABW_NONE);
       double value(0.0);
-      ABWPropertyMap::const_iterator i = properties.find("height");
-      if (i != properties.end() && findDouble(i->second, value, unit) && ABW_IN == unit)
+      const char *i = properties.find(PROP_HEIGHT);
+      if (i && findDouble(i, value, unit) && ABW_IN == unit)
         propList.insert("svg:height", value);
-      i = properties.find("width");
-      if (i != properties.end() && findDouble(i->second, value, unit) && ABW_IN == unit)
+      i = properties.find(PROP_WIDTH);
+      if (i && findDouble(i, value, unit) && ABW_IN == unit)
         propList.insert("svg:width", value);
       propList.insert("text:anchor-type", "as-char");
 
-      m_outputElements.addOpenFrame(propList);
+      m_outputElements->addOpenFrame(propList);
 
       propList.clear();
       propList.insert("librevenge:mime-type", iter->second.m_mimeType);
-      propList.insert("office:binary-data", iter->second.m_binaryData);
-      m_outputElements.addInsertBinaryObject(propList);
+      iter->second.writeOut(propList);
+      m_outputElements->addInsertBinaryObject(propList);
 
-      m_outputElements.addCloseFrame();
+      m_outputElements->addCloseFrame();
     }
   }
 }
@@ -1784,9 +2089,9 @@ void libabw::ABWContentCollector::_handleListChange()
     while (!m_ps->m_listLevels.empty() && m_ps->m_listLevels.top().first > m_ps->m_currentListLevel)
     {
       if (!m_ps->m_listLevels.top().second || m_ps->m_listLevels.top().second->getType() == ABW_UNORDERED)
-        m_outputElements.addCloseUnorderedListLevel();
+        m_outputElements->addCloseUnorderedListLevel();
       else
-        m_outputElements.addCloseOrderedListLevel();
+        m_outputElements->addCloseOrderedListLevel();
       ABW_DEBUG_MSG(("Popped level %i off the list level stack\n", m_ps->m_listLevels.top().first));
       m_ps->m_listLevels.pop();
     }
@@ -1803,7 +2108,7 @@ void libabw::ABWContentCollector::_writeOutDummyListLevels(int oldLevel, int new
     m_ps->m_listLevels.push(std::make_pair(newLevel, m_dummyListElements.back()));
     librevenge::RVNGPropertyList propList;
     m_dummyListElements.back()->writeOut(propList);
-    m_outputElements.addOpenUnorderedListLevel(propList);
+    m_outputElements->addOpenUnorderedListLevel(propList);
   }
 }
 
@@ -1825,9 +2130,9 @@ void libabw::ABWContentCollector::_recurseListLevels(int oldLevel, int newLevel,
     propList.insert("librevenge:list-id",
                     iter->second->m_listId ? iter->second->m_listId : newListId);
     if (iter->second->getType() == ABW_UNORDERED)
-      m_outputElements.addOpenUnorderedListLevel(propList);
+      m_outputElements->addOpenUnorderedListLevel(propList);
     else
-      m_outputElements.addOpenOrderedListLevel(propList);
+      m_outputElements->addOpenOrderedListLevel(propList);
   }
 }
 
@@ -1845,7 +2150,7 @@ void libabw::ABWContentCollector::_closeListElement()
     if (m_ps->m_isSpanOpened)
       _closeSpan();
 
-    m_outputElements.addCloseListElement();
+    m_outputElements->addCloseListElement();
   }
   m_ps->m_isListElementOpened = false;
   m_ps->m_isFirstTextInListElement = false;
@@ -1856,7 +2161,7 @@ void libabw::ABWContentCollector::addMetadataEntry(const char *const key, const
   assert(key);
   assert(value);
 
-  m_metadata[key] = value;
+  m_metadata.set(key, value);
 }
 
 /* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -10,9 +10,14 @@
 #ifndef __ABWCONTENTCOLLECTOR_H__
 #define __ABWCONTENTCOLLECTOR_H__
 
+#include <list>
 #include <vector>
 #include <stack>
-#include <set>
+#include <utility>
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <librevenge/librevenge.h>
 #include "ABWOutputElements.h"
 #include "ABWCollector.h"
@@ -36,14 +41,71 @@ struct ABWStyle
   ABWPropertyMap properties;
 };
 
+/** Paragraph formatting, resolved from a paragraph style and props.
+  */
+struct ABWParagraphFormat
+{
+  ABWParagraphFormat();
+  ~ABWParagraphFormat();
+
+  void write(librevenge::RVNGPropertyList &propList, bool isListElement) const;
+
+  // the merged style and props, for character property lookups
+  ABWPropertyMap m_properties;
+
+  boost::optional<double> m_marginRight;
+  boost::optional<double> m_marginTop;
+  boost::optional<double> m_marginBottom;
+  boost::optional<double> m_marginLeft;
+  boost::optional<double> m_textIndent;
+  std::string m_outlineLevel;
+  std::string m_textAlign;
+  boost::optional<double> m_lineHeight;
+  librevenge::RVNGUnit m_lineHeightUnit;
+  bool m_lineHeightAtLeast;
+  boost::optional<int> m_orphans;
+  boost::optional<int> m_widows;
+  librevenge::RVNGPropertyListVector m_tabStops;
+  std::string m_writingMode;
+  librevenge::RVNGPropertyList m_borders;
+};
+
+/** Character formatting, resolved from a character style and props
+    on top of a paragraph format.
+  */
+struct ABWCharacterFormat
+{
+  ABWCharacterFormat();
+  ~ABWCharacterFormat();
+
+  void write(librevenge::RVNGPropertyList &propList) const;
+
+  boost::optional<double> m_fontSize;
+  std::string m_fontName;
+  std::string m_fontStyle;
+  std::string m_fontWeight;
+  bool m_hidden;
+  bool m_rightToLeft;
+  bool m_underline;
+  bool m_lineThrough;
+  bool m_overline;
+  std::string m_color;
+  std::string m_backgroundColor;
+  std::string m_textPosition;
+  boost::optional<std::string> m_language;
+  boost::optional<std::string> m_country;
+  boost::optional<std::string> m_script;
+};
+
 struct ABWContentTableState
 {
   ABWContentTableState();
   ABWContentTableState(const ABWContentTableState &ts);
   ~ABWContentTableState();
 
-  ABWPropertyMap m_currentTableProperties;
-  ABWPropertyMap m_currentCellProperties;
+  // owned by the property cache
+  const ABWPropertyMap *m_currentTableProperties;
+  const ABWPropertyMap *m_currentCellProperties;
 
   int m_currentTableCol;
   int m_currentTableRow;
@@ -54,6 +116,9 @@ struct ABWContentTableState
   bool m_isTableCellOpened;
   bool m_isCellWithoutParagraph;
   bool m_isRowWithoutCell;
+
+private:
+  ABWContentTableState &operator=(const ABWContentTableState &);
 };
 
 struct ABWContentParsingState
@@ -74,8 +139,9 @@ struct ABWContentParsingState
   bool m_inParagraphOrListElement;
 
   ABWPropertyMap m_currentSectionStyle;
-  ABWPropertyMap m_currentParagraphStyle;
-  ABWPropertyMap m_currentCharacterStyle;
+  // owned by the collector; 0 if there is none
+  const ABWParagraphFormat *m_currentParagraphFormat;
+  const ABWPropertyMap *m_currentCharacterStyle;
 
   double m_pageWidth;
   double m_pageHeight;
@@ -106,6 +172,41 @@ struct ABWContentParsingState
 
   std::stack<ABWContentTableState> m_tableStates;
   std::stack<std::pair<int, ABWListElement *> > m_listLevels;
+
+private:
+  ABWContentParsingState &operator=(const ABWContentParsingState &);
+};
+
+/** What a body section takes over from the sections before it. Two
+    runs that reach a section with equal boundaries collect the rest of
+    the document in the same way.
+  */
+struct ABWSectionBoundary
+{
+  ABWSectionBoundary();
+
+  bool operator==(const ABWSectionBoundary &other) const;
+  bool operator!=(const ABWSectionBoundary &other) const
+  {
+    return !(*this == other);
+  }
+
+  // nothing but the document and the page span is open
+  bool m_isClean;
+  bool m_isPageSpanOpened;
+  double m_pageMarginTop;
+  double m_pageMarginBottom;
+  double m_pageMarginLeft;
+  double m_pageMarginRight;
+  int m_footerIds[4];
+  int m_headerIds[4];
+  bool m_deferredPageBreak;
+  bool m_deferredColumnBreak;
+  bool m_isFirstTextInListElement;
+  ABWContext m_parsingContext;
+  int m_currentHeaderFooterId;
+  librevenge::RVNGString m_currentHeaderFooterOccurrence;
+  int m_tableCounter;
 };
 
 class ABWContentCollector : public ABWCollector
@@ -113,7 +214,8 @@ class ABWContentCollector : public ABWCollector
 public:
   ABWContentCollector(librevenge::RVNGTextInterface *iface, const std::map<int, int> &tableSizes,
                       const std::map<std::string, ABWData> &data,
-                      const std::map<int, ABWListElement *> &listElements);
+                      const std::map<int, ABWListElement *> &listElements,
+                      ABWPropertyCache &propertyCache);
   virtual ~ABWContentCollector();
 
   // collector functions
@@ -144,7 +246,7 @@ public:
   void insertImage(const char *dataid, const char *props);
   void collectList(const char *, const char *, const char *, const char *, const char *, const char *) {}
 
-  void collectData(const char *name, const char *mimeType, const librevenge::RVNGBinaryData &data);
+  void collectData(const char *name, const ABWData &data);
   void collectHeaderFooter(const char *id, const char *type);
 
   void openTable(const char *props);
@@ -154,13 +256,54 @@ public:
 
   void addMetadataEntry(const char *name, const char *value);
 
+  /** Sets the id of the first table of each header or footer section,
+      in document order. Needed when the parser skips the body sections.
+    */
+  void setHeaderFooterTableIds(const std::vector<int> &tableIds);
+
+  /** Writes the body to the interface as it is collected, instead of
+      at the end of the document. Headers and footers are taken from
+      @c headerFooterCollector, if set; it must have seen the whole
+      document already. If @c pipelined is set, the interface is called
+      on another thread.
+    */
+  void startStreaming(const ABWContentCollector *headerFooterCollector, bool pipelined = false);
+
+  /** Leaves out redundant span and text events. See
+      ABWOutputElements::setCompactEvents.
+    */
+  void setCompactEvents(bool compact);
+
+  /** Moves collected body events to a temporary file past @c limit
+      bytes. See ABWOutputElements::setMemoryLimit.
+    */
+  void setMemoryLimit(unsigned long limit);
+
+  /** Returns the collected events. Without an interface, the whole
+      document is kept there, ready to be written any number of times.
+    */
+  boost::shared_ptr<const ABWOutputElements> getOutputElements() const;
+
+  /** Makes the collector continue a document that another collector has
+      started, so startDocument does not write anything.
+    */
+  void continueDocument();
+
+  /// Returns the state the next body section would start with.
+  ABWSectionBoundary getSectionBoundary() const;
+
+  /** Lets the next body section start with @c boundary, as if the
+      sections before it had been collected.
+    */
+  void setSectionBoundary(const ABWSectionBoundary &boundary);
+
 private:
   ABWContentCollector(const ABWContentCollector &);
   ABWContentCollector &operator=(const ABWContentCollector &);
 
   void _setMetadata();
 
-  void _addBorderProperties(const std::map<std::string, std::string> &map, librevenge::RVNGPropertyList &propList, const std::string &defaultUndefBorderProp="");
+  void _addBorderProperties(const ABWPropertyMap &map, librevenge::RVNGPropertyList &propList, const std::string &defaultUndefBorderProp="");
 
   void _openPageSpan();
   void _closePageSpan();
@@ -194,13 +337,21 @@ private:
   void _openFooter();
   void _closeFooter();
 
-  void _recurseTextProperties(const char *name, ABWPropertyMap &styleProps);
-  std::string _findDocumentProperty(const char *name);
-  std::string _findParagraphProperty(const char *name);
-  std::string _findCharacterProperty(const char *name);
-  std::string _findTableProperty(const char *name);
-  std::string _findCellProperty(const char *name);
-  std::string _findSectionProperty(const char *name);
+  /** Returns the properties of text style @c name, with the basedon
+      chain resolved. The result is computed once per style.
+    */
+  const ABWPropertyMap &_getTextStyle(const char *name);
+  /** Returns the format of a paragraph with style @c style and
+      props @c props. A null @c style means no style at all.
+    */
+  const ABWParagraphFormat &_getParagraphFormat(const char *style, const char *props);
+  const ABWParagraphFormat &_getCurrentParagraphFormat();
+  const ABWCharacterFormat &_getCurrentCharacterFormat();
+  void _resetFormats();
+  std::string _findDocumentProperty(int id);
+  std::string _findTableProperty(int id);
+  std::string _findCellProperty(int id);
+  std::string _findSectionProperty(int id);
   std::string _findMetadataEntry(const char *name);
 
   void _fillParagraphProperties(librevenge::RVNGPropertyList &propList, bool isListElement);
@@ -208,8 +359,20 @@ private:
   ABWContentParsingState *m_ps;
   librevenge::RVNGTextInterface *m_iface;
   std::stack<ABWContentParsingState *> m_parsingStates;
-  std::set<std::string> m_dontLoop;
   std::map<std::string, ABWStyle> m_textStyles;
+  std::map<std::string, ABWPropertyMap> m_resolvedTextStyles;
+
+  // Resolved formats are only ever added, so the parsing states can
+  // keep pointers to them. The indexes are keyed by the addresses of
+  // the maps a format was resolved from.
+  typedef std::pair<const ABWPropertyMap *, const ABWPropertyMap *> StyleKey_t;
+  typedef std::pair<const ABWParagraphFormat *, const ABWPropertyMap *> CharacterFormatKey_t;
+  std::list<ABWParagraphFormat> m_paragraphFormats;
+  std::list<ABWPropertyMap> m_characterStyles;
+  std::list<ABWCharacterFormat> m_characterFormats;
+  boost::unordered_map<StyleKey_t, const ABWParagraphFormat *, boost::hash<StyleKey_t> > m_paragraphFormatIndex;
+  boost::unordered_map<StyleKey_t, const ABWPropertyMap *, boost::hash<StyleKey_t> > m_characterStyleIndex;
+  boost::unordered_map<CharacterFormatKey_t, const ABWCharacterFormat *, boost::hash<CharacterFormatKey_t> > m_characterFormatIndex;
 
   ABWPropertyMap m_documentStyle;
   ABWPropertyMap m_metadata;
@@ -217,9 +380,12 @@ private:
   const std::map<std::string, ABWData> &m_data;
   const std::map<int, int> &m_tableSizes;
   int m_tableCounter;
-  ABWOutputElements m_outputElements;
+  const std::vector<int> *m_headerFooterTableIds;
+  std::size_t m_headerFooterCounter;
+  boost::shared_ptr<ABWOutputElements> m_outputElements;
   const std::map<int, ABWListElement *> &m_listElements;
   std::vector<ABWListElement *> m_dummyListElements;
+  ABWPropertyCache &m_propertyCache;
 };
 
 } // namespace libabw
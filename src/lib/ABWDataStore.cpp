@@ -0,0 +1,253 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <string.h>
+
+#include <list>
+#include <string>
+
+#include <boost/unordered_map.hpp>
+
+#include "ABWDataStore.h"
+#include "ABWHash.h"
+#include "ABWThread.h"
+#include "libabw_internal.h"
+
+namespace libabw
+{
+
+namespace
+{
+
+// what an entry costs besides its text and data
+const unsigned long ENTRY_OVERHEAD = 128;
+
+int getBase64Value(const char c)
+{
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+')
+    return 62;
+  if (c == '/')
+    return 63;
+  return -1;
+}
+
+/* Copies base64 text without white space to base64. */
+void removeWhiteSpace(const char *text, const std::size_t length, std::string &base64)
+{
+  base64.reserve(length);
+  for (const char *const end = text + length; text != end; ++text)
+  {
+    if (*text != ' ' && *text != '\t' && *text != '\r' && *text != '\n')
+      base64.push_back(*text);
+  }
+}
+
+/* Returns whether base64 text without white space is exactly what
+ * librevenge makes when it encodes the data, so that it can be passed
+ * on instead of the data.
+ */
+bool isLibrevengeBase64(const std::string &base64)
+{
+  std::size_t padding = 0;
+  int last = 0;
+  for (std::string::const_iterator iter = base64.begin(); iter != base64.end(); ++iter)
+  {
+    if (*iter == '=')
+    {
+      if (++padding > 2)
+        return false;
+    }
+    else
+    {
+      // nothing may follow the padding
+      last = getBase64Value(*iter);
+      if (last < 0 || padding)
+        return false;
+    }
+  }
+  if (base64.empty() || base64.size() % 4)
+    return false;
+  // the bits not used by the padded data have to be 0
+  return (padding == 0) || (padding == 1 && !(last & 0x3)) || (padding == 2 && !(last & 0xf));
+}
+
+struct StoredData
+{
+  StoredData()
+    : m_key()
+    , m_text()
+    , m_binaryData()
+    , m_base64()
+    , m_size(0)
+  {
+  }
+
+  std::string m_key;
+  // The hash is not safe against collisions made on purpose, so the
+  // text, without white space if it is base64, is compared too. Base64
+  // text that is passed on is the same, and m_text is empty then.
+  std::string m_text;
+  librevenge::RVNGBinaryData m_binaryData;
+  boost::shared_ptr<const librevenge::RVNGString> m_base64;
+  unsigned long m_size;
+};
+
+typedef std::list<StoredData> StoredDataList_t;
+
+struct Store
+{
+  Store()
+    : m_mutex()
+    , m_data()
+    , m_index()
+    , m_size(0)
+    , m_limit(0)
+  {
+  }
+
+  void trim();
+  const StoredData *find(const std::string &key, const std::string &text);
+
+  ABWMutex m_mutex;
+  // the data used most recently come first
+  StoredDataList_t m_data;
+  boost::unordered_map<std::string, StoredDataList_t::iterator> m_index;
+  unsigned long m_size;
+  unsigned long m_limit;
+
+private:
+  Store(const Store &);
+  Store &operator=(const Store &);
+};
+
+/* Returns the store. It is created on first use and never destroyed, so
+ * that parses still running on other threads at exit can use it; the
+ * data it holds are freed by setting its limit to 0.
+ */
+Store &getStore()
+{
+  static Store *const store = new Store();
+  return *store;
+}
+
+void Store::trim()
+{
+  while (m_size > m_limit && !m_data.empty())
+  {
+    m_size -= m_data.back().m_size;
+    m_index.erase(m_data.back().m_key);
+    m_data.pop_back();
+  }
+}
+
+/* Looks the key up, and moves what is found to the front. */
+const StoredData *Store::find(const std::string &key, const std::string &text)
+{
+  const boost::unordered_map<std::string, StoredDataList_t::iterator>::const_iterator iter = m_index.find(key);
+  if (iter == m_index.end())
+    return 0;
+  const StoredData &stored = *iter->second;
+  if (stored.m_base64 ? text != stored.m_base64->cstr() : text != stored.m_text)
+    return 0;
+  m_data.splice(m_data.begin(), m_data, iter->second);
+  return &stored;
+}
+
+void setData(const StoredData &stored, ABWData &data)
+{
+  data.m_binaryData = stored.m_binaryData;
+  data.m_base64 = stored.m_base64;
+}
+
+}
+
+void getStoredData(const char *const text, const bool base64, ABWData &data)
+{
+  Store &store = getStore();
+  bool isStored = false;
+  {
+    ABWMutexLock lock(store.m_mutex);
+    isStored = store.m_limit > 0;
+  }
+
+  const std::size_t length = strlen(text);
+  // base64 text is the same data whatever its white space is
+  std::string stripped;
+  if (base64)
+    removeWhiteSpace(text, length, stripped);
+  else if (isStored)
+    stripped.assign(text, length);
+  std::string key;
+  if (isStored)
+  {
+    ABWHash hash;
+    hash.update(reinterpret_cast<const unsigned char *>(stripped.data()), stripped.size());
+    key = hash.getDigest() + (base64 ? "b" : "t");
+
+    ABWMutexLock lock(store.m_mutex);
+    const StoredData *const found = store.find(key, stripped);
+    if (found)
+    {
+      setData(*found, data);
+      return;
+    }
+  }
+
+  // decoding can take a while, so other threads may use the store meanwhile
+  StoredData stored;
+  if (base64 && isLibrevengeBase64(stripped))
+    stored.m_base64.reset(new librevenge::RVNGString(stripped.c_str()));
+  else if (base64)
+    stored.m_binaryData.appendBase64Data(text);
+  else
+    stored.m_binaryData.append(reinterpret_cast<const unsigned char *>(text), (unsigned long) length);
+  setData(stored, data);
+  if (!isStored)
+    return;
+  stored.m_size = (unsigned long)(stripped.size() + stored.m_binaryData.size()) + ENTRY_OVERHEAD;
+
+  ABWMutexLock lock(store.m_mutex);
+  // the limit may have been lowered meanwhile
+  if (stored.m_size > store.m_limit)
+    return;
+  const StoredData *const found = store.find(key, stripped);
+  if (found)
+  {
+    // another thread has stored the same data first
+    setData(*found, data);
+    return;
+  }
+  if (store.m_index.find(key) != store.m_index.end())
+    return;
+  if (!stored.m_base64)
+    stored.m_text.swap(stripped);
+  stored.m_key = key;
+  store.m_data.push_front(stored);
+  store.m_index[key] = store.m_data.begin();
+  store.m_size += stored.m_size;
+  store.trim();
+}
+
+void setSharedDataLimit(const unsigned long limit)
+{
+  Store &store = getStore();
+  ABWMutexLock lock(store.m_mutex);
+  store.m_limit = limit;
+  store.trim();
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,35 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWDATASTORE_H__
+#define __ABWDATASTORE_H__
+
+#include "ABWCollector.h"
+
+namespace libabw
+{
+
+/** Sets the data of @c data from the text of a <d> element. Base64 text
+  * is kept as it is if librevenge would encode the data the same way;
+  * anything else is decoded. The data are kept in a store shared by all
+  * parses of the process, where they are found by a hash of the text,
+  * without white space if it is base64. So all documents that contain
+  * the same picture share its data.
+  */
+void getStoredData(const char *text, bool base64, ABWData &data);
+
+/** Sets the size of the store in bytes. The data used least recently
+  * are dropped until it is within that; 0 empties it and keeps it empty.
+  */
+void setSharedDataLimit(unsigned long limit);
+
+} // namespace libabw
+
+#endif // __ABWDATASTORE_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,243 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ABW_CACHE_MMAP 1
+#endif
+
+#include <vector>
+
+#include "ABWDocumentCache.h"
+#include "ABWHash.h"
+#include "ABWOutputElements.h"
+#include "ABWZlibStream.h"
+#include "libabw_internal.h"
+
+// changed whenever the binary form of the events changes
+#define CACHE_FORMAT_VERSION 1
+
+namespace libabw
+{
+
+namespace
+{
+
+const char CACHE_MAGIC[] = "ABWCACHE";
+const std::size_t CACHE_MAGIC_LENGTH = 8;
+const std::size_t CACHE_DIGEST_LENGTH = 32;
+// the magic, the version, the length of the events and their digest
+const std::size_t CACHE_HEADER_LENGTH = CACHE_MAGIC_LENGTH + 4 + 8 + CACHE_DIGEST_LENGTH;
+
+void writeLittleEndian(std::string &data, unsigned long value, const int length)
+{
+  for (int i = 0; i < length; ++i, value >>= 8)
+    data.push_back(char(value & 0xff));
+}
+
+unsigned long readLittleEndian(const unsigned char *const data, const int length)
+{
+  unsigned long value = 0;
+  for (int i = length; i > 0; --i)
+    value = (value << 8) | data[i - 1];
+  return value;
+}
+
+/* Checks the header and the digest of the events in a cache file, and
+ * reads them into elements.
+ */
+bool readCacheData(const unsigned char *const data, const std::size_t length, ABWOutputElements &elements)
+{
+  if (length < CACHE_HEADER_LENGTH || memcmp(data, CACHE_MAGIC, CACHE_MAGIC_LENGTH))
+    return false;
+  if (readLittleEndian(data + CACHE_MAGIC_LENGTH, 4) != CACHE_FORMAT_VERSION)
+    return false;
+  const unsigned long eventsLength = readLittleEndian(data + CACHE_MAGIC_LENGTH + 4, 8);
+  if (eventsLength != length - CACHE_HEADER_LENGTH)
+    return false;
+  const unsigned char *const events = data + CACHE_HEADER_LENGTH;
+  ABWHash hash;
+  hash.update(events, eventsLength);
+  if (hash.getDigest().compare(0, CACHE_DIGEST_LENGTH, reinterpret_cast<const char *>(data + CACHE_MAGIC_LENGTH + 12), CACHE_DIGEST_LENGTH))
+    return false;
+  return elements.deserialize(events, eventsLength);
+}
+
+/* Files larger than maxLength, if it is set, are not read; their events
+ * would take more memory than allowed.
+ */
+
+#ifdef ABW_CACHE_MMAP
+
+bool readCacheFile(const std::string &path, const unsigned long maxLength, ABWOutputElements &elements)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  bool isRead = false;
+  struct stat status;
+  if (fstat(fd, &status) == 0 && status.st_size > 0 && (!maxLength || (unsigned long)status.st_size <= maxLength))
+  {
+    const std::size_t length = std::size_t(status.st_size);
+    void *const data = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED)
+    {
+      isRead = readCacheData(static_cast<const unsigned char *>(data), length, elements);
+      munmap(data, length);
+    }
+  }
+  close(fd);
+  return isRead;
+}
+
+#else
+
+bool readCacheFile(const std::string &path, const unsigned long maxLength, ABWOutputElements &elements)
+{
+  FILE *const file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  if (maxLength && (fseek(file, 0, SEEK_END) != 0 || (unsigned long)ftell(file) > maxLength || fseek(file, 0, SEEK_SET) != 0))
+  {
+    fclose(file);
+    return false;
+  }
+  std::vector<unsigned char> data;
+  unsigned char buffer[65536];
+  std::size_t numBytesRead = 0;
+  while ((numBytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + numBytesRead);
+  const bool isFailed = ferror(file);
+  fclose(file);
+  return !isFailed && !data.empty() && readCacheData(&data[0], data.size(), elements);
+}
+
+#endif
+
+}
+
+ABWDocumentCache::ABWDocumentCache(const ABWParseOptions &options)
+  : m_directory(options.getCacheDirectory())
+  , m_compactEvents(options.getCompactEvents())
+  , m_memoryLimit(options.getMemoryLimit())
+  , m_path()
+{
+}
+
+bool ABWDocumentCache::isEnabled() const
+{
+  return !m_directory.empty();
+}
+
+bool ABWDocumentCache::setDocument(librevenge::RVNGInputStream *const input, std::string *const dataDigest,
+                                   std::string *const contentDigest)
+{
+  m_path.clear();
+  if (!input || m_directory.empty())
+    return false;
+
+  // Anybody may add documents to a shared directory, so the name is a
+  // hash that nobody can make another document match.
+  ABWSha256 hash;
+  if (dataDigest && contentDigest)
+  {
+    if (!ABWZlibStream::fingerprint(input, *dataDigest, *contentDigest, &hash))
+      return false;
+  }
+  else
+  {
+    input->seek(0, librevenge::RVNG_SEEK_SET);
+    while (!input->isEnd())
+    {
+      unsigned long numBytesRead = 0;
+      const unsigned char *const buffer = input->read(65536, numBytesRead);
+      if (!buffer || !numBytesRead)
+        break;
+      hash.update(buffer, numBytesRead);
+    }
+    input->seek(0, librevenge::RVNG_SEEK_SET);
+  }
+
+  // a newer version of the library may make other events
+  std::string salt("\0", 1);
+#ifdef PACKAGE_VERSION
+  salt.append(PACKAGE_VERSION);
+#endif
+  salt.push_back(m_compactEvents ? 'c' : '-');
+  hash.update(reinterpret_cast<const unsigned char *>(salt.data()), salt.size());
+
+  m_path = m_directory;
+  const char last = m_path[m_path.size() - 1];
+  if (last != '/' && last != '\\')
+    m_path.push_back('/');
+  m_path.append(hash.getDigest());
+  m_path.append(".abwc");
+  return true;
+}
+
+boost::shared_ptr<const ABWOutputElements> ABWDocumentCache::load() const
+{
+  if (m_path.empty())
+    return boost::shared_ptr<const ABWOutputElements>();
+  boost::shared_ptr<ABWOutputElements> elements(new ABWOutputElements());
+  if (!readCacheFile(m_path, m_memoryLimit, *elements))
+  {
+    ABW_DEBUG_MSG(("ABWDocumentCache::load: %s is not in the cache\n", m_path.c_str()));
+    return boost::shared_ptr<const ABWOutputElements>();
+  }
+  return elements;
+}
+
+void ABWDocumentCache::store(const ABWOutputElements &elements) const
+{
+  // the events past the memory limit are not kept in the cache either
+  if (m_path.empty() || elements.isSpilled())
+    return;
+
+  std::string events;
+  elements.serialize(events);
+  ABWHash hash;
+  hash.update(reinterpret_cast<const unsigned char *>(events.data()), events.size());
+  std::string header(CACHE_MAGIC, CACHE_MAGIC_LENGTH);
+  writeLittleEndian(header, CACHE_FORMAT_VERSION, 4);
+  writeLittleEndian(header, (unsigned long)events.size(), 8);
+  header.append(hash.getDigest());
+
+  // Another process may read the file at the same time, so it is
+  // written under another name first. If two processes write it at
+  // the same time, the digest keeps a mixed up file from being used.
+  const std::string tmpPath = m_path + ".tmp";
+  FILE *const file = fopen(tmpPath.c_str(), "wb");
+  if (!file)
+  {
+    ABW_DEBUG_MSG(("ABWDocumentCache::store: cannot write %s\n", tmpPath.c_str()));
+    return;
+  }
+  const bool isWritten = fwrite(header.data(), 1, header.size(), file) == header.size()
+                         && fwrite(events.data(), 1, events.size(), file) == events.size();
+  if (fclose(file) != 0 || !isWritten || rename(tmpPath.c_str(), m_path.c_str()) != 0)
+  {
+    ABW_DEBUG_MSG(("ABWDocumentCache::store: cannot write %s\n", m_path.c_str()));
+    remove(tmpPath.c_str());
+  }
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
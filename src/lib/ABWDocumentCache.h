@@ -0,0 +1,61 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWDOCUMENTCACHE_H__
+#define __ABWDOCUMENTCACHE_H__
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <librevenge-stream/librevenge-stream.h>
+#include <libabw/ABWParseOptions.h>
+
+namespace libabw
+{
+
+class ABWOutputElements;
+
+/** Collected documents kept in files of the cache directory of the
+  * parse options. A file is named by the SHA-256 of the document data,
+  * the library version and the options that change the events.
+  */
+class ABWDocumentCache
+{
+public:
+  explicit ABWDocumentCache(const ABWParseOptions &options);
+
+  /// Whether the options name a cache directory.
+  bool isEnabled() const;
+
+  /** Reads @c input to find the name of its file. Returns false if it
+      cannot be read. If @c dataDigest and @c contentDigest are set, the
+      fingerprint of @c input is taken in the same pass.
+    */
+  bool setDocument(librevenge::RVNGInputStream *input, std::string *dataDigest = 0, std::string *contentDigest = 0);
+
+  /** Returns the kept document, or an empty pointer if there is none
+      or it is larger than the memory limit of the options.
+    */
+  boost::shared_ptr<const ABWOutputElements> load() const;
+
+  /** Keeps @c elements, unless some of them have been moved out of
+      memory. Failing to do so is not an error.
+    */
+  void store(const ABWOutputElements &elements) const;
+
+private:
+  const std::string m_directory;
+  const bool m_compactEvents;
+  const unsigned long m_memoryLimit;
+  std::string m_path;
+};
+
+} // namespace libabw
+
+#endif // __ABWDOCUMENTCACHE_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,40 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <libabw/libabw.h>
+#include "ABWDocumentHandleImpl.h"
+
+namespace libabw
+{
+
+ABWDocumentHandle::ABWDocumentHandle(Impl *const impl)
+  : m_impl(impl)
+{
+}
+
+ABWDocumentHandle::~ABWDocumentHandle()
+{
+  delete m_impl;
+}
+
+bool ABWDocumentHandle::write(librevenge::RVNGTextInterface *const textInterface) const try
+{
+  if (!textInterface || !m_impl->m_elements)
+    return false;
+  m_impl->m_elements->write(textInterface);
+  return true;
+}
+catch (...)
+{
+  return false;
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
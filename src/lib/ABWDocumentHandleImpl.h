@@ -0,0 +1,30 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWDOCUMENTHANDLEIMPL_H__
+#define __ABWDOCUMENTHANDLEIMPL_H__
+
+#include <boost/shared_ptr.hpp>
+#include <libabw/ABWDocumentHandle.h>
+#include "ABWOutputElements.h"
+
+namespace libabw
+{
+
+struct ABWDocumentHandle::Impl
+{
+  Impl() : m_elements() {}
+
+  boost::shared_ptr<const ABWOutputElements> m_elements;
+};
+
+} // namespace libabw
+
+#endif // __ABWDOCUMENTHANDLEIMPL_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
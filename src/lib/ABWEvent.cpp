@@ -0,0 +1,191 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <libabw/ABWEvent.h>
+#include "ABWEventImpl.h"
+#include "libabw_internal.h"
+
+namespace libabw
+{
+
+ABWEvent::ABWEvent()
+  : m_impl(new Impl())
+{
+}
+
+ABWEvent::ABWEvent(const ABWEvent &other)
+  : m_impl(new Impl(*other.m_impl))
+{
+}
+
+ABWEvent::~ABWEvent()
+{
+  delete m_impl;
+}
+
+ABWEvent &ABWEvent::operator=(const ABWEvent &other)
+{
+  *m_impl = *other.m_impl;
+  return *this;
+}
+
+ABWEvent::Type ABWEvent::getType() const
+{
+  return m_impl->m_type;
+}
+
+const librevenge::RVNGPropertyList &ABWEvent::getPropertyList() const
+{
+  return m_impl->m_propList;
+}
+
+const librevenge::RVNGString &ABWEvent::getText() const
+{
+  return m_impl->m_text;
+}
+
+void ABWEvent::write(librevenge::RVNGTextInterface *const textInterface) const
+{
+  if (!textInterface)
+    return;
+
+  switch (m_impl->m_type)
+  {
+  case ABW_CLOSE_ENDNOTE:
+    textInterface->closeEndnote();
+    break;
+  case ABW_CLOSE_FOOTER:
+    textInterface->closeFooter();
+    break;
+  case ABW_CLOSE_FOOTNOTE:
+    textInterface->closeFootnote();
+    break;
+  case ABW_CLOSE_FRAME:
+    textInterface->closeFrame();
+    break;
+  case ABW_CLOSE_HEADER:
+    textInterface->closeHeader();
+    break;
+  case ABW_CLOSE_LINK:
+    textInterface->closeLink();
+    break;
+  case ABW_CLOSE_LIST_ELEMENT:
+    textInterface->closeListElement();
+    break;
+  case ABW_CLOSE_ORDERED_LIST_LEVEL:
+    textInterface->closeOrderedListLevel();
+    break;
+  case ABW_CLOSE_PAGE_SPAN:
+    textInterface->closePageSpan();
+    break;
+  case ABW_CLOSE_PARAGRAPH:
+    textInterface->closeParagraph();
+    break;
+  case ABW_CLOSE_SECTION:
+    textInterface->closeSection();
+    break;
+  case ABW_CLOSE_SPAN:
+    textInterface->closeSpan();
+    break;
+  case ABW_CLOSE_TABLE:
+    textInterface->closeTable();
+    break;
+  case ABW_CLOSE_TABLE_CELL:
+    textInterface->closeTableCell();
+    break;
+  case ABW_CLOSE_TABLE_ROW:
+    textInterface->closeTableRow();
+    break;
+  case ABW_CLOSE_UNORDERED_LIST_LEVEL:
+    textInterface->closeUnorderedListLevel();
+    break;
+  case ABW_END_DOCUMENT:
+    textInterface->endDocument();
+    break;
+  case ABW_INSERT_BINARY_OBJECT:
+    textInterface->insertBinaryObject(m_impl->m_propList);
+    break;
+  case ABW_INSERT_COVERED_TABLE_CELL:
+    textInterface->insertCoveredTableCell(m_impl->m_propList);
+    break;
+  case ABW_INSERT_LINE_BREAK:
+    textInterface->insertLineBreak();
+    break;
+  case ABW_INSERT_SPACE:
+    textInterface->insertSpace();
+    break;
+  case ABW_INSERT_TAB:
+    textInterface->insertTab();
+    break;
+  case ABW_INSERT_TEXT:
+    textInterface->insertText(m_impl->m_text);
+    break;
+  case ABW_OPEN_ENDNOTE:
+    textInterface->openEndnote(m_impl->m_propList);
+    break;
+  case ABW_OPEN_FOOTER:
+    textInterface->openFooter(m_impl->m_propList);
+    break;
+  case ABW_OPEN_FOOTNOTE:
+    textInterface->openFootnote(m_impl->m_propList);
+    break;
+  case ABW_OPEN_FRAME:
+    textInterface->openFrame(m_impl->m_propList);
+    break;
+  case ABW_OPEN_HEADER:
+    textInterface->openHeader(m_impl->m_propList);
+    break;
+  case ABW_OPEN_LINK:
+    textInterface->openLink(m_impl->m_propList);
+    break;
+  case ABW_OPEN_LIST_ELEMENT:
+    textInterface->openListElement(m_impl->m_propList);
+    break;
+  case ABW_OPEN_ORDERED_LIST_LEVEL:
+    textInterface->openOrderedListLevel(m_impl->m_propList);
+    break;
+  case ABW_OPEN_PAGE_SPAN:
+    textInterface->openPageSpan(m_impl->m_propList);
+    break;
+  case ABW_OPEN_PARAGRAPH:
+    textInterface->openParagraph(m_impl->m_propList);
+    break;
+  case ABW_OPEN_SECTION:
+    textInterface->openSection(m_impl->m_propList);
+    break;
+  case ABW_OPEN_SPAN:
+    textInterface->openSpan(m_impl->m_propList);
+    break;
+  case ABW_OPEN_TABLE:
+    textInterface->openTable(m_impl->m_propList);
+    break;
+  case ABW_OPEN_TABLE_CELL:
+    textInterface->openTableCell(m_impl->m_propList);
+    break;
+  case ABW_OPEN_TABLE_ROW:
+    textInterface->openTableRow(m_impl->m_propList);
+    break;
+  case ABW_OPEN_UNORDERED_LIST_LEVEL:
+    textInterface->openUnorderedListLevel(m_impl->m_propList);
+    break;
+  case ABW_SET_DOCUMENT_META_DATA:
+    textInterface->setDocumentMetaData(m_impl->m_propList);
+    break;
+  case ABW_START_DOCUMENT:
+    textInterface->startDocument(m_impl->m_propList);
+    break;
+  default:
+    ABW_DEBUG_MSG(("ABWEvent::write: unknown event type %d\n", int(m_impl->m_type)));
+    break;
+  }
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,32 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWEVENTIMPL_H__
+#define __ABWEVENTIMPL_H__
+
+#include <librevenge/librevenge.h>
+#include <libabw/ABWEvent.h>
+
+namespace libabw
+{
+
+struct ABWEvent::Impl
+{
+  explicit Impl(ABWEvent::Type type = ABWEvent::ABW_END_DOCUMENT)
+    : m_type(type), m_propList(), m_text() {}
+
+  ABWEvent::Type m_type;
+  librevenge::RVNGPropertyList m_propList;
+  librevenge::RVNGString m_text;
+};
+
+} // namespace libabw
+
+#endif // __ABWEVENTIMPL_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,352 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <deque>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+#include <libabw/ABWEventReader.h>
+#include "ABWEventImpl.h"
+#include "ABWFingerprintImpl.h"
+#include "ABWParser.h"
+#include "ABWZlibStream.h"
+#include "libabw_internal.h"
+
+namespace libabw
+{
+
+struct ABWEventReader::Impl
+{
+  /** Keeps the callbacks it gets as events, until they are read. */
+  class EventQueue : public librevenge::RVNGTextInterface
+  {
+  public:
+    EventQueue()
+      : m_events()
+    {
+    }
+
+    void setDocumentMetaData(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_SET_DOCUMENT_META_DATA).m_propList = propList;
+    }
+    void startDocument(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_START_DOCUMENT).m_propList = propList;
+    }
+    void endDocument()
+    {
+      push(ABWEvent::ABW_END_DOCUMENT);
+    }
+    void openPageSpan(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_PAGE_SPAN).m_propList = propList;
+    }
+    void closePageSpan()
+    {
+      push(ABWEvent::ABW_CLOSE_PAGE_SPAN);
+    }
+    void openHeader(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_HEADER).m_propList = propList;
+    }
+    void closeHeader()
+    {
+      push(ABWEvent::ABW_CLOSE_HEADER);
+    }
+    void openFooter(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_FOOTER).m_propList = propList;
+    }
+    void closeFooter()
+    {
+      push(ABWEvent::ABW_CLOSE_FOOTER);
+    }
+    void openParagraph(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_PARAGRAPH).m_propList = propList;
+    }
+    void closeParagraph()
+    {
+      push(ABWEvent::ABW_CLOSE_PARAGRAPH);
+    }
+    void openSpan(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_SPAN).m_propList = propList;
+    }
+    void closeSpan()
+    {
+      push(ABWEvent::ABW_CLOSE_SPAN);
+    }
+    void openLink(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_LINK).m_propList = propList;
+    }
+    void closeLink()
+    {
+      push(ABWEvent::ABW_CLOSE_LINK);
+    }
+    void openSection(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_SECTION).m_propList = propList;
+    }
+    void closeSection()
+    {
+      push(ABWEvent::ABW_CLOSE_SECTION);
+    }
+    void insertTab()
+    {
+      push(ABWEvent::ABW_INSERT_TAB);
+    }
+    void insertSpace()
+    {
+      push(ABWEvent::ABW_INSERT_SPACE);
+    }
+    void insertText(const librevenge::RVNGString &text)
+    {
+      push(ABWEvent::ABW_INSERT_TEXT).m_text = text;
+    }
+    void insertLineBreak()
+    {
+      push(ABWEvent::ABW_INSERT_LINE_BREAK);
+    }
+    void openOrderedListLevel(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_ORDERED_LIST_LEVEL).m_propList = propList;
+    }
+    void openUnorderedListLevel(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_UNORDERED_LIST_LEVEL).m_propList = propList;
+    }
+    void closeOrderedListLevel()
+    {
+      push(ABWEvent::ABW_CLOSE_ORDERED_LIST_LEVEL);
+    }
+    void closeUnorderedListLevel()
+    {
+      push(ABWEvent::ABW_CLOSE_UNORDERED_LIST_LEVEL);
+    }
+    void openListElement(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_LIST_ELEMENT).m_propList = propList;
+    }
+    void closeListElement()
+    {
+      push(ABWEvent::ABW_CLOSE_LIST_ELEMENT);
+    }
+    void openFootnote(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_FOOTNOTE).m_propList = propList;
+    }
+    void closeFootnote()
+    {
+      push(ABWEvent::ABW_CLOSE_FOOTNOTE);
+    }
+    void openEndnote(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_ENDNOTE).m_propList = propList;
+    }
+    void closeEndnote()
+    {
+      push(ABWEvent::ABW_CLOSE_ENDNOTE);
+    }
+    void openTable(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_TABLE).m_propList = propList;
+    }
+    void openTableRow(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_TABLE_ROW).m_propList = propList;
+    }
+    void closeTableRow()
+    {
+      push(ABWEvent::ABW_CLOSE_TABLE_ROW);
+    }
+    void openTableCell(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_TABLE_CELL).m_propList = propList;
+    }
+    void closeTableCell()
+    {
+      push(ABWEvent::ABW_CLOSE_TABLE_CELL);
+    }
+    void insertCoveredTableCell(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_INSERT_COVERED_TABLE_CELL).m_propList = propList;
+    }
+    void closeTable()
+    {
+      push(ABWEvent::ABW_CLOSE_TABLE);
+    }
+    void openFrame(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_OPEN_FRAME).m_propList = propList;
+    }
+    void closeFrame()
+    {
+      push(ABWEvent::ABW_CLOSE_FRAME);
+    }
+    void insertBinaryObject(const librevenge::RVNGPropertyList &propList)
+    {
+      push(ABWEvent::ABW_INSERT_BINARY_OBJECT).m_propList = propList;
+    }
+
+    // libabw does not make these callbacks
+    void defineEmbeddedFont(const librevenge::RVNGPropertyList &) {}
+    void definePageStyle(const librevenge::RVNGPropertyList &) {}
+    void defineParagraphStyle(const librevenge::RVNGPropertyList &) {}
+    void defineCharacterStyle(const librevenge::RVNGPropertyList &) {}
+    void defineSectionStyle(const librevenge::RVNGPropertyList &) {}
+    void insertField(const librevenge::RVNGPropertyList &) {}
+    void openComment(const librevenge::RVNGPropertyList &) {}
+    void closeComment() {}
+    void openTextBox(const librevenge::RVNGPropertyList &) {}
+    void closeTextBox() {}
+    void insertEquation(const librevenge::RVNGPropertyList &) {}
+    void openGroup(const librevenge::RVNGPropertyList &) {}
+    void closeGroup() {}
+    void defineGraphicStyle(const librevenge::RVNGPropertyList &) {}
+    void drawRectangle(const librevenge::RVNGPropertyList &) {}
+    void drawEllipse(const librevenge::RVNGPropertyList &) {}
+    void drawPolygon(const librevenge::RVNGPropertyList &) {}
+    void drawPolyline(const librevenge::RVNGPropertyList &) {}
+    void drawPath(const librevenge::RVNGPropertyList &) {}
+    void drawConnector(const librevenge::RVNGPropertyList &) {}
+
+    std::deque<ABWEvent::Impl> m_events;
+
+  private:
+    ABWEvent::Impl &push(const ABWEvent::Type type)
+    {
+      m_events.push_back(ABWEvent::Impl(type));
+      return m_events.back();
+    }
+  };
+
+  Impl(librevenge::RVNGInputStream *input, const ABWParseOptions &options);
+
+  bool start();
+  void finish();
+
+  librevenge::RVNGInputStream *const m_input;
+  const ABWParseOptions m_options;
+  EventQueue m_queue;
+  boost::scoped_ptr<ABWZlibStream> m_stream;
+  boost::scoped_ptr<ABWParser> m_parser;
+  bool m_isStarted;
+  bool m_isFailed;
+
+private:
+  Impl(const Impl &);
+  Impl &operator=(const Impl &);
+};
+
+ABWEventReader::Impl::Impl(librevenge::RVNGInputStream *const input, const ABWParseOptions &options)
+  : m_input(input)
+  , m_options(options)
+  , m_queue()
+  , m_stream()
+  , m_parser()
+  , m_isStarted(false)
+  , m_isFailed(false)
+{
+}
+
+bool ABWEventReader::Impl::start()
+{
+  if (!m_input)
+    return false;
+  m_input->seek(0, librevenge::RVNG_SEEK_SET);
+  m_stream.reset(new ABWZlibStream(m_input, m_options.getMemoryLimit(), m_options.getPipelinedInflate(),
+                                   0 != m_options.getFingerprint()));
+  m_parser.reset(new ABWParser(m_stream.get(), &m_queue, m_options));
+  return m_parser->startParsing();
+}
+
+void ABWEventReader::Impl::finish()
+{
+  m_parser.reset();
+  m_stream.reset();
+}
+
+ABWEventReader::ABWEventReader(librevenge::RVNGInputStream *const input)
+  : m_impl(new Impl(input, ABWParseOptions()))
+{
+}
+
+ABWEventReader::ABWEventReader(librevenge::RVNGInputStream *const input, const ABWParseOptions &options)
+  : m_impl(new Impl(input, options))
+{
+}
+
+ABWEventReader::~ABWEventReader()
+{
+  delete m_impl;
+}
+
+bool ABWEventReader::next(ABWEvent &event) try
+{
+  std::deque<ABWEvent::Impl> &events = m_impl->m_queue.m_events;
+  try
+  {
+    if (!m_impl->m_isStarted)
+    {
+      m_impl->m_isStarted = true;
+      if (m_impl->m_options.getFingerprint())
+        *m_impl->m_options.getFingerprint() = ABWFingerprint();
+      if (!m_impl->start())
+      {
+        ABW_DEBUG_MSG(("ABWEventReader::next: the document could not be read\n"));
+        m_impl->m_isFailed = true;
+        m_impl->finish();
+      }
+    }
+    while (events.empty() && m_impl->m_parser)
+    {
+      if (!m_impl->m_parser->parseNextNode())
+      {
+        ABWFingerprint *const fingerprint = m_impl->m_options.getFingerprint();
+        std::string dataDigest;
+        std::string contentDigest;
+        if (fingerprint && m_impl->m_stream->getDigests(dataDigest, contentDigest))
+        {
+          fingerprint->m_impl->m_dataDigest = dataDigest;
+          fingerprint->m_impl->m_contentDigest = contentDigest;
+        }
+        m_impl->finish();
+      }
+    }
+  }
+  catch (...)
+  {
+    // the events got before the failure are still read, as
+    // AbiDocument::parse would have written them
+    m_impl->m_isFailed = true;
+    m_impl->finish();
+  }
+
+  if (events.empty())
+    return false;
+  *event.m_impl = events.front();
+  events.pop_front();
+  return true;
+}
+catch (...)
+{
+  return false;
+}
+
+bool ABWEventReader::isFailed() const
+{
+  return m_impl->m_isFailed;
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
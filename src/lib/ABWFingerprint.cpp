@@ -0,0 +1,53 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ABWFingerprintImpl.h"
+
+namespace libabw
+{
+
+ABWFingerprint::ABWFingerprint()
+  : m_impl(new Impl())
+{
+}
+
+ABWFingerprint::ABWFingerprint(const ABWFingerprint &other)
+  : m_impl(new Impl(*other.m_impl))
+{
+}
+
+ABWFingerprint::~ABWFingerprint()
+{
+  delete m_impl;
+}
+
+ABWFingerprint &ABWFingerprint::operator=(const ABWFingerprint &other)
+{
+  *m_impl = *other.m_impl;
+  return *this;
+}
+
+bool ABWFingerprint::isEmpty() const
+{
+  return m_impl->m_dataDigest.empty();
+}
+
+const char *ABWFingerprint::getDataDigest() const
+{
+  return m_impl->m_dataDigest.c_str();
+}
+
+const char *ABWFingerprint::getContentDigest() const
+{
+  return m_impl->m_contentDigest.c_str();
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,30 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWFINGERPRINTIMPL_H__
+#define __ABWFINGERPRINTIMPL_H__
+
+#include <string>
+#include <libabw/ABWFingerprint.h>
+
+namespace libabw
+{
+
+struct ABWFingerprint::Impl
+{
+  Impl() : m_dataDigest(), m_contentDigest() {}
+
+  std::string m_dataDigest;
+  std::string m_contentDigest;
+};
+
+} // namespace libabw
+
+#endif // __ABWFINGERPRINTIMPL_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
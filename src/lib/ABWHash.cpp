@@ -0,0 +1,255 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "ABWHash.h"
+
+namespace libabw
+{
+
+namespace
+{
+
+const boost::uint64_t C1 = (boost::uint64_t(0x87c37b91) << 32) | 0x114253d5;
+const boost::uint64_t C2 = (boost::uint64_t(0x4cf5ad43) << 32) | 0x2745937f;
+
+inline boost::uint64_t rotl(const boost::uint64_t x, const int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline boost::uint64_t fmix(boost::uint64_t k)
+{
+  k ^= k >> 33;
+  k *= (boost::uint64_t(0xff51afd7) << 32) | 0xed558ccd;
+  k ^= k >> 33;
+  k *= (boost::uint64_t(0xc4ceb9fe) << 32) | 0x1a85ec53;
+  k ^= k >> 33;
+  return k;
+}
+
+// reads little endian, whatever the host is
+inline boost::uint64_t readBlock(const unsigned char *const data, const std::size_t length)
+{
+  boost::uint64_t value = 0;
+  for (std::size_t i = length; i > 0; --i)
+    value = (value << 8) | data[i - 1];
+  return value;
+}
+
+inline boost::uint64_t mixK1(boost::uint64_t k1)
+{
+  k1 *= C1;
+  k1 = rotl(k1, 31);
+  k1 *= C2;
+  return k1;
+}
+
+inline boost::uint64_t mixK2(boost::uint64_t k2)
+{
+  k2 *= C2;
+  k2 = rotl(k2, 33);
+  k2 *= C1;
+  return k2;
+}
+
+void appendHex(std::string &str, const boost::uint64_t value, const int digits = 16)
+{
+  static const char DIGITS[] = "0123456789abcdef";
+  for (int shift = 4 * (digits - 1); shift >= 0; shift -= 4)
+    str.push_back(DIGITS[(value >> shift) & 0xf]);
+}
+
+const boost::uint32_t SHA256_K[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline boost::uint32_t rotr(const boost::uint32_t x, const int r)
+{
+  return (x >> r) | (x << (32 - r));
+}
+
+}
+
+ABWHash::ABWHash()
+  : m_h1(0)
+  , m_h2(0)
+  , m_length(0)
+  , m_tail()
+  , m_tailLength(0)
+{
+}
+
+void ABWHash::update(const unsigned char *data, std::size_t length)
+{
+  m_length += length;
+  if (m_tailLength)
+  {
+    const std::size_t count = std::min<std::size_t>(16 - m_tailLength, length);
+    memcpy(m_tail + m_tailLength, data, count);
+    m_tailLength += count;
+    data += count;
+    length -= count;
+    if (m_tailLength < 16)
+      return;
+    _mixBlock(m_tail);
+    m_tailLength = 0;
+  }
+  for (; length >= 16; data += 16, length -= 16)
+    _mixBlock(data);
+  if (length)
+  {
+    memcpy(m_tail, data, length);
+    m_tailLength = length;
+  }
+}
+
+std::string ABWHash::getDigest() const
+{
+  boost::uint64_t h1 = m_h1;
+  boost::uint64_t h2 = m_h2;
+  if (m_tailLength > 8)
+    h2 ^= mixK2(readBlock(m_tail + 8, m_tailLength - 8));
+  if (m_tailLength)
+    h1 ^= mixK1(readBlock(m_tail, std::min<std::size_t>(m_tailLength, 8)));
+
+  h1 ^= m_length;
+  h2 ^= m_length;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+  h1 += h2;
+  h2 += h1;
+
+  std::string digest;
+  appendHex(digest, h1);
+  appendHex(digest, h2);
+  return digest;
+}
+
+void ABWHash::_mixBlock(const unsigned char *const block)
+{
+  m_h1 ^= mixK1(readBlock(block, 8));
+  m_h1 = rotl(m_h1, 27);
+  m_h1 += m_h2;
+  m_h1 = m_h1 * 5 + 0x52dce729;
+
+  m_h2 ^= mixK2(readBlock(block + 8, 8));
+  m_h2 = rotl(m_h2, 31);
+  m_h2 += m_h1;
+  m_h2 = m_h2 * 5 + 0x38495ab5;
+}
+
+ABWSha256::ABWSha256()
+  : m_state()
+  , m_length(0)
+  , m_tail()
+  , m_tailLength(0)
+{
+  static const boost::uint32_t INITIAL_STATE[8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  std::copy(INITIAL_STATE, INITIAL_STATE + 8, m_state);
+}
+
+void ABWSha256::update(const unsigned char *data, std::size_t length)
+{
+  m_length += length;
+  if (m_tailLength)
+  {
+    const std::size_t count = std::min<std::size_t>(64 - m_tailLength, length);
+    memcpy(m_tail + m_tailLength, data, count);
+    m_tailLength += count;
+    data += count;
+    length -= count;
+    if (m_tailLength < 64)
+      return;
+    _processBlock(m_tail);
+    m_tailLength = 0;
+  }
+  for (; length >= 64; data += 64, length -= 64)
+    _processBlock(data);
+  if (length)
+  {
+    memcpy(m_tail, data, length);
+    m_tailLength = length;
+  }
+}
+
+std::string ABWSha256::getDigest() const
+{
+  // the padding is added to a copy, so that more data can still be added
+  ABWSha256 padded(*this);
+  const boost::uint64_t bitLength = m_length * 8;
+  unsigned char padding[72] = {0x80};
+  const std::size_t paddingLength = (m_tailLength < 56 ? 56 : 120) - m_tailLength;
+  for (int i = 0; i < 8; ++i)
+    padding[paddingLength + i] = (unsigned char)(bitLength >> (56 - 8 * i));
+  padded.update(padding, paddingLength + 8);
+
+  std::string digest;
+  for (int i = 0; i < 8; ++i)
+    appendHex(digest, padded.m_state[i], 8);
+  return digest;
+}
+
+void ABWSha256::_processBlock(const unsigned char *const block)
+{
+  boost::uint32_t w[64];
+  for (int i = 0; i < 16; ++i)
+    w[i] = (boost::uint32_t(block[4 * i]) << 24) | (boost::uint32_t(block[4 * i + 1]) << 16)
+           | (boost::uint32_t(block[4 * i + 2]) << 8) | boost::uint32_t(block[4 * i + 3]);
+  for (int i = 16; i < 64; ++i)
+  {
+    const boost::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    const boost::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  boost::uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+  boost::uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+  for (int i = 0; i < 64; ++i)
+  {
+    const boost::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+    const boost::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  m_state[0] += a;
+  m_state[1] += b;
+  m_state[2] += c;
+  m_state[3] += d;
+  m_state[4] += e;
+  m_state[5] += f;
+  m_state[6] += g;
+  m_state[7] += h;
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
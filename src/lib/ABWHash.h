@@ -0,0 +1,66 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWHASH_H__
+#define __ABWHASH_H__
+
+#include <cstddef>
+#include <string>
+#include <boost/cstdint.hpp>
+
+namespace libabw
+{
+
+/** A 128-bit hash (MurmurHash3 x64_128) of data given in pieces of any
+  * size. It finds changed data, it does not protect against attacks.
+  */
+class ABWHash
+{
+public:
+  ABWHash();
+
+  void update(const unsigned char *data, std::size_t length);
+  /// Returns the hash of the data so far as 32 hex digits.
+  std::string getDigest() const;
+
+private:
+  void _mixBlock(const unsigned char *block);
+
+  boost::uint64_t m_h1;
+  boost::uint64_t m_h2;
+  boost::uint64_t m_length;
+  unsigned char m_tail[16];
+  std::size_t m_tailLength;
+};
+
+/** SHA-256 of data given in pieces of any size, for where a collision
+  * must not be made up on purpose.
+  */
+class ABWSha256
+{
+public:
+  ABWSha256();
+
+  void update(const unsigned char *data, std::size_t length);
+  /// Returns the hash of the data so far as 64 hex digits.
+  std::string getDigest() const;
+
+private:
+  void _processBlock(const unsigned char *block);
+
+  boost::uint32_t m_state[8];
+  boost::uint64_t m_length;
+  unsigned char m_tail[64];
+  std::size_t m_tailLength;
+};
+
+} // namespace libabw
+
+#endif // __ABWHASH_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
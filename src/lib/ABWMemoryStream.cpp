@@ -0,0 +1,69 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ABWMemoryStream.h"
+
+namespace libabw
+{
+
+ABWMemoryStream::ABWMemoryStream(const unsigned char *const data, const unsigned long size)
+  : librevenge::RVNGInputStream()
+  , m_data(data)
+  , m_size(size)
+  , m_offset(0)
+{
+}
+
+const unsigned char *ABWMemoryStream::read(const unsigned long numBytes, unsigned long &numBytesRead)
+{
+  numBytesRead = 0;
+  if (numBytes == 0 || m_offset >= m_size)
+    return 0;
+
+  numBytesRead = numBytes < m_size - m_offset ? numBytes : m_size - m_offset;
+  const unsigned char *const data = m_data + m_offset;
+  m_offset += numBytesRead;
+  return data;
+}
+
+int ABWMemoryStream::seek(const long offset, const librevenge::RVNG_SEEK_TYPE seekType)
+{
+  long newOffset = offset;
+  if (seekType == librevenge::RVNG_SEEK_CUR)
+    newOffset += long(m_offset);
+  else if (seekType == librevenge::RVNG_SEEK_END)
+    newOffset += long(m_size);
+
+  if (newOffset < 0)
+  {
+    m_offset = 0;
+    return 1;
+  }
+  if ((unsigned long)newOffset > m_size)
+  {
+    m_offset = m_size;
+    return 1;
+  }
+  m_offset = (unsigned long)newOffset;
+  return 0;
+}
+
+long ABWMemoryStream::tell()
+{
+  return long(m_offset);
+}
+
+bool ABWMemoryStream::isEnd()
+{
+  return m_offset >= m_size;
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
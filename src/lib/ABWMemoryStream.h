@@ -0,0 +1,68 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWMEMORYSTREAM_H__
+#define __ABWMEMORYSTREAM_H__
+
+#include <librevenge-stream/librevenge-stream.h>
+
+namespace libabw
+{
+
+/** A stream reading from memory owned by somebody else, so that any
+  * number of them can read the same data at the same time.
+  */
+class ABWMemoryStream : public librevenge::RVNGInputStream
+{
+public:
+  ABWMemoryStream(const unsigned char *data, unsigned long size);
+  ~ABWMemoryStream() {}
+
+  bool isStructured()
+  {
+    return false;
+  }
+  unsigned subStreamCount()
+  {
+    return 0;
+  }
+  const char *subStreamName(unsigned)
+  {
+    return 0;
+  }
+  bool existsSubStream(const char *)
+  {
+    return false;
+  }
+  librevenge::RVNGInputStream *getSubStreamByName(const char *)
+  {
+    return 0;
+  }
+  librevenge::RVNGInputStream *getSubStreamById(unsigned)
+  {
+    return 0;
+  }
+  const unsigned char *read(unsigned long numBytes, unsigned long &numBytesRead);
+  int seek(long offset, librevenge::RVNG_SEEK_TYPE seekType);
+  long tell();
+  bool isEnd();
+
+private:
+  ABWMemoryStream(const ABWMemoryStream &);
+  ABWMemoryStream &operator=(const ABWMemoryStream &);
+
+  const unsigned char *const m_data;
+  const unsigned long m_size;
+  unsigned long m_offset;
+};
+
+} // namespace libabw
+
+#endif // __ABWMEMORYSTREAM_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
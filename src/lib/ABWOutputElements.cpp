@@ -7,1075 +7,1405 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include <cstring>
+#include <stdio.h>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
 #include "ABWOutputElements.h"
+#include "ABWThread.h"
 #include "libabw_internal.h"
 
+// the number of events in a batch of a pipelined stream
+#define PIPE_BATCH_SIZE 1024
+// the number of full batches a pipelined stream holds at most
+#define PIPE_QUEUE_LENGTH 8
+
+
 namespace libabw
 {
 
-class ABWOutputElement
+namespace
 {
-public:
-  ABWOutputElement() {}
-  virtual ~ABWOutputElement() {}
-  virtual void write(librevenge::RVNGTextInterface *iface,
-                     const std::map<int, std::list<ABWOutputElement *> > *footers,
-                     const std::map<int, std::list<ABWOutputElement *> > *headers) const = 0;
-};
 
-class ABWCloseEndnoteElement : public ABWOutputElement
+/* Appends an unambiguous encoding of propList to key. Every value is
+ * recorded as its string form, its unit and the bits of its double
+ * form, so lists that only differ in precision are kept apart.
+ */
+void appendPropertyList(std::string &key, const librevenge::RVNGPropertyList &propList)
 {
-public:
-  ABWCloseEndnoteElement() {}
-  ~ABWCloseEndnoteElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-};
+  librevenge::RVNGPropertyList::Iter i(propList);
+  for (i.rewind(); i.next();)
+  {
+    if (i.child())
+    {
+      key.push_back('\2');
+      key.append(i.key());
+      key.push_back('\0');
+      const librevenge::RVNGPropertyListVector &vec = *i.child();
+      for (unsigned long j = 0; j < vec.count(); ++j)
+      {
+        appendPropertyList(key, vec[j]);
+        key.push_back('\3');
+      }
+      key.push_back('\4');
+    }
+    else if (i())
+    {
+      key.push_back('\1');
+      key.append(i.key());
+      key.push_back('\0');
+      key.append(i()->getStr().cstr());
+      key.push_back('\0');
+      key.push_back(char(i()->getUnit()));
+      const double value = i()->getDouble();
+      char bits[sizeof(value)];
+      std::memcpy(bits, &value, sizeof(value));
+      key.append(bits, sizeof(bits));
+    }
+  }
+}
 
-class ABWCloseFooterElement : public ABWOutputElement
+/* The binary form made by ABWOutputElements::serialize. Numbers are
+ * stored 7 bits per byte, low bits first; signed ones are zigzag coded
+ * first, doubles are stored as the bits of their IEEE form.
+ */
+
+void writeNumber(std::string &data, unsigned long value)
 {
-public:
-  ABWCloseFooterElement() {}
-  ~ABWCloseFooterElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-};
+  while (value >= 0x80)
+  {
+    data.push_back(char((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  data.push_back(char(value));
+}
 
-class ABWCloseFootnoteElement : public ABWOutputElement
+void writeSignedNumber(std::string &data, const long value)
 {
-public:
-  ABWCloseFootnoteElement() {}
-  ~ABWCloseFootnoteElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-};
+  writeNumber(data, value < 0 ? ((~(unsigned long)(value)) << 1) | 1 : (unsigned long)(value) << 1);
+}
 
-class ABWCloseFrameElement : public ABWOutputElement
+void writeString(std::string &data, const char *const str)
 {
-public:
-  ABWCloseFrameElement() {}
-  ~ABWCloseFrameElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-};
+  const std::size_t length = std::strlen(str);
+  writeNumber(data, (unsigned long)length);
+  data.append(str, length);
+}
 
-class ABWCloseHeaderElement : public ABWOutputElement
+void writeDouble(std::string &data, const double value)
 {
-public:
-  ABWCloseHeaderElement() {}
-  ~ABWCloseHeaderElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-};
+  boost::uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; ++i, bits >>= 8)
+    data.push_back(char(bits & 0xff));
+}
 
-class ABWCloseLinkElement : public ABWOutputElement
+bool isSameProperty(const librevenge::RVNGProperty &property, const librevenge::RVNGProperty &other)
 {
-public:
-  ABWCloseLinkElement() {}
-  ~ABWCloseLinkElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  const double value = property.getDouble();
+  const double otherValue = other.getDouble();
+  return property.getUnit() == other.getUnit() && property.getInt() == other.getInt()
+         && !std::memcmp(&value, &otherValue, sizeof(value))
+         && !std::strcmp(property.getStr().cstr(), other.getStr().cstr());
+}
+
+/* librevenge does not tell the type of a property, so the type it is
+ * stored as is the first one that gives the same values back.
+ */
+char getPropertyType(const char *const name, const librevenge::RVNGProperty &property)
+{
+  librevenge::RVNGPropertyList probe;
+  probe.insert(name, property.getInt());
+  if (isSameProperty(*probe[name], property))
+    return 'i';
+  probe.insert(name, true);
+  if (isSameProperty(*probe[name], property))
+    return 't';
+  probe.insert(name, false);
+  if (isSameProperty(*probe[name], property))
+    return 'f';
+  if (property.getUnit() < librevenge::RVNG_UNIT_ERROR)
   {
-    return new ABWCloseLinkElement();
+    probe.insert(name, property.getDouble(), property.getUnit());
+    if (isSameProperty(*probe[name], property))
+      return 'd';
   }
-};
+  return 's';
+}
 
-class ABWCloseListElementElement : public ABWOutputElement
+void writePropertyList(std::string &data, const librevenge::RVNGPropertyList &propList)
 {
-public:
-  ABWCloseListElementElement() {}
-  ~ABWCloseListElementElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  librevenge::RVNGPropertyList::Iter i(propList);
+  unsigned long count = 0;
+  for (i.rewind(); i.next();)
   {
-    return new ABWCloseListElementElement();
+    if (i.child() || i())
+      ++count;
   }
-};
-
-class ABWCloseOrderedListLevelElement : public ABWOutputElement
-{
-public:
-  ABWCloseOrderedListLevelElement() {}
-  ~ABWCloseOrderedListLevelElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  writeNumber(data, count);
+  for (i.rewind(); i.next();)
   {
-    return new ABWCloseOrderedListLevelElement();
+    if (i.child())
+    {
+      data.push_back('v');
+      writeString(data, i.key());
+      const librevenge::RVNGPropertyListVector &vec = *i.child();
+      writeNumber(data, vec.count());
+      for (unsigned long j = 0; j < vec.count(); ++j)
+        writePropertyList(data, vec[j]);
+    }
+    else if (i())
+    {
+      const char type = getPropertyType(i.key(), *i());
+      data.push_back(type);
+      writeString(data, i.key());
+      switch (type)
+      {
+      case 'i':
+        writeSignedNumber(data, i()->getInt());
+        break;
+      case 'd':
+        data.push_back(char(i()->getUnit()));
+        writeDouble(data, i()->getDouble());
+        break;
+      case 's':
+        writeString(data, i()->getStr().cstr());
+        break;
+      default:
+        break;
+      }
+    }
   }
-};
+}
 
-class ABWClosePageSpanElement : public ABWOutputElement
+/** Reads the binary form made by ABWOutputElements::serialize. Reading
+  * past the end makes it fail, and then every value read is 0.
+  */
+class BinaryReader
 {
 public:
-  ABWClosePageSpanElement() {}
-  ~ABWClosePageSpanElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  BinaryReader(const unsigned char *const data, const std::size_t length)
+    : m_pos(data)
+    , m_end(data + length)
+    , m_isFailed(false)
   {
-    return new ABWClosePageSpanElement();
   }
-};
 
-class ABWCloseParagraphElement : public ABWOutputElement
-{
-public:
-  ABWCloseParagraphElement() {}
-  ~ABWCloseParagraphElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  bool isFailed() const
   {
-    return new ABWCloseParagraphElement();
+    return m_isFailed;
   }
-};
 
-class ABWCloseSectionElement : public ABWOutputElement
-{
-public:
-  ABWCloseSectionElement() {}
-  ~ABWCloseSectionElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  bool isEnd() const
   {
-    return new ABWCloseSectionElement();
+    return m_pos == m_end;
   }
-};
 
-class ABWCloseSpanElement : public ABWOutputElement
-{
-public:
-  ABWCloseSpanElement() {}
-  ~ABWCloseSpanElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  unsigned char readByte()
   {
-    return new ABWCloseSpanElement();
+    if (m_pos == m_end)
+    {
+      m_isFailed = true;
+      return 0;
+    }
+    return *m_pos++;
   }
-};
 
-class ABWCloseTableElement : public ABWOutputElement
-{
-public:
-  ABWCloseTableElement() {}
-  ~ABWCloseTableElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  unsigned long readNumber()
   {
-    return new ABWCloseTableElement();
+    unsigned long value = 0;
+    for (unsigned shift = 0; shift < sizeof(value) * 8; shift += 7)
+    {
+      const unsigned char c = readByte();
+      value |= (unsigned long)(c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return value;
+    }
+    m_isFailed = true;
+    return 0;
   }
-};
 
-class ABWCloseTableCellElement : public ABWOutputElement
-{
-public:
-  ABWCloseTableCellElement() {}
-  ~ABWCloseTableCellElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  long readSignedNumber()
   {
-    return new ABWCloseTableCellElement();
+    const unsigned long value = readNumber();
+    return value & 1 ? long(~(value >> 1)) : long(value >> 1);
   }
-};
 
-class ABWCloseTableRowElement : public ABWOutputElement
-{
-public:
-  ABWCloseTableRowElement() {}
-  ~ABWCloseTableRowElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  /// Reads a string into @c str, without its length.
+  void readString(std::string &str, std::size_t length)
   {
-    return new ABWCloseTableRowElement();
+    if (std::size_t(m_end - m_pos) < length)
+    {
+      m_isFailed = true;
+      length = 0;
+    }
+    str.assign(reinterpret_cast<const char *>(m_pos), length);
+    m_pos += length;
   }
-};
 
-class ABWCloseUnorderedListLevelElement : public ABWOutputElement
-{
-public:
-  ABWCloseUnorderedListLevelElement() {}
-  ~ABWCloseUnorderedListLevelElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  void readString(std::string &str)
   {
-    return new ABWCloseUnorderedListLevelElement();
+    readString(str, readNumber());
   }
-};
 
-class ABWInsertBinaryObjectElement : public ABWOutputElement
-{
-public:
-  ABWInsertBinaryObjectElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWInsertBinaryObjectElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  double readDouble()
   {
-    return new ABWInsertBinaryObjectElement(m_propList);
+    boost::uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i)
+      bits |= boost::uint64_t(readByte()) << (8 * i);
+    double value = 0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
   }
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
 
-class ABWInsertCoveredTableCellElement : public ABWOutputElement
-{
-public:
-  ABWInsertCoveredTableCellElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWInsertCoveredTableCellElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  bool readPropertyList(librevenge::RVNGPropertyList &propList, const unsigned depth = 0)
   {
-    return new ABWInsertCoveredTableCellElement(m_propList);
+    // lists are not nested deeply by libabw; anything else is not valid
+    if (depth > 16)
+      m_isFailed = true;
+    std::string name;
+    std::string value;
+    for (unsigned long count = readNumber(); count > 0 && !m_isFailed; --count)
+    {
+      const unsigned char type = readByte();
+      readString(name);
+      switch (type)
+      {
+      case 'i':
+        propList.insert(name.c_str(), int(readSignedNumber()));
+        break;
+      case 't':
+        propList.insert(name.c_str(), true);
+        break;
+      case 'f':
+        propList.insert(name.c_str(), false);
+        break;
+      case 'd':
+      {
+        const unsigned char unit = readByte();
+        const double number = readDouble();
+        if (unit < librevenge::RVNG_UNIT_ERROR)
+          propList.insert(name.c_str(), number, librevenge::RVNGUnit(unit));
+        else
+          m_isFailed = true;
+        break;
+      }
+      case 's':
+        readString(value);
+        propList.insert(name.c_str(), librevenge::RVNGString(value.c_str()));
+        break;
+      case 'v':
+      {
+        librevenge::RVNGPropertyListVector vec;
+        for (unsigned long vecCount = readNumber(); vecCount > 0 && !m_isFailed; --vecCount)
+        {
+          librevenge::RVNGPropertyList child;
+          readPropertyList(child, depth + 1);
+          vec.append(child);
+        }
+        propList.insert(name.c_str(), vec);
+        break;
+      }
+      default:
+        m_isFailed = true;
+        break;
+      }
+    }
+    return !m_isFailed;
   }
+
 private:
-  librevenge::RVNGPropertyList m_propList;
+  BinaryReader(const BinaryReader &);
+  BinaryReader &operator=(const BinaryReader &);
+
+  const unsigned char *m_pos;
+  const unsigned char *const m_end;
+  bool m_isFailed;
 };
 
-class ABWInsertLineBreakElement : public ABWOutputElement
+// thrown on the parser thread when the interface has failed on the writing one
+struct PipeWritingFailed
 {
-public:
-  ABWInsertLineBreakElement() {}
-  ~ABWInsertLineBreakElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
-  {
-    return new ABWInsertLineBreakElement();
-  }
 };
 
-class ABWInsertSpaceElement : public ABWOutputElement
+// thrown when spilled events cannot be read back
+struct SpillReadingFailed
 {
-public:
-  ABWInsertSpaceElement() {}
-  ~ABWInsertSpaceElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
-  {
-    return new ABWInsertSpaceElement();
-  }
 };
 
-class ABWInsertTabElement : public ABWOutputElement
+// a rough estimate of the memory taken by a shared property list and its key
+unsigned long getSharedMemorySize(const std::string &key)
 {
-public:
-  ABWInsertTabElement() {}
-  ~ABWInsertTabElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
-  {
-    return new ABWInsertTabElement();
-  }
-};
+  return (unsigned long)(2 * key.size() + 64);
+}
 
-class ABWInsertTextElement : public ABWOutputElement
+unsigned long getMemorySize(const librevenge::RVNGPropertyList &propList)
 {
-public:
-  ABWInsertTextElement(const librevenge::RVNGString &text) :
-    m_text(text) {}
-  ~ABWInsertTextElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
-  {
-    return new ABWInsertTextElement(m_text);
-  }
-private:
-  librevenge::RVNGString m_text;
-};
+  std::string data;
+  writePropertyList(data, propList);
+  return (unsigned long)(data.size() + 64);
+}
+
+} // anonymous namespace
 
-class ABWOpenEndnoteElement : public ABWOutputElement
+/* Streamed events on their way to the interface. The parser fills one
+ * batch at a time. Full batches wait in a queue of limited length for
+ * the writing thread, so the parser can only get a bit ahead of it.
+ */
+struct ABWOutputElements::Pipe : public ABWTask
 {
-public:
-  ABWOpenEndnoteElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenEndnoteElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
-  {
-    return new ABWOpenEndnoteElement(m_propList);
-  }
+  Pipe(librevenge::RVNGTextInterface *iface, const ABWOutputElements *headersAndFooters);
+  ~Pipe();
+
+  void run();
+
+  /// Returns the batch to add events to.
+  ABWOutputElements &getBatch();
+  /// Passes the batch on if it is full.
+  void checkBatch();
+  /// Passes the batch on and waits until everything has been written.
+  void finish();
+
+  librevenge::RVNGTextInterface *const m_iface;
+  const ABWOutputElements *const m_headersAndFooters;
+  boost::shared_ptr<ABWOutputElements> m_batch;
+
+  // shared with the writing thread, guarded by m_mutex
+  ABWMutex m_mutex;
+  ABWCondition m_condition;
+  std::deque<boost::shared_ptr<ABWOutputElements> > m_batches;
+  bool m_isClosed;
+  bool m_hasFailed;
+
+  ABWThread m_thread;
+
 private:
-  librevenge::RVNGPropertyList m_propList;
+  Pipe(const Pipe &);
+  Pipe &operator=(const Pipe &);
+
+  void pushBatch();
 };
 
-class ABWOpenFooterElement : public ABWOutputElement
+ABWOutputElements::Pipe::Pipe(librevenge::RVNGTextInterface *const iface, const ABWOutputElements *const headersAndFooters)
+  : ABWTask()
+  , m_iface(iface)
+  , m_headersAndFooters(headersAndFooters)
+  , m_batch()
+  , m_mutex()
+  , m_condition()
+  , m_batches()
+  , m_isClosed(false)
+  , m_hasFailed(false)
+  , m_thread()
 {
-public:
-  ABWOpenFooterElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenFooterElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
-  {
-    return new ABWOpenFooterElement(m_propList);
-  }
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+}
 
-class ABWOpenFootnoteElement : public ABWOutputElement
+ABWOutputElements::Pipe::~Pipe()
 {
-public:
-  ABWOpenFootnoteElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenFootnoteElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
   {
-    return new ABWOpenFootnoteElement(m_propList);
+    ABWMutexLock lock(m_mutex);
+    m_isClosed = true;
+    m_condition.notifyAll();
   }
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  m_thread.join();
+}
 
-class ABWOpenFrameElement : public ABWOutputElement
+void ABWOutputElements::Pipe::run()
 {
-public:
-  ABWOpenFrameElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenFrameElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  while (true)
   {
-    return new ABWOpenFrameElement(m_propList);
+    boost::shared_ptr<ABWOutputElements> batch;
+    {
+      ABWMutexLock lock(m_mutex);
+      while (m_batches.empty() && !m_isClosed)
+        m_condition.wait(m_mutex);
+      if (m_batches.empty())
+        return;
+      batch = m_batches.front();
+      m_batches.pop_front();
+      m_condition.notifyAll();
+    }
+    try
+    {
+      batch->write(m_iface);
+    }
+    catch (...)
+    {
+      ABW_DEBUG_MSG(("ABWOutputElements::Pipe::run: writing failed\n"));
+      ABWMutexLock lock(m_mutex);
+      m_hasFailed = true;
+      m_batches.clear();
+      m_condition.notifyAll();
+      return;
+    }
   }
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+}
 
-class ABWOpenHeaderElement : public ABWOutputElement
+ABWOutputElements &ABWOutputElements::Pipe::getBatch()
 {
-public:
-  ABWOpenHeaderElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenHeaderElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-  ABWOutputElement *clone()
+  if (!m_batch)
   {
-    return new ABWOpenHeaderElement(m_propList);
+    m_batch.reset(new ABWOutputElements());
+    m_batch->m_headersAndFooters = m_headersAndFooters;
   }
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  return *m_batch;
+}
 
-class ABWOpenLinkElement : public ABWOutputElement
+void ABWOutputElements::Pipe::checkBatch()
 {
-public:
-  ABWOpenLinkElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenLinkElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  if (m_batch && m_batch->m_bodyElements.size() >= PIPE_BATCH_SIZE)
+    pushBatch();
+}
 
-class ABWOpenListElementElement : public ABWOutputElement
+void ABWOutputElements::Pipe::pushBatch()
 {
-public:
-  ABWOpenListElementElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenListElementElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  ABWMutexLock lock(m_mutex);
+  while (m_batches.size() >= PIPE_QUEUE_LENGTH && !m_hasFailed)
+    m_condition.wait(m_mutex);
+  if (m_hasFailed)
+    throw PipeWritingFailed();
+  if (m_batch)
+    m_batches.push_back(m_batch);
+  m_batch.reset();
+  m_condition.notifyAll();
+}
 
-class ABWOpenOrderedListLevelElement : public ABWOutputElement
+void ABWOutputElements::Pipe::finish()
 {
-public:
-  ABWOpenOrderedListLevelElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenOrderedListLevelElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  pushBatch();
+  {
+    ABWMutexLock lock(m_mutex);
+    m_isClosed = true;
+    m_condition.notifyAll();
+  }
+  m_thread.join();
+  if (m_hasFailed)
+    throw PipeWritingFailed();
+}
 
-class ABWOpenPageSpanElement : public ABWOutputElement
+/* Body events moved out of memory. Every spill adds a segment to a
+ * temporary file, holding the binary form of its events.
+ */
+struct ABWOutputElements::Spill
 {
-public:
-  ABWOpenPageSpanElement(const librevenge::RVNGPropertyList &propList,
-                         int footer, int footerLeft, int footerFirst, int footerLast,
-                         int header, int headerLeft, int headerFirst, int headerLast) :
-    m_propList(propList),
-    m_footer(footer),
-    m_footerLeft(footerLeft),
-    m_footerFirst(footerFirst),
-    m_footerLast(footerLast),
-    m_header(header),
-    m_headerLeft(headerLeft),
-    m_headerFirst(headerFirst),
-    m_headerLast(headerLast) {}
-  ~ABWOpenPageSpanElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  void _writeElements(librevenge::RVNGTextInterface *iface, int id,
-                      const std::map<int, std::list<ABWOutputElement *> > *elements) const;
-  librevenge::RVNGPropertyList m_propList;
-  int m_footer;
-  int m_footerLeft;
-  int m_footerFirst;
-  int m_footerLast;
-  int m_header;
-  int m_headerLeft;
-  int m_headerFirst;
-  int m_headerLast;
-};
+  Spill();
+  ~Spill();
 
-class ABWOpenParagraphElement : public ABWOutputElement
-{
-public:
-  ABWOpenParagraphElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenParagraphElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  /// Adds a segment. Returns false if it could not be written.
+  bool append(const std::string &data);
+  /// Reads segment @c index into @c elements, which must be empty.
+  bool read(std::size_t index, ABWOutputElements &elements) const;
 
-class ABWOpenSectionElement : public ABWOutputElement
-{
-public:
-  ABWOpenSectionElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenSectionElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  FILE *m_file;
+  std::vector<std::pair<long, std::size_t> > m_segments;
+  // the elements may be written on more threads at once
+  mutable ABWMutex m_mutex;
 
-class ABWOpenSpanElement : public ABWOutputElement
-{
-public:
-  ABWOpenSpanElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenSpanElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
 private:
-  librevenge::RVNGPropertyList m_propList;
+  Spill(const Spill &);
+  Spill &operator=(const Spill &);
 };
 
-class ABWOpenTableElement : public ABWOutputElement
+ABWOutputElements::Spill::Spill()
+  : m_file(0)
+  , m_segments()
+  , m_mutex()
 {
-public:
-  ABWOpenTableElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenTableElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+}
 
-class ABWOpenTableCellElement : public ABWOutputElement
+ABWOutputElements::Spill::~Spill()
 {
-public:
-  ABWOpenTableCellElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenTableCellElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  if (m_file)
+    fclose(m_file);
+}
 
-class ABWOpenTableRowElement : public ABWOutputElement
+bool ABWOutputElements::Spill::append(const std::string &data)
 {
-public:
-  ABWOpenTableRowElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenTableRowElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  ABWMutexLock lock(m_mutex);
+  if (!m_file)
+    m_file = tmpfile();
+  if (!m_file || fseek(m_file, 0, SEEK_END) != 0)
+    return false;
+  const long offset = ftell(m_file);
+  if (offset < 0 || fwrite(data.data(), 1, data.size(), m_file) != data.size())
+    return false;
+  m_segments.push_back(std::make_pair(offset, data.size()));
+  return true;
+}
 
-class ABWOpenUnorderedListLevelElement : public ABWOutputElement
+bool ABWOutputElements::Spill::read(const std::size_t index, ABWOutputElements &elements) const
 {
-public:
-  ABWOpenUnorderedListLevelElement(const librevenge::RVNGPropertyList &propList) :
-    m_propList(propList) {}
-  ~ABWOpenUnorderedListLevelElement() {}
-  void write(librevenge::RVNGTextInterface *iface,
-             const std::map<int, std::list<ABWOutputElement *> > *footers,
-             const std::map<int, std::list<ABWOutputElement *> > *headers) const;
-private:
-  librevenge::RVNGPropertyList m_propList;
-};
+  std::vector<unsigned char> data(m_segments[index].second);
+  {
+    ABWMutexLock lock(m_mutex);
+    if (data.empty() || fseek(m_file, m_segments[index].first, SEEK_SET) != 0
+        || fread(&data[0], 1, data.size(), m_file) != data.size())
+      return false;
+  }
+  return elements.deserialize(&data[0], data.size());
+}
 
 } // namespace libabw
 
-void libabw::ABWCloseEndnoteElement::write(librevenge::RVNGTextInterface *iface,
-                                           const std::map<int, std::list<ABWOutputElement *> > *,
-                                           const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->closeEndnote();
-}
+// ABWOutputElements
 
-void libabw::ABWCloseFooterElement::write(librevenge::RVNGTextInterface *iface,
-                                          const std::map<int, std::list<ABWOutputElement *> > *,
-                                          const std::map<int, std::list<ABWOutputElement *> > *) const
+libabw::ABWOutputElements::ABWOutputElements()
+  : m_bodyElements(), m_headerElements(), m_footerElements(), m_elements(0),
+    m_text(), m_binaryObjects(), m_pageSpans(), m_propLists(), m_propListKey(),
+    m_streamingIface(0), m_headersAndFooters(0), m_pipe(), m_compactEvents(false), m_spanPropList(0),
+    m_spanPropListKey(), m_streamedSpanPropList(),
+    m_isSpanOpenPending(false), m_isSpanClosePending(false), m_pendingText(),
+    m_memoryLimit(0), m_memorySize(0), m_keptMemorySize(0), m_spill(), m_isSpillFailed(false)
 {
-  if (iface)
-    iface->closeFooter();
+  m_elements = &m_bodyElements;
 }
 
-void libabw::ABWCloseFootnoteElement::write(librevenge::RVNGTextInterface *iface,
-                                            const std::map<int, std::list<ABWOutputElement *> > *,
-                                            const std::map<int, std::list<ABWOutputElement *> > *) const
+libabw::ABWOutputElements::~ABWOutputElements()
 {
-  if (iface)
-    iface->closeFootnote();
 }
 
-void libabw::ABWCloseFrameElement::write(librevenge::RVNGTextInterface *iface,
-                                         const std::map<int, std::list<ABWOutputElement *> > *,
-                                         const std::map<int, std::list<ABWOutputElement *> > *) const
+const librevenge::RVNGPropertyList &libabw::ABWOutputElements::_share(const librevenge::RVNGPropertyList &propList)
 {
-  if (iface)
-    iface->closeFrame();
-}
+  m_propListKey.clear();
+  appendPropertyList(m_propListKey, propList);
 
-void libabw::ABWCloseHeaderElement::write(librevenge::RVNGTextInterface *iface,
-                                          const std::map<int, std::list<ABWOutputElement *> > *,
-                                          const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->closeHeader();
+  boost::unordered_map<std::string, librevenge::RVNGPropertyList>::iterator it = m_propLists.find(m_propListKey);
+  if (it == m_propLists.end())
+  {
+    it = m_propLists.insert(std::make_pair(m_propListKey, propList)).first;
+    m_memorySize += getSharedMemorySize(m_propListKey);
+  }
+  return it->second;
 }
 
-void libabw::ABWCloseLinkElement::write(librevenge::RVNGTextInterface *iface,
-                                        const std::map<int, std::list<ABWOutputElement *> > *,
-                                        const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::startStreaming(librevenge::RVNGTextInterface *iface, const ABWOutputElements *headersAndFooters,
+                                               const bool pipelined)
 {
-  if (iface)
-    iface->closeLink();
+  m_streamingIface = iface;
+  m_headersAndFooters = headersAndFooters;
+  if (iface && pipelined && ABWThread::isSupported())
+  {
+    m_pipe.reset(new Pipe(iface, headersAndFooters));
+    m_pipe->m_thread.start(*m_pipe);
+  }
 }
 
-void libabw::ABWCloseListElementElement::write(librevenge::RVNGTextInterface *iface,
-                                               const std::map<int, std::list<ABWOutputElement *> > *,
-                                               const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::setCompactEvents(const bool compact)
 {
-  if (iface)
-    iface->closeListElement();
+  _flushPending();
+  m_compactEvents = compact;
 }
 
-void libabw::ABWCloseOrderedListLevelElement::write(librevenge::RVNGTextInterface *iface,
-                                                    const std::map<int, std::list<ABWOutputElement *> > *,
-                                                    const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::setMemoryLimit(const unsigned long limit)
 {
-  if (iface)
-    iface->closeOrderedListLevel();
+  m_memoryLimit = limit;
+  m_memorySize = _getMemorySize();
+  m_keptMemorySize = 0;
 }
 
-void libabw::ABWClosePageSpanElement::write(librevenge::RVNGTextInterface *iface,
-                                            const std::map<int, std::list<ABWOutputElement *> > *,
-                                            const std::map<int, std::list<ABWOutputElement *> > *) const
+bool libabw::ABWOutputElements::isSpilled() const
 {
-  if (iface)
-    iface->closePageSpan();
+  return m_spill && !m_spill->m_segments.empty();
 }
 
-void libabw::ABWCloseParagraphElement::write(librevenge::RVNGTextInterface *iface,
-                                             const std::map<int, std::list<ABWOutputElement *> > *,
-                                             const std::map<int, std::list<ABWOutputElement *> > *) const
+unsigned long libabw::ABWOutputElements::_getMemorySize() const
 {
-  if (iface)
-    iface->closeParagraph();
+  std::size_t count = m_bodyElements.size();
+  for (std::map<int, Elements_t>::const_iterator iter = m_headerElements.begin(); iter != m_headerElements.end(); ++iter)
+    count += iter->second.size();
+  for (std::map<int, Elements_t>::const_iterator iter = m_footerElements.begin(); iter != m_footerElements.end(); ++iter)
+    count += iter->second.size();
+  unsigned long size = (unsigned long)(count * sizeof(Element) + m_text.size() + m_pageSpans.size() * sizeof(PageSpan));
+  if (m_memoryLimit)
+  {
+    for (std::deque<librevenge::RVNGPropertyList>::const_iterator iter = m_binaryObjects.begin(); iter != m_binaryObjects.end(); ++iter)
+      size += getMemorySize(*iter);
+  }
+  for (boost::unordered_map<std::string, librevenge::RVNGPropertyList>::const_iterator iter = m_propLists.begin(); iter != m_propLists.end(); ++iter)
+    size += getSharedMemorySize(iter->first);
+  return size;
 }
 
-void libabw::ABWCloseSectionElement::write(librevenge::RVNGTextInterface *iface,
-                                           const std::map<int, std::list<ABWOutputElement *> > *,
-                                           const std::map<int, std::list<ABWOutputElement *> > *) const
+/* Spills the body events if they have grown past the limit. What a
+ * spill keeps in memory is not counted, so that a document whose
+ * headers alone are past the limit is not spilled after every event.
+ */
+void libabw::ABWOutputElements::_checkMemoryLimit()
 {
-  if (iface)
-    iface->closeSection();
+  if (m_memoryLimit && !m_isSpillFailed && m_memorySize > m_memoryLimit
+      && m_memorySize - m_keptMemorySize >= m_memoryLimit / 2)
+    _spill();
 }
 
-void libabw::ABWCloseSpanElement::write(librevenge::RVNGTextInterface *iface,
-                                        const std::map<int, std::list<ABWOutputElement *> > *,
-                                        const std::map<int, std::list<ABWOutputElement *> > *) const
+/* Moves the body events to the temporary file, together with their
+ * texts, binary objects and page spans. Shared property lists stay, so
+ * pointers to them remain valid.
+ */
+void libabw::ABWOutputElements::_spill()
 {
-  if (iface)
-    iface->closeSpan();
+  std::string data;
+  {
+    ABWOutputElements segment;
+    segment._appendElements(segment.m_bodyElements, *this, m_bodyElements);
+    segment.serialize(data);
+  }
+  if (!m_spill)
+    m_spill.reset(new Spill());
+  if (!m_spill->append(data))
+  {
+    ABW_DEBUG_MSG(("ABWOutputElements::_spill: the events could not be stored in a temporary file, keeping them in memory\n"));
+    m_isSpillFailed = true;
+    return;
+  }
+  ABW_DEBUG_MSG(("ABWOutputElements::_spill: %lu events stored in a temporary file\n", (unsigned long)m_bodyElements.size()));
+  Elements_t().swap(m_bodyElements);
+
+  // headers and footers keep what they use
+  std::string text;
+  std::deque<librevenge::RVNGPropertyList> binaryObjects;
+  std::vector<PageSpan> pageSpans;
+  std::map<int, Elements_t> *const maps[] = { &m_headerElements, &m_footerElements };
+  for (std::size_t i = 0; i < sizeof(maps) / sizeof(maps[0]); ++i)
+  {
+    for (std::map<int, Elements_t>::iterator iter = maps[i]->begin(); iter != maps[i]->end(); ++iter)
+    {
+      for (Elements_t::iterator element = iter->second.begin(); element != iter->second.end(); ++element)
+      {
+        switch (element->m_type)
+        {
+        case ABW_INSERT_BINARY_OBJECT:
+          binaryObjects.push_back(m_binaryObjects[element->m_index]);
+          element->m_index = binaryObjects.size() - 1;
+          break;
+        case ABW_INSERT_TEXT:
+        {
+          const std::size_t offset = text.size();
+          text.append(&m_text[element->m_index]);
+          text.push_back('\0');
+          element->m_index = offset;
+          break;
+        }
+        case ABW_OPEN_PAGE_SPAN:
+          pageSpans.push_back(m_pageSpans[element->m_index]);
+          element->m_index = pageSpans.size() - 1;
+          break;
+        default:
+          break;
+        }
+      }
+    }
+  }
+  m_text.swap(text);
+  m_binaryObjects.swap(binaryObjects);
+  m_pageSpans.swap(pageSpans);
+  m_memorySize = m_keptMemorySize = _getMemorySize();
 }
 
-void libabw::ABWCloseTableElement::write(librevenge::RVNGTextInterface *iface,
-                                         const std::map<int, std::list<ABWOutputElement *> > *,
-                                         const std::map<int, std::list<ABWOutputElement *> > *) const
+bool libabw::ABWOutputElements::_isStreaming() const
 {
-  if (iface)
-    iface->closeTable();
+  return m_streamingIface && m_elements == &m_bodyElements;
 }
 
-void libabw::ABWCloseTableCellElement::write(librevenge::RVNGTextInterface *iface,
-                                             const std::map<int, std::list<ABWOutputElement *> > *,
-                                             const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_add(const Element &element)
 {
-  if (iface)
-    iface->closeTableCell();
+  _flushPending();
+  _append(element);
 }
 
-void libabw::ABWCloseTableRowElement::write(librevenge::RVNGTextInterface *iface,
-                                            const std::map<int, std::list<ABWOutputElement *> > *,
-                                            const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_append(const Element &element)
 {
-  if (iface)
-    iface->closeTableRow();
+  if (_isStreaming())
+    _stream(element);
+  else if (m_elements)
+  {
+    m_elements->push_back(element);
+    m_memorySize += sizeof(Element);
+    if (m_elements == &m_bodyElements)
+      _checkMemoryLimit();
+  }
 }
 
-void libabw::ABWCloseUnorderedListLevelElement::write(librevenge::RVNGTextInterface *iface,
-                                                      const std::map<int, std::list<ABWOutputElement *> > *,
-                                                      const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_stream(const Element &element)
 {
-  if (iface)
-    iface->closeUnorderedListLevel();
-}
+  if (!m_pipe)
+  {
+    _write(m_streamingIface, element, true);
+    return;
+  }
 
-void libabw::ABWInsertBinaryObjectElement::write(librevenge::RVNGTextInterface *iface,
-                                                 const std::map<int, std::list<ABWOutputElement *> > *,
-                                                 const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->insertBinaryObject(m_propList);
+  // the batch gets its own copies of the property lists
+  ABWOutputElements &batch = m_pipe->getBatch();
+  if (_hasPropList(element.m_type))
+    batch._add(element.m_type, *element.m_propList);
+  else
+    batch._add(element);
+  if (ABW_END_DOCUMENT == element.m_type)
+    m_pipe->finish();
+  else
+    m_pipe->checkBatch();
 }
 
-void libabw::ABWInsertCoveredTableCellElement::write(librevenge::RVNGTextInterface *iface,
-                                                     const std::map<int, std::list<ABWOutputElement *> > *,
-                                                     const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_appendText(const char *const text, const std::size_t length)
 {
-  if (iface)
-    iface->insertCoveredTableCell(m_propList);
+  if (_isStreaming() && m_pipe)
+  {
+    m_pipe->getBatch()._appendText(text, length);
+    m_pipe->checkBatch();
+  }
+  else if (_isStreaming())
+    m_streamingIface->insertText(librevenge::RVNGString(text));
+  else if (m_elements)
+  {
+    const std::size_t offset = m_text.size();
+    m_text.append(text, length);
+    m_text.push_back('\0');
+    m_memorySize += (unsigned long)(length + 1);
+    Element element;
+    element.m_type = ABW_INSERT_TEXT;
+    element.m_index = offset;
+    _append(element);
+  }
 }
 
-void libabw::ABWInsertLineBreakElement::write(librevenge::RVNGTextInterface *iface,
-                                              const std::map<int, std::list<ABWOutputElement *> > *,
-                                              const std::map<int, std::list<ABWOutputElement *> > *) const
+/* Writes the events held back while compacting: the opening of a span
+ * that has no text yet, the text of the current span and the closing
+ * of a span that might be reopened.
+ */
+void libabw::ABWOutputElements::_flushPending()
 {
-  if (iface)
-    iface->insertLineBreak();
+  if (m_isSpanOpenPending)
+  {
+    m_isSpanOpenPending = false;
+    Element element;
+    element.m_type = ABW_OPEN_SPAN;
+    element.m_propList = m_spanPropList;
+    _append(element);
+  }
+  if (!m_pendingText.empty())
+  {
+    _appendText(m_pendingText.c_str(), m_pendingText.size());
+    m_pendingText.clear();
+  }
+  if (m_isSpanClosePending)
+  {
+    m_isSpanClosePending = false;
+    Element element;
+    element.m_type = ABW_CLOSE_SPAN;
+    element.m_index = 0;
+    _append(element);
+  }
 }
 
-void libabw::ABWInsertSpaceElement::write(librevenge::RVNGTextInterface *iface,
-                                          const std::map<int, std::list<ABWOutputElement *> > *,
-                                          const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_add(const ElementType type)
 {
-  if (iface)
-    iface->insertSpace();
+  Element element;
+  element.m_type = type;
+  element.m_index = 0;
+  _add(element);
 }
 
-void libabw::ABWInsertTabElement::write(librevenge::RVNGTextInterface *iface,
-                                        const std::map<int, std::list<ABWOutputElement *> > *,
-                                        const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_add(const ElementType type, const librevenge::RVNGPropertyList &propList)
 {
-  if (iface)
-    iface->insertTab();
+  if (!m_elements)
+    return;
+  Element element;
+  element.m_type = type;
+  // a streamed event is written right away, so it needs no shared copy
+  element.m_propList = _isStreaming() ? &propList : &_share(propList);
+  _add(element);
 }
 
-void libabw::ABWInsertTextElement::write(librevenge::RVNGTextInterface *iface,
-                                         const std::map<int, std::list<ABWOutputElement *> > *,
-                                         const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_add(const ElementType type, const std::size_t index)
 {
-  if (iface)
-    iface->insertText(m_text);
+  Element element;
+  element.m_type = type;
+  element.m_index = index;
+  _add(element);
 }
 
-void libabw::ABWOpenEndnoteElement::write(librevenge::RVNGTextInterface *iface,
-                                          const std::map<int, std::list<ABWOutputElement *> > *,
-                                          const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::append(const ABWOutputElements &elements)
 {
-  if (iface)
-    iface->openEndnote(m_propList);
+  if (&elements == this)
+    return;
+  _flushPending();
+  if (elements.m_spill)
+  {
+    for (std::size_t i = 0; i < elements.m_spill->m_segments.size(); ++i)
+    {
+      ABWOutputElements segment;
+      if (!elements.m_spill->read(i, segment))
+        throw SpillReadingFailed();
+      _appendElements(m_bodyElements, segment, segment.m_bodyElements);
+    }
+  }
+  _appendElements(m_bodyElements, elements, elements.m_bodyElements);
+  for (std::map<int, Elements_t>::const_iterator iter = elements.m_headerElements.begin(); iter != elements.m_headerElements.end(); ++iter)
+    _appendElements(m_headerElements[iter->first], elements, iter->second);
+  for (std::map<int, Elements_t>::const_iterator iter = elements.m_footerElements.begin(); iter != elements.m_footerElements.end(); ++iter)
+    _appendElements(m_footerElements[iter->first], elements, iter->second);
 }
 
-void libabw::ABWOpenFooterElement::write(librevenge::RVNGTextInterface *iface,
-                                         const std::map<int, std::list<ABWOutputElement *> > *,
-                                         const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_appendElements(Elements_t &target, const ABWOutputElements &source, const Elements_t &elements)
 {
-  if (iface)
-    iface->openFooter(m_propList);
+  // with a memory limit, the target may be spilled on the way
+  if (!m_memoryLimit)
+    target.reserve(target.size() + elements.size());
+  for (Elements_t::const_iterator iter = elements.begin(); iter != elements.end(); ++iter)
+  {
+    Element element = *iter;
+    switch (element.m_type)
+    {
+    case ABW_INSERT_BINARY_OBJECT:
+      m_binaryObjects.push_back(source.m_binaryObjects[element.m_index]);
+      element.m_index = m_binaryObjects.size() - 1;
+      if (m_memoryLimit)
+        m_memorySize += getMemorySize(m_binaryObjects.back());
+      break;
+    case ABW_INSERT_TEXT:
+    {
+      const char *const text = &source.m_text[element.m_index];
+      element.m_index = m_text.size();
+      m_text.append(text);
+      m_text.push_back('\0');
+      m_memorySize += (unsigned long)(m_text.size() - element.m_index);
+      break;
+    }
+    case ABW_OPEN_PAGE_SPAN:
+    {
+      PageSpan pageSpan = source.m_pageSpans[element.m_index];
+      pageSpan.m_propList = &_share(*pageSpan.m_propList);
+      m_pageSpans.push_back(pageSpan);
+      element.m_index = m_pageSpans.size() - 1;
+      m_memorySize += sizeof(PageSpan);
+      break;
+    }
+    default:
+      // the property lists of the source are only valid as long as the source exists
+      if (_hasPropList(element.m_type))
+        element.m_propList = &_share(*element.m_propList);
+      break;
+    }
+    target.push_back(element);
+    m_memorySize += sizeof(Element);
+    if (&target == &m_bodyElements)
+      _checkMemoryLimit();
+  }
 }
 
-void libabw::ABWOpenFootnoteElement::write(librevenge::RVNGTextInterface *iface,
-                                           const std::map<int, std::list<ABWOutputElement *> > *,
-                                           const std::map<int, std::list<ABWOutputElement *> > *) const
+bool libabw::ABWOutputElements::_hasPropList(const ElementType type)
 {
-  if (iface)
-    iface->openFootnote(m_propList);
+  switch (type)
+  {
+  case ABW_INSERT_COVERED_TABLE_CELL:
+  case ABW_OPEN_ENDNOTE:
+  case ABW_OPEN_FOOTER:
+  case ABW_OPEN_FOOTNOTE:
+  case ABW_OPEN_FRAME:
+  case ABW_OPEN_HEADER:
+  case ABW_OPEN_LINK:
+  case ABW_OPEN_LIST_ELEMENT:
+  case ABW_OPEN_ORDERED_LIST_LEVEL:
+  case ABW_OPEN_PARAGRAPH:
+  case ABW_OPEN_SECTION:
+  case ABW_OPEN_SPAN:
+  case ABW_OPEN_TABLE:
+  case ABW_OPEN_TABLE_CELL:
+  case ABW_OPEN_TABLE_ROW:
+  case ABW_OPEN_UNORDERED_LIST_LEVEL:
+  case ABW_SET_DOCUMENT_META_DATA:
+  case ABW_START_DOCUMENT:
+    return true;
+  default:
+    return false;
+  }
 }
 
-void libabw::ABWOpenFrameElement::write(librevenge::RVNGTextInterface *iface,
-                                        const std::map<int, std::list<ABWOutputElement *> > *,
-                                        const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::serialize(std::string &data) const
 {
-  if (iface)
-    iface->openFrame(m_propList);
-}
+  // shared property lists are stored once and referred to by their index
+  std::map<const librevenge::RVNGPropertyList *, unsigned long> propListIds;
+  writeNumber(data, (unsigned long)m_propLists.size());
+  for (boost::unordered_map<std::string, librevenge::RVNGPropertyList>::const_iterator iter = m_propLists.begin(); iter != m_propLists.end(); ++iter)
+  {
+    const unsigned long id = (unsigned long)propListIds.size();
+    propListIds[&iter->second] = id;
+    writePropertyList(data, iter->second);
+  }
 
-void libabw::ABWOpenHeaderElement::write(librevenge::RVNGTextInterface *iface,
-                                         const std::map<int, std::list<ABWOutputElement *> > *,
-                                         const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openHeader(m_propList);
-}
+  writeNumber(data, (unsigned long)m_text.size());
+  data.append(m_text);
 
-void libabw::ABWOpenListElementElement::write(librevenge::RVNGTextInterface *iface,
-                                              const std::map<int, std::list<ABWOutputElement *> > *,
-                                              const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openListElement(m_propList);
-}
+  writeNumber(data, (unsigned long)m_binaryObjects.size());
+  for (std::deque<librevenge::RVNGPropertyList>::const_iterator iter = m_binaryObjects.begin(); iter != m_binaryObjects.end(); ++iter)
+    writePropertyList(data, *iter);
 
-void libabw::ABWOpenLinkElement::write(librevenge::RVNGTextInterface *iface,
-                                       const std::map<int, std::list<ABWOutputElement *> > *,
-                                       const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openLink(m_propList);
-}
+  writeNumber(data, (unsigned long)m_pageSpans.size());
+  for (std::vector<PageSpan>::const_iterator iter = m_pageSpans.begin(); iter != m_pageSpans.end(); ++iter)
+  {
+    const std::map<const librevenge::RVNGPropertyList *, unsigned long>::const_iterator id = propListIds.find(iter->m_propList);
+    writeNumber(data, id != propListIds.end() ? id->second : (unsigned long)propListIds.size());
+    for (int i = 0; i < 4; ++i)
+    {
+      writeSignedNumber(data, iter->m_footers[i]);
+      writeSignedNumber(data, iter->m_headers[i]);
+    }
+  }
 
-void libabw::ABWOpenOrderedListLevelElement::write(librevenge::RVNGTextInterface *iface,
-                                                   const std::map<int, std::list<ABWOutputElement *> > *,
-                                                   const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openOrderedListLevel(m_propList);
+  // the body, then the headers and the footers with their ids
+  writeNumber(data, (unsigned long)(1 + m_headerElements.size() + m_footerElements.size()));
+  data.push_back(0);
+  _serialize(data, m_bodyElements, propListIds);
+  for (std::map<int, Elements_t>::const_iterator iter = m_headerElements.begin(); iter != m_headerElements.end(); ++iter)
+  {
+    data.push_back(1);
+    writeSignedNumber(data, iter->first);
+    _serialize(data, iter->second, propListIds);
+  }
+  for (std::map<int, Elements_t>::const_iterator iter = m_footerElements.begin(); iter != m_footerElements.end(); ++iter)
+  {
+    data.push_back(2);
+    writeSignedNumber(data, iter->first);
+    _serialize(data, iter->second, propListIds);
+  }
 }
 
-void libabw::ABWOpenPageSpanElement::write(librevenge::RVNGTextInterface *iface,
-                                           const std::map<int, std::list<ABWOutputElement *> > *footers,
-                                           const std::map<int, std::list<ABWOutputElement *> > *headers) const
+void libabw::ABWOutputElements::_serialize(std::string &data, const Elements_t &elements,
+                                           const std::map<const librevenge::RVNGPropertyList *, unsigned long> &propListIds) const
 {
-  if (iface)
+  writeNumber(data, (unsigned long)elements.size());
+  for (Elements_t::const_iterator iter = elements.begin(); iter != elements.end(); ++iter)
   {
-    // open the page span
-    iface->openPageSpan(m_propList);
-    // write out the footers
-    _writeElements(iface, m_footer, footers);
-    _writeElements(iface, m_footerLeft, footers);
-    _writeElements(iface, m_footerFirst, footers);
-    _writeElements(iface, m_footerLast, footers);
-    // write out the headers
-    _writeElements(iface, m_header, headers);
-    _writeElements(iface, m_headerLeft, headers);
-    _writeElements(iface, m_headerFirst, headers);
-    _writeElements(iface, m_headerLast, headers);
-    // and continue with writing out the other stuff
+    data.push_back(char(iter->m_type));
+    if (_hasPropList(iter->m_type))
+    {
+      // an unknown list gets an invalid index, so the data are not read back
+      const std::map<const librevenge::RVNGPropertyList *, unsigned long>::const_iterator id = propListIds.find(iter->m_propList);
+      writeNumber(data, id != propListIds.end() ? id->second : (unsigned long)propListIds.size());
+    }
+    else if (ABW_INSERT_BINARY_OBJECT == iter->m_type || ABW_INSERT_TEXT == iter->m_type || ABW_OPEN_PAGE_SPAN == iter->m_type)
+      writeNumber(data, (unsigned long)iter->m_index);
   }
-
 }
 
-void libabw::ABWOpenPageSpanElement::_writeElements(librevenge::RVNGTextInterface *iface, int id,
-                                                    const std::map<int, std::list<ABWOutputElement *> > *elements) const
+bool libabw::ABWOutputElements::deserialize(const unsigned char *const data, const std::size_t length)
 {
-  if (!elements || id < 0 || !iface)
-    return;
+  BinaryReader reader(data, length);
 
-  std::map<int, std::list<ABWOutputElement *> >::const_iterator iterMap = elements->find(id);
-  if (iterMap == elements->end() || iterMap->second.empty())
-    return;
+  std::vector<const librevenge::RVNGPropertyList *> propLists;
+  for (unsigned long count = reader.readNumber(); count > 0 && !reader.isFailed(); --count)
+  {
+    librevenge::RVNGPropertyList propList;
+    if (reader.readPropertyList(propList))
+      propLists.push_back(&_share(propList));
+  }
 
-  for (std::list<ABWOutputElement *>::const_iterator iterVec = iterMap->second.begin();
-       iterVec != iterMap->second.end(); ++iterVec)
-    (*iterVec)->write(iface, 0, 0);
-}
+  reader.readString(m_text);
+  // every text ends with a NUL
+  if (!m_text.empty() && m_text[m_text.size() - 1])
+    return false;
 
-void libabw::ABWOpenParagraphElement::write(librevenge::RVNGTextInterface *iface,
-                                            const std::map<int, std::list<ABWOutputElement *> > *,
-                                            const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openParagraph(m_propList);
-}
+  for (unsigned long count = reader.readNumber(); count > 0 && !reader.isFailed(); --count)
+  {
+    m_binaryObjects.push_back(librevenge::RVNGPropertyList());
+    reader.readPropertyList(m_binaryObjects.back());
+  }
 
-void libabw::ABWOpenSectionElement::write(librevenge::RVNGTextInterface *iface,
-                                          const std::map<int, std::list<ABWOutputElement *> > *,
-                                          const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openSection(m_propList);
-}
+  for (unsigned long count = reader.readNumber(); count > 0 && !reader.isFailed(); --count)
+  {
+    PageSpan pageSpan;
+    const unsigned long id = reader.readNumber();
+    if (id >= propLists.size())
+      return false;
+    pageSpan.m_propList = propLists[id];
+    for (int i = 0; i < 4; ++i)
+    {
+      pageSpan.m_footers[i] = int(reader.readSignedNumber());
+      pageSpan.m_headers[i] = int(reader.readSignedNumber());
+    }
+    m_pageSpans.push_back(pageSpan);
+  }
 
-void libabw::ABWOpenSpanElement::write(librevenge::RVNGTextInterface *iface,
-                                       const std::map<int, std::list<ABWOutputElement *> > *,
-                                       const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openSpan(m_propList);
-}
+  for (unsigned long count = reader.readNumber(); count > 0 && !reader.isFailed(); --count)
+  {
+    const unsigned char kind = reader.readByte();
+    Elements_t *elements = &m_bodyElements;
+    if (kind == 1)
+      elements = &m_headerElements[int(reader.readSignedNumber())];
+    else if (kind == 2)
+      elements = &m_footerElements[int(reader.readSignedNumber())];
+    else if (kind != 0)
+      return false;
+    for (unsigned long elementCount = reader.readNumber(); elementCount > 0 && !reader.isFailed(); --elementCount)
+    {
+      const unsigned char type = reader.readByte();
+      if (type > ABW_START_DOCUMENT)
+        return false;
+      Element element;
+      element.m_type = ElementType(type);
+      element.m_index = 0;
+      if (_hasPropList(element.m_type))
+      {
+        const unsigned long id = reader.readNumber();
+        if (id >= propLists.size())
+          return false;
+        element.m_propList = propLists[id];
+      }
+      else if (ABW_INSERT_BINARY_OBJECT == element.m_type || ABW_INSERT_TEXT == element.m_type || ABW_OPEN_PAGE_SPAN == element.m_type)
+      {
+        element.m_index = reader.readNumber();
+        const std::size_t limit = ABW_INSERT_BINARY_OBJECT == element.m_type ? m_binaryObjects.size()
+                                  : ABW_INSERT_TEXT == element.m_type ? m_text.size() : m_pageSpans.size();
+        if (element.m_index >= limit)
+          return false;
+      }
+      elements->push_back(element);
+    }
+  }
 
-void libabw::ABWOpenTableElement::write(librevenge::RVNGTextInterface *iface,
-                                        const std::map<int, std::list<ABWOutputElement *> > *,
-                                        const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openTable(m_propList);
+  return !reader.isFailed() && reader.isEnd();
 }
 
-void libabw::ABWOpenTableCellElement::write(librevenge::RVNGTextInterface *iface,
-                                            const std::map<int, std::list<ABWOutputElement *> > *,
-                                            const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::write(librevenge::RVNGTextInterface *iface) const
 {
-  if (iface)
-    iface->openTableCell(m_propList);
+  if (!iface)
+    return;
+  if (m_spill)
+  {
+    for (std::size_t i = 0; i < m_spill->m_segments.size(); ++i)
+    {
+      ABWOutputElements segment;
+      if (!m_spill->read(i, segment))
+      {
+        ABW_DEBUG_MSG(("ABWOutputElements::write: spilled events could not be read back\n"));
+        throw SpillReadingFailed();
+      }
+      segment.m_headersAndFooters = m_headersAndFooters ? m_headersAndFooters : this;
+      segment._write(iface, segment.m_bodyElements, true);
+    }
+  }
+  _write(iface, m_bodyElements, true);
 }
 
-void libabw::ABWOpenTableRowElement::write(librevenge::RVNGTextInterface *iface,
-                                           const std::map<int, std::list<ABWOutputElement *> > *,
-                                           const std::map<int, std::list<ABWOutputElement *> > *) const
+void libabw::ABWOutputElements::_write(librevenge::RVNGTextInterface *iface, const std::map<int, Elements_t> &elements, const int id) const
 {
-  if (iface)
-    iface->openTableRow(m_propList);
-}
+  if (id < 0)
+    return;
 
-void libabw::ABWOpenUnorderedListLevelElement::write(librevenge::RVNGTextInterface *iface,
-                                                     const std::map<int, std::list<ABWOutputElement *> > *,
-                                                     const std::map<int, std::list<ABWOutputElement *> > *) const
-{
-  if (iface)
-    iface->openUnorderedListLevel(m_propList);
+  std::map<int, Elements_t>::const_iterator iterMap = elements.find(id);
+  if (iterMap != elements.end())
+    _write(iface, iterMap->second, false);
 }
 
-// ABWOutputElements
-
-libabw::ABWOutputElements::ABWOutputElements()
-  : m_bodyElements(), m_headerElements(), m_footerElements(), m_elements(0)
+void libabw::ABWOutputElements::_write(librevenge::RVNGTextInterface *iface, const Elements_t &elements, const bool isBody) const
 {
-  m_elements = &m_bodyElements;
+  for (Elements_t::const_iterator iter = elements.begin(); iter != elements.end(); ++iter)
+    _write(iface, *iter, isBody);
 }
 
-libabw::ABWOutputElements::~ABWOutputElements()
+void libabw::ABWOutputElements::_write(librevenge::RVNGTextInterface *iface, const PageSpan &pageSpan, const bool isBody) const
 {
-  m_elements = 0;
-  std::list<ABWOutputElement *>::iterator iterVec;
-  for (iterVec = m_bodyElements.begin(); iterVec != m_bodyElements.end(); ++iterVec)
-    delete(*iterVec);
-  std::map<int, std::list<ABWOutputElement *> >::iterator iterMap;
-  for (iterMap = m_headerElements.begin(); iterMap != m_headerElements.end(); ++iterMap)
+  iface->openPageSpan(*pageSpan.m_propList);
+  // headers and footers are only written out for page spans of the body
+  if (isBody)
   {
-    for (iterVec = iterMap->second.begin(); iterVec != iterMap->second.end(); ++iterVec)
-      delete(*iterVec);
-  }
-  for (iterMap = m_footerElements.begin(); iterMap != m_footerElements.end(); ++iterMap)
-  {
-    for (iterVec = iterMap->second.begin(); iterVec != iterMap->second.end(); ++iterVec)
-      delete(*iterVec);
+    const ABWOutputElements &source = m_headersAndFooters ? *m_headersAndFooters : *this;
+    for (int i = 0; i < 4; ++i)
+      source._write(iface, source.m_footerElements, pageSpan.m_footers[i]);
+    for (int i = 0; i < 4; ++i)
+      source._write(iface, source.m_headerElements, pageSpan.m_headers[i]);
   }
 }
 
-void libabw::ABWOutputElements::write(librevenge::RVNGTextInterface *iface) const
+void libabw::ABWOutputElements::_write(librevenge::RVNGTextInterface *iface, const Element &element, const bool isBody) const
 {
-  std::list<ABWOutputElement *>::const_iterator iter;
-  for (iter = m_bodyElements.begin(); iter != m_bodyElements.end(); ++iter)
-    (*iter)->write(iface, &m_footerElements, &m_headerElements);
+  switch (element.m_type)
+  {
+  case ABW_CLOSE_ENDNOTE:
+    iface->closeEndnote();
+    break;
+  case ABW_CLOSE_FOOTER:
+    iface->closeFooter();
+    break;
+  case ABW_CLOSE_FOOTNOTE:
+    iface->closeFootnote();
+    break;
+  case ABW_CLOSE_FRAME:
+    iface->closeFrame();
+    break;
+  case ABW_CLOSE_HEADER:
+    iface->closeHeader();
+    break;
+  case ABW_CLOSE_LINK:
+    iface->closeLink();
+    break;
+  case ABW_CLOSE_LIST_ELEMENT:
+    iface->closeListElement();
+    break;
+  case ABW_CLOSE_ORDERED_LIST_LEVEL:
+    iface->closeOrderedListLevel();
+    break;
+  case ABW_CLOSE_PAGE_SPAN:
+    iface->closePageSpan();
+    break;
+  case ABW_CLOSE_PARAGRAPH:
+    iface->closeParagraph();
+    break;
+  case ABW_CLOSE_SECTION:
+    iface->closeSection();
+    break;
+  case ABW_CLOSE_SPAN:
+    iface->closeSpan();
+    break;
+  case ABW_CLOSE_TABLE:
+    iface->closeTable();
+    break;
+  case ABW_CLOSE_TABLE_CELL:
+    iface->closeTableCell();
+    break;
+  case ABW_CLOSE_TABLE_ROW:
+    iface->closeTableRow();
+    break;
+  case ABW_CLOSE_UNORDERED_LIST_LEVEL:
+    iface->closeUnorderedListLevel();
+    break;
+  case ABW_END_DOCUMENT:
+    iface->endDocument();
+    break;
+  case ABW_INSERT_BINARY_OBJECT:
+    iface->insertBinaryObject(m_binaryObjects[element.m_index]);
+    break;
+  case ABW_INSERT_COVERED_TABLE_CELL:
+    iface->insertCoveredTableCell(*element.m_propList);
+    break;
+  case ABW_INSERT_LINE_BREAK:
+    iface->insertLineBreak();
+    break;
+  case ABW_INSERT_SPACE:
+    iface->insertSpace();
+    break;
+  case ABW_INSERT_TAB:
+    iface->insertTab();
+    break;
+  case ABW_INSERT_TEXT:
+    iface->insertText(librevenge::RVNGString(m_text.c_str() + element.m_index));
+    break;
+  case ABW_OPEN_ENDNOTE:
+    iface->openEndnote(*element.m_propList);
+    break;
+  case ABW_OPEN_FOOTER:
+    iface->openFooter(*element.m_propList);
+    break;
+  case ABW_OPEN_FOOTNOTE:
+    iface->openFootnote(*element.m_propList);
+    break;
+  case ABW_OPEN_FRAME:
+    iface->openFrame(*element.m_propList);
+    break;
+  case ABW_OPEN_HEADER:
+    iface->openHeader(*element.m_propList);
+    break;
+  case ABW_OPEN_LINK:
+    iface->openLink(*element.m_propList);
+    break;
+  case ABW_OPEN_LIST_ELEMENT:
+    iface->openListElement(*element.m_propList);
+    break;
+  case ABW_OPEN_ORDERED_LIST_LEVEL:
+    iface->openOrderedListLevel(*element.m_propList);
+    break;
+  case ABW_OPEN_PAGE_SPAN:
+    _write(iface, m_pageSpans[element.m_index], isBody);
+    break;
+  case ABW_OPEN_PARAGRAPH:
+    iface->openParagraph(*element.m_propList);
+    break;
+  case ABW_OPEN_SECTION:
+    iface->openSection(*element.m_propList);
+    break;
+  case ABW_OPEN_SPAN:
+    iface->openSpan(*element.m_propList);
+    break;
+  case ABW_OPEN_TABLE:
+    iface->openTable(*element.m_propList);
+    break;
+  case ABW_OPEN_TABLE_CELL:
+    iface->openTableCell(*element.m_propList);
+    break;
+  case ABW_OPEN_TABLE_ROW:
+    iface->openTableRow(*element.m_propList);
+    break;
+  case ABW_OPEN_UNORDERED_LIST_LEVEL:
+    iface->openUnorderedListLevel(*element.m_propList);
+    break;
+  case ABW_SET_DOCUMENT_META_DATA:
+    iface->setDocumentMetaData(*element.m_propList);
+    break;
+  case ABW_START_DOCUMENT:
+    iface->startDocument(*element.m_propList);
+    break;
+  default:
+    ABW_DEBUG_MSG(("ABWOutputElements::_write: unknown element type %d\n", int(element.m_type)));
+    break;
+  }
 }
 
 void libabw::ABWOutputElements::addCloseEndnote()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseEndnoteElement());
+  _add(ABW_CLOSE_ENDNOTE);
 }
 
 void libabw::ABWOutputElements::addCloseFooter()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseFooterElement());
+  _add(ABW_CLOSE_FOOTER);
   m_elements = &m_bodyElements;
 }
 
 void libabw::ABWOutputElements::addCloseFootnote()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseFootnoteElement());
+  _add(ABW_CLOSE_FOOTNOTE);
 }
 
 void libabw::ABWOutputElements::addCloseFrame()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseFrameElement());
+  _add(ABW_CLOSE_FRAME);
 }
 
 void libabw::ABWOutputElements::addCloseHeader()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseHeaderElement());
+  _add(ABW_CLOSE_HEADER);
   m_elements = &m_bodyElements;
 }
 
 void libabw::ABWOutputElements::addCloseLink()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseLinkElement());
+  _add(ABW_CLOSE_LINK);
 }
 
 void libabw::ABWOutputElements::addCloseListElement()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseListElementElement());
+  _add(ABW_CLOSE_LIST_ELEMENT);
 }
 
 void libabw::ABWOutputElements::addCloseOrderedListLevel()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseOrderedListLevelElement());
+  _add(ABW_CLOSE_ORDERED_LIST_LEVEL);
 }
 
 void libabw::ABWOutputElements::addClosePageSpan()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWClosePageSpanElement());
+  _add(ABW_CLOSE_PAGE_SPAN);
 }
 
 void libabw::ABWOutputElements::addCloseParagraph()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseParagraphElement());
+  _add(ABW_CLOSE_PARAGRAPH);
 }
 
 void libabw::ABWOutputElements::addCloseSection()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseSectionElement());
+  _add(ABW_CLOSE_SECTION);
 }
 
 void libabw::ABWOutputElements::addCloseSpan()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseSpanElement());
+  if (!m_compactEvents)
+    _add(ABW_CLOSE_SPAN);
+  else if (m_elements)
+  {
+    if (m_isSpanOpenPending)
+    {
+      // the span is empty
+      m_isSpanOpenPending = false;
+      return;
+    }
+    if (m_isSpanClosePending)
+      _flushPending();
+    m_isSpanClosePending = true;
+  }
 }
 
 void libabw::ABWOutputElements::addCloseTable()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseTableElement());
+  _add(ABW_CLOSE_TABLE);
 }
 
 void libabw::ABWOutputElements::addCloseTableCell()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseTableCellElement());
+  _add(ABW_CLOSE_TABLE_CELL);
 }
 
 void libabw::ABWOutputElements::addCloseTableRow()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseTableRowElement());
+  _add(ABW_CLOSE_TABLE_ROW);
 }
 
 void libabw::ABWOutputElements::addCloseUnorderedListLevel()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWCloseUnorderedListLevelElement());
+  _add(ABW_CLOSE_UNORDERED_LIST_LEVEL);
+}
+
+void libabw::ABWOutputElements::addEndDocument()
+{
+  _add(ABW_END_DOCUMENT);
 }
 
 void libabw::ABWOutputElements::addInsertBinaryObject(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWInsertBinaryObjectElement(propList));
+  _flushPending();
+  // binary objects are nearly always unique, so they are not shared
+  if (_isStreaming() && m_pipe)
+  {
+    m_pipe->getBatch().addInsertBinaryObject(propList);
+    m_pipe->checkBatch();
+  }
+  else if (_isStreaming())
+    m_streamingIface->insertBinaryObject(propList);
+  else if (m_elements)
+  {
+    m_binaryObjects.push_back(propList);
+    if (m_memoryLimit)
+      m_memorySize += getMemorySize(propList);
+    _add(ABW_INSERT_BINARY_OBJECT, m_binaryObjects.size() - 1);
+  }
 }
 
 void libabw::ABWOutputElements::addInsertCoveredTableCell(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWInsertCoveredTableCellElement(propList));
+  _add(ABW_INSERT_COVERED_TABLE_CELL, propList);
 }
 
 void libabw::ABWOutputElements::addInsertLineBreak()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWInsertLineBreakElement());
+  _add(ABW_INSERT_LINE_BREAK);
 }
 
 void libabw::ABWOutputElements::addInsertSpace()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWInsertSpaceElement());
+  _add(ABW_INSERT_SPACE);
 }
 
 void libabw::ABWOutputElements::addInsertTab()
 {
-  if (m_elements)
-    m_elements->push_back(new ABWInsertTabElement());
+  _add(ABW_INSERT_TAB);
 }
 
 void libabw::ABWOutputElements::addInsertText(const librevenge::RVNGString &text)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWInsertTextElement(text));
+  if (!m_compactEvents)
+  {
+    _appendText(text.cstr(), text.size());
+    return;
+  }
+  if (!m_elements || text.empty())
+    return;
+  if (m_isSpanOpenPending || m_isSpanClosePending)
+    _flushPending();
+  m_pendingText.append(text.cstr(), text.size());
 }
 
 void libabw::ABWOutputElements::addOpenEndnote(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenEndnoteElement(propList));
+  _add(ABW_OPEN_ENDNOTE, propList);
 }
 
 void libabw::ABWOutputElements::addOpenFooter(const librevenge::RVNGPropertyList &propList, int id)
@@ -1083,99 +1413,152 @@ void libabw::ABWOutputElements::addOpenFooter(const librevenge::RVNGPropertyList
   // if the corresponding element of the map does not exist, this will default-construct it.
   // In that case we will get an empty list to fill with the footer content. If the element
   // already exists, this might be a footer with different occurrence and we will add it to
-  // the existing one.
-  m_elements = &m_footerElements[id];
-  if (m_elements)
-    m_elements->push_back(new ABWOpenFooterElement(propList));
+  // the existing one. When streaming with headers and footers collected
+  // elsewhere, the footer content is dropped.
+  _flushPending();
+  m_elements = m_streamingIface && m_headersAndFooters ? 0 : &m_footerElements[id];
+  _add(ABW_OPEN_FOOTER, propList);
 }
 
 void libabw::ABWOutputElements::addOpenFootnote(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenFootnoteElement(propList));
+  _add(ABW_OPEN_FOOTNOTE, propList);
 }
 
 void libabw::ABWOutputElements::addOpenFrame(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenFrameElement(propList));
+  _add(ABW_OPEN_FRAME, propList);
 }
 
 void libabw::ABWOutputElements::addOpenHeader(const librevenge::RVNGPropertyList &propList, int id)
 {
   // Check the comment in addOpenFooter to see what happens here
-  m_elements = &m_headerElements[id];
-  if (m_elements)
-    m_elements->push_back(new ABWOpenHeaderElement(propList));
+  _flushPending();
+  m_elements = m_streamingIface && m_headersAndFooters ? 0 : &m_headerElements[id];
+  _add(ABW_OPEN_HEADER, propList);
 }
 
 void libabw::ABWOutputElements::addOpenListElement(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenListElementElement(propList));
+  _add(ABW_OPEN_LIST_ELEMENT, propList);
 }
 
 void libabw::ABWOutputElements::addOpenLink(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenLinkElement(propList));
+  _add(ABW_OPEN_LINK, propList);
 }
 
 void libabw::ABWOutputElements::addOpenOrderedListLevel(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenOrderedListLevelElement(propList));
+  _add(ABW_OPEN_ORDERED_LIST_LEVEL, propList);
 }
 
 void libabw::ABWOutputElements::addOpenPageSpan(const librevenge::RVNGPropertyList &propList,
                                                 int footer, int footerLeft, int footerFirst, int footerLast,
                                                 int header, int headerLeft, int headerFirst, int headerLast)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenPageSpanElement(propList, footer, footerLeft, footerFirst, footerLast,
-                                                     header, headerLeft, headerFirst, headerLast));
+  _flushPending();
+  if (!m_elements)
+    return;
+
+  const PageSpan pageSpan =
+  {
+    _isStreaming() ? &propList : &_share(propList),
+    { footer, footerLeft, footerFirst, footerLast },
+    { header, headerLeft, headerFirst, headerLast }
+  };
+  if (_isStreaming() && m_pipe)
+  {
+    m_pipe->getBatch().addOpenPageSpan(propList, footer, footerLeft, footerFirst, footerLast,
+                                       header, headerLeft, headerFirst, headerLast);
+    m_pipe->checkBatch();
+  }
+  else if (_isStreaming())
+  {
+    _write(m_streamingIface, pageSpan, true);
+  }
+  else
+  {
+    m_pageSpans.push_back(pageSpan);
+    m_memorySize += sizeof(PageSpan);
+    _add(ABW_OPEN_PAGE_SPAN, m_pageSpans.size() - 1);
+  }
 }
 
 void libabw::ABWOutputElements::addOpenParagraph(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenParagraphElement(propList));
+  _add(ABW_OPEN_PARAGRAPH, propList);
 }
 
 void libabw::ABWOutputElements::addOpenSection(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenSectionElement(propList));
+  _add(ABW_OPEN_SECTION, propList);
 }
 
 void libabw::ABWOutputElements::addOpenSpan(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenSpanElement(propList));
+  if (!m_compactEvents)
+    _add(ABW_OPEN_SPAN, propList);
+  else if (_isStreaming())
+  {
+    // Streamed events are not kept, so neither are their property
+    // lists; only the one of the last span is.
+    m_propListKey.clear();
+    appendPropertyList(m_propListKey, propList);
+    if (m_isSpanClosePending && m_propListKey == m_spanPropListKey)
+    {
+      m_isSpanClosePending = false;
+      return;
+    }
+    _flushPending();
+    m_spanPropListKey.swap(m_propListKey);
+    m_streamedSpanPropList = propList;
+    m_spanPropList = &m_streamedSpanPropList;
+    m_isSpanOpenPending = true;
+  }
+  else if (m_elements)
+  {
+    const librevenge::RVNGPropertyList *const shared = &_share(propList);
+    if (m_isSpanClosePending && shared == m_spanPropList)
+    {
+      // the previous span goes on
+      m_isSpanClosePending = false;
+      return;
+    }
+    _flushPending();
+    m_spanPropList = shared;
+    m_isSpanOpenPending = true;
+  }
 }
 
 void libabw::ABWOutputElements::addOpenTable(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenTableElement(propList));
+  _add(ABW_OPEN_TABLE, propList);
 }
 
 void libabw::ABWOutputElements::addOpenTableCell(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenTableCellElement(propList));
+  _add(ABW_OPEN_TABLE_CELL, propList);
 }
 
 void libabw::ABWOutputElements::addOpenTableRow(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenTableRowElement(propList));
+  _add(ABW_OPEN_TABLE_ROW, propList);
 }
 
 void libabw::ABWOutputElements::addOpenUnorderedListLevel(const librevenge::RVNGPropertyList &propList)
 {
-  if (m_elements)
-    m_elements->push_back(new ABWOpenUnorderedListLevelElement(propList));
+  _add(ABW_OPEN_UNORDERED_LIST_LEVEL, propList);
+}
+
+void libabw::ABWOutputElements::addSetDocumentMetaData(const librevenge::RVNGPropertyList &propList)
+{
+  _add(ABW_SET_DOCUMENT_META_DATA, propList);
+}
+
+void libabw::ABWOutputElements::addStartDocument(const librevenge::RVNGPropertyList &propList)
+{
+  _add(ABW_START_DOCUMENT, propList);
 }
 
 /* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -10,22 +10,67 @@
 #ifndef ABWOUTPUTELEMENTS_H
 #define ABWOUTPUTELEMENTS_H
 
-#include <list>
+#include <cstddef>
+#include <deque>
 #include <map>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <librevenge/librevenge.h>
 
 namespace libabw
 {
 
-class ABWOutputElement;
-
 class ABWOutputElements
 {
 public:
   ABWOutputElements();
   virtual ~ABWOutputElements();
+  /** Adds copies of the events of @c elements, which must not be
+      streaming, after the events collected so far. Header and footer
+      contents are added to those with the same ids.
+    */
   void append(const ABWOutputElements &elements);
   void write(librevenge::RVNGTextInterface *iface) const;
+
+  /** Appends a binary form of the collected events, which must not be
+      streaming or spilled, to @c data.
+    */
+  void serialize(std::string &data) const;
+
+  /** Adds the events of a binary form made by serialize to an empty
+      object. Returns false if @c data is not valid.
+    */
+  bool deserialize(const unsigned char *data, std::size_t length);
+
+  /** Writes body events to @c iface as they are added, instead of
+      buffering them. If @c headersAndFooters is set, header and footer
+      events are dropped and page spans take their headers and footers
+      from it instead. If @c pipelined is set, the events are passed in
+      batches to another thread, which writes them, so that @c iface
+      works at the same time as the parser. The end of the document
+      waits for it to finish.
+    */
+  void startStreaming(librevenge::RVNGTextInterface *iface, const ABWOutputElements *headersAndFooters,
+                      bool pipelined = false);
+
+  /** Leaves out redundant events: a span that is closed and reopened
+      with the same properties goes on, a span without text is dropped
+      and adjacent texts are joined. Spaces are kept as they are, as
+      they stand for consecutive spaces that text would collapse.
+    */
+  void setCompactEvents(bool compact);
+
+  /** Keeps about @c limit bytes of collected events in memory at most,
+      or all of them for 0. When they grow past it, the body events
+      collected so far are moved to a temporary file, from which write
+      reads them back. Header and footer contents stay in memory.
+    */
+  void setMemoryLimit(unsigned long limit);
+
+  /// Whether some of the body events are in a temporary file.
+  bool isSpilled() const;
   void addCloseEndnote();
   void addCloseFooter();
   void addCloseFootnote();
@@ -42,6 +87,7 @@ public:
   void addCloseTableCell();
   void addCloseTableRow();
   void addCloseUnorderedListLevel();
+  void addEndDocument();
   void addInsertBinaryObject(const librevenge::RVNGPropertyList &propList);
   void addInsertCoveredTableCell(const librevenge::RVNGPropertyList &propList);
   void addInsertLineBreak();
@@ -66,18 +112,142 @@ public:
   void addOpenTableCell(const librevenge::RVNGPropertyList &propList);
   void addOpenTableRow(const librevenge::RVNGPropertyList &propList);
   void addOpenUnorderedListLevel(const librevenge::RVNGPropertyList &propList);
+  void addSetDocumentMetaData(const librevenge::RVNGPropertyList &propList);
   void addStartDocument(const librevenge::RVNGPropertyList &propList);
   bool empty() const
   {
-    return m_bodyElements.empty();
+    return m_bodyElements.empty() && !isSpilled();
   }
 private:
+  enum ElementType
+  {
+    ABW_CLOSE_ENDNOTE,
+    ABW_CLOSE_FOOTER,
+    ABW_CLOSE_FOOTNOTE,
+    ABW_CLOSE_FRAME,
+    ABW_CLOSE_HEADER,
+    ABW_CLOSE_LINK,
+    ABW_CLOSE_LIST_ELEMENT,
+    ABW_CLOSE_ORDERED_LIST_LEVEL,
+    ABW_CLOSE_PAGE_SPAN,
+    ABW_CLOSE_PARAGRAPH,
+    ABW_CLOSE_SECTION,
+    ABW_CLOSE_SPAN,
+    ABW_CLOSE_TABLE,
+    ABW_CLOSE_TABLE_CELL,
+    ABW_CLOSE_TABLE_ROW,
+    ABW_CLOSE_UNORDERED_LIST_LEVEL,
+    ABW_END_DOCUMENT,
+    ABW_INSERT_BINARY_OBJECT,
+    ABW_INSERT_COVERED_TABLE_CELL,
+    ABW_INSERT_LINE_BREAK,
+    ABW_INSERT_SPACE,
+    ABW_INSERT_TAB,
+    ABW_INSERT_TEXT,
+    ABW_OPEN_ENDNOTE,
+    ABW_OPEN_FOOTER,
+    ABW_OPEN_FOOTNOTE,
+    ABW_OPEN_FRAME,
+    ABW_OPEN_HEADER,
+    ABW_OPEN_LINK,
+    ABW_OPEN_LIST_ELEMENT,
+    ABW_OPEN_ORDERED_LIST_LEVEL,
+    ABW_OPEN_PAGE_SPAN,
+    ABW_OPEN_PARAGRAPH,
+    ABW_OPEN_SECTION,
+    ABW_OPEN_SPAN,
+    ABW_OPEN_TABLE,
+    ABW_OPEN_TABLE_CELL,
+    ABW_OPEN_TABLE_ROW,
+    ABW_OPEN_UNORDERED_LIST_LEVEL,
+    ABW_SET_DOCUMENT_META_DATA,
+    ABW_START_DOCUMENT
+  };
+
+  /** One buffered event. What the payload holds depends on the type:
+      a pooled property list, an offset into the text buffer, or an
+      index of a binary object or a page span.
+    */
+  struct Element
+  {
+    ElementType m_type;
+    union
+    {
+      const librevenge::RVNGPropertyList *m_propList;
+      std::size_t m_index;
+    };
+  };
+
+  typedef std::vector<Element> Elements_t;
+
+  struct PageSpan
+  {
+    const librevenge::RVNGPropertyList *m_propList;
+    int m_footers[4];
+    int m_headers[4];
+  };
+
+  struct Pipe;
+  struct Spill;
+
   ABWOutputElements(const ABWOutputElements &);
   ABWOutputElements &operator=(const ABWOutputElements &);
-  std::list<ABWOutputElement *> m_bodyElements;
-  std::map<int, std::list<ABWOutputElement *> > m_headerElements;
-  std::map<int, std::list<ABWOutputElement *> > m_footerElements;
-  std::list<ABWOutputElement *> *m_elements;
+
+  bool _isStreaming() const;
+  void _stream(const Element &element);
+  void _add(ElementType type);
+  void _add(ElementType type, const librevenge::RVNGPropertyList &propList);
+  void _add(ElementType type, std::size_t index);
+  void _add(const Element &element);
+  void _append(const Element &element);
+  void _appendText(const char *text, std::size_t length);
+  void _appendElements(Elements_t &target, const ABWOutputElements &source, const Elements_t &elements);
+  static bool _hasPropList(ElementType type);
+  void _flushPending();
+  void _checkMemoryLimit();
+  void _spill();
+  unsigned long _getMemorySize() const;
+  void _serialize(std::string &data, const Elements_t &elements,
+                  const std::map<const librevenge::RVNGPropertyList *, unsigned long> &propListIds) const;
+  void _write(librevenge::RVNGTextInterface *iface, const Element &element, bool isBody) const;
+  void _write(librevenge::RVNGTextInterface *iface, const Elements_t &elements, bool isBody) const;
+  void _write(librevenge::RVNGTextInterface *iface, const PageSpan &pageSpan, bool isBody) const;
+  void _write(librevenge::RVNGTextInterface *iface, const std::map<int, Elements_t> &elements, int id) const;
+
+  /** Returns the shared copy of @c propList. Equal property lists are
+      only stored once per document, however many elements use them.
+    */
+  const librevenge::RVNGPropertyList &_share(const librevenge::RVNGPropertyList &propList);
+
+  Elements_t m_bodyElements;
+  std::map<int, Elements_t> m_headerElements;
+  std::map<int, Elements_t> m_footerElements;
+  Elements_t *m_elements;
+  // NUL-terminated texts of all insertText events
+  std::string m_text;
+  std::deque<librevenge::RVNGPropertyList> m_binaryObjects;
+  std::vector<PageSpan> m_pageSpans;
+  boost::unordered_map<std::string, librevenge::RVNGPropertyList> m_propLists;
+  std::string m_propListKey;
+  librevenge::RVNGTextInterface *m_streamingIface;
+  const ABWOutputElements *m_headersAndFooters;
+  // set if streamed events are written on another thread
+  boost::scoped_ptr<Pipe> m_pipe;
+  bool m_compactEvents;
+  // the shared property list of the last opened span
+  const librevenge::RVNGPropertyList *m_spanPropList;
+  // when streaming, the property list of the last opened span and its key
+  std::string m_spanPropListKey;
+  librevenge::RVNGPropertyList m_streamedSpanPropList;
+  bool m_isSpanOpenPending;
+  bool m_isSpanClosePending;
+  std::string m_pendingText;
+  unsigned long m_memoryLimit;
+  // estimated size of the collected events, and of those a spill keeps in memory
+  unsigned long m_memorySize;
+  unsigned long m_keptMemorySize;
+  boost::scoped_ptr<Spill> m_spill;
+  bool m_isSpillFailed;
 };
 
 
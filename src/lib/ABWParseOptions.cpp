@@ -0,0 +1,159 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <string>
+
+#include <libabw/ABWParseOptions.h>
+
+namespace libabw
+{
+
+struct ABWParseOptions::Impl
+{
+  Impl();
+  Impl(const Impl &other);
+  Impl &operator=(const Impl &other);
+
+  unsigned long m_memoryLimit;
+  bool m_compactEvents;
+  unsigned m_threadCount;
+  bool m_pipelinedInflate;
+  bool m_pipelinedOutput;
+  std::string m_cacheDirectory;
+  ABWFingerprint *m_fingerprint;
+};
+
+ABWParseOptions::Impl::Impl()
+  : m_memoryLimit(0)
+  , m_compactEvents(false)
+  , m_threadCount(1)
+  , m_pipelinedInflate(false)
+  , m_pipelinedOutput(false)
+  , m_cacheDirectory()
+  , m_fingerprint(0)
+{
+}
+
+ABWParseOptions::Impl::Impl(const Impl &other)
+  : m_memoryLimit(other.m_memoryLimit)
+  , m_compactEvents(other.m_compactEvents)
+  , m_threadCount(other.m_threadCount)
+  , m_pipelinedInflate(other.m_pipelinedInflate)
+  , m_pipelinedOutput(other.m_pipelinedOutput)
+  , m_cacheDirectory(other.m_cacheDirectory)
+  , m_fingerprint(other.m_fingerprint)
+{
+}
+
+ABWParseOptions::Impl &ABWParseOptions::Impl::operator=(const Impl &other)
+{
+  m_memoryLimit = other.m_memoryLimit;
+  m_compactEvents = other.m_compactEvents;
+  m_threadCount = other.m_threadCount;
+  m_pipelinedInflate = other.m_pipelinedInflate;
+  m_pipelinedOutput = other.m_pipelinedOutput;
+  m_cacheDirectory = other.m_cacheDirectory;
+  m_fingerprint = other.m_fingerprint;
+  return *this;
+}
+
+ABWParseOptions::ABWParseOptions()
+  : m_impl(new Impl())
+{
+}
+
+ABWParseOptions::ABWParseOptions(const ABWParseOptions &other)
+  : m_impl(new Impl(*other.m_impl))
+{
+}
+
+ABWParseOptions::~ABWParseOptions()
+{
+  delete m_impl;
+}
+
+ABWParseOptions &ABWParseOptions::operator=(const ABWParseOptions &other)
+{
+  *m_impl = *other.m_impl;
+  return *this;
+}
+
+void ABWParseOptions::setMemoryLimit(const unsigned long limit)
+{
+  m_impl->m_memoryLimit = limit;
+}
+
+unsigned long ABWParseOptions::getMemoryLimit() const
+{
+  return m_impl->m_memoryLimit;
+}
+
+void ABWParseOptions::setCompactEvents(const bool compact)
+{
+  m_impl->m_compactEvents = compact;
+}
+
+bool ABWParseOptions::getCompactEvents() const
+{
+  return m_impl->m_compactEvents;
+}
+
+void ABWParseOptions::setThreadCount(const unsigned count)
+{
+  m_impl->m_threadCount = count ? count : 1;
+}
+
+unsigned ABWParseOptions::getThreadCount() const
+{
+  return m_impl->m_threadCount;
+}
+
+void ABWParseOptions::setPipelinedInflate(const bool pipelined)
+{
+  m_impl->m_pipelinedInflate = pipelined;
+}
+
+bool ABWParseOptions::getPipelinedInflate() const
+{
+  return m_impl->m_pipelinedInflate;
+}
+
+void ABWParseOptions::setPipelinedOutput(const bool pipelined)
+{
+  m_impl->m_pipelinedOutput = pipelined;
+}
+
+bool ABWParseOptions::getPipelinedOutput() const
+{
+  return m_impl->m_pipelinedOutput;
+}
+
+void ABWParseOptions::setCacheDirectory(const char *const directory)
+{
+  m_impl->m_cacheDirectory = directory ? directory : "";
+}
+
+const char *ABWParseOptions::getCacheDirectory() const
+{
+  return m_impl->m_cacheDirectory.c_str();
+}
+
+void ABWParseOptions::setFingerprint(ABWFingerprint *const fingerprint)
+{
+  m_impl->m_fingerprint = fingerprint;
+}
+
+ABWFingerprint *ABWParseOptions::getFingerprint() const
+{
+  return m_impl->m_fingerprint;
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,268 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <libxml/parser.h>
+#include <libabw/libabw.h>
+#include "ABWThread.h"
+#include "libabw_internal.h"
+
+namespace libabw
+{
+
+namespace
+{
+
+/** Returns the current time in seconds, from some fixed point. The
+  * clock is monotonic, so the times given to callbacks do not jump when
+  * the system time is set.
+  */
+double getTime()
+{
+#if defined HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC
+  timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+    return double(now.tv_sec) + double(now.tv_nsec) / 1000000000.0;
+#endif
+  // without clock_gettime, e.g., on Windows, clock gives the wall time the process has run
+  return double(clock()) / CLOCKS_PER_SEC;
+}
+
+struct Job
+{
+  Job(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *textInterface,
+      const ABWParseOptions &options, ABWParseCallback *callback);
+  Job(const Job &other);
+
+  void run() const;
+
+  librevenge::RVNGInputStream *m_input;
+  librevenge::RVNGTextInterface *m_textInterface;
+  ABWParseOptions m_options;
+  ABWParseCallback *m_callback;
+  double m_queuedAt;
+
+private:
+  Job &operator=(const Job &);
+};
+
+Job::Job(librevenge::RVNGInputStream *const input, librevenge::RVNGTextInterface *const textInterface,
+         const ABWParseOptions &options, ABWParseCallback *const callback)
+  : m_input(input)
+  , m_textInterface(textInterface)
+  , m_options(options)
+  , m_callback(callback)
+  , m_queuedAt(getTime())
+{
+}
+
+Job::Job(const Job &other)
+  : m_input(other.m_input)
+  , m_textInterface(other.m_textInterface)
+  , m_options(other.m_options)
+  , m_callback(other.m_callback)
+  , m_queuedAt(other.m_queuedAt)
+{
+}
+
+void Job::run() const
+{
+  const double startedAt = getTime();
+  const bool result = AbiDocument::parse(m_input, m_textInterface, m_options);
+  const double endedAt = getTime();
+  if (m_callback)
+  {
+    try
+    {
+      m_callback->parsed(result, startedAt - m_queuedAt, endedAt - startedAt);
+    }
+    catch (...)
+    {
+      ABW_DEBUG_MSG(("Job::run: the callback has thrown an exception\n"));
+    }
+  }
+}
+
+} // anonymous namespace
+
+struct ABWParsePool::Impl
+{
+  Impl(unsigned threadCount, unsigned queueLength);
+
+  bool queue(const Job &job);
+  void work();
+
+  class Worker : public ABWTask
+  {
+  public:
+    explicit Worker(Impl &impl)
+      : m_impl(impl)
+    {
+    }
+
+    void run()
+    {
+      m_impl.work();
+    }
+
+  private:
+    Worker(const Worker &);
+    Worker &operator=(const Worker &);
+
+    Impl &m_impl;
+  };
+
+  const unsigned m_queueLength;
+  ABWMutex m_mutex;
+  // signalled when a job is queued or the pool is closed
+  ABWCondition m_jobQueued;
+  // signalled when a job has ended
+  ABWCondition m_jobEnded;
+  std::deque<Job> m_jobs;
+  unsigned m_idleWorkers;
+  unsigned m_runningJobs;
+  bool m_isClosed;
+  std::vector<boost::shared_ptr<Worker> > m_workers;
+  std::vector<boost::shared_ptr<ABWThread> > m_threads;
+
+private:
+  Impl(const Impl &);
+  Impl &operator=(const Impl &);
+};
+
+ABWParsePool::Impl::Impl(const unsigned threadCount, const unsigned queueLength)
+  : m_queueLength(queueLength)
+  , m_mutex()
+  , m_jobQueued()
+  , m_jobEnded()
+  , m_jobs()
+  , m_idleWorkers(0)
+  , m_runningJobs(0)
+  , m_isClosed(false)
+  , m_workers()
+  , m_threads()
+{
+  if (!ABWThread::isSupported())
+    return;
+
+  // libxml has to set up its global state before it is used by more threads
+  xmlInitParser();
+  for (unsigned i = 0; i < std::max(threadCount, 1U); ++i)
+  {
+    const boost::shared_ptr<Worker> worker(new Worker(*this));
+    const boost::shared_ptr<ABWThread> thread(new ABWThread());
+    // a worker is idle from the start, even before it waits for a job
+    ++m_idleWorkers;
+    if (!thread->tryStart(*worker))
+    {
+      ABW_DEBUG_MSG(("ABWParsePool::Impl::Impl: could not create thread %u\n", i));
+      --m_idleWorkers;
+      break;
+    }
+    m_workers.push_back(worker);
+    m_threads.push_back(thread);
+  }
+}
+
+bool ABWParsePool::Impl::queue(const Job &job)
+{
+  ABWMutexLock lock(m_mutex);
+  // jobs taken by idle workers right away do not wait in the queue
+  if (m_jobs.size() >= std::size_t(m_idleWorkers) + m_queueLength)
+  {
+    ABW_DEBUG_MSG(("ABWParsePool::Impl::queue: the queue is full\n"));
+    return false;
+  }
+  m_jobs.push_back(job);
+  m_jobQueued.notifyAll();
+  return true;
+}
+
+void ABWParsePool::Impl::work()
+{
+  ABWMutexLock lock(m_mutex);
+  while (true)
+  {
+    while (m_jobs.empty() && !m_isClosed)
+      m_jobQueued.wait(m_mutex);
+    if (m_jobs.empty())
+      return;
+
+    const Job job = m_jobs.front();
+    m_jobs.pop_front();
+    --m_idleWorkers;
+    ++m_runningJobs;
+    m_mutex.unlock();
+    job.run();
+    m_mutex.lock();
+    --m_runningJobs;
+    ++m_idleWorkers;
+    m_jobEnded.notifyAll();
+  }
+}
+
+ABWParsePool::ABWParsePool(const unsigned threadCount, const unsigned queueLength)
+  : m_impl(new Impl(threadCount, queueLength))
+{
+}
+
+ABWParsePool::~ABWParsePool()
+{
+  {
+    ABWMutexLock lock(m_impl->m_mutex);
+    m_impl->m_isClosed = true;
+    m_impl->m_jobQueued.notifyAll();
+  }
+  // the workers end when the queue is empty
+  m_impl->m_threads.clear();
+  delete m_impl;
+}
+
+bool ABWParsePool::parse(librevenge::RVNGInputStream *const input, librevenge::RVNGTextInterface *const textInterface,
+                         ABWParseCallback *const callback)
+{
+  return parse(input, textInterface, ABWParseOptions(), callback);
+}
+
+bool ABWParsePool::parse(librevenge::RVNGInputStream *const input, librevenge::RVNGTextInterface *const textInterface,
+                         const ABWParseOptions &options, ABWParseCallback *const callback) try
+{
+  const Job job(input, textInterface, options, callback);
+  if (m_impl->m_threads.empty())
+  {
+    job.run();
+    return true;
+  }
+  return m_impl->queue(job);
+}
+catch (...)
+{
+  return false;
+}
+
+void ABWParsePool::wait()
+{
+  ABWMutexLock lock(m_impl->m_mutex);
+  while (!m_impl->m_jobs.empty() || m_impl->m_runningJobs)
+    m_impl->m_jobEnded.wait(m_impl->m_mutex);
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
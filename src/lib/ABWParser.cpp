@@ -7,18 +7,25 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include <ctype.h>
 #include <string.h>
 
+#include <algorithm>
 #include <set>
+#include <vector>
 
+#include <libxml/parser.h>
 #include <libxml/xmlIO.h>
 #include <libxml/xmlstring.h>
 #include <librevenge-stream/librevenge-stream.h>
-#include <boost/spirit/include/classic.hpp>
 #include <boost/algorithm/string.hpp>
 #include "ABWParser.h"
 #include "ABWContentCollector.h"
+#include "ABWDataStore.h"
+#include "ABWMemoryStream.h"
 #include "ABWStylesCollector.h"
+#include "ABWStylesScanner.h"
+#include "ABWThread.h"
 #include "libabw_internal.h"
 #include "ABWXMLHelper.h"
 #include "ABWXMLTokenMap.h"
@@ -41,32 +48,6 @@ static void clearListElements(std::map<int, ABWListElement *> &listElements)
   listElements.clear();
 }
 
-static bool findBool(const std::string &str, bool &res)
-{
-  using namespace ::boost::spirit::classic;
-
-  if (str.empty())
-    return false;
-
-  return parse(str.c_str(),
-               //  Begin grammar
-               (
-                 str_p("true")[assign_a(res,true)]
-                 |
-                 str_p("false")[assign_a(res,false)]
-                 |
-                 str_p("yes")[assign_a(res,true)]
-                 |
-                 str_p("no")[assign_a(res,false)]
-                 |
-                 str_p("TRUE")[assign_a(res,true)]
-                 |
-                 str_p("FALSE")[assign_a(res,false)]
-               ) >> end_p,
-               //  End grammar
-               space_p).full;
-}
-
 // small function needed to call the xml BAD_CAST on a char const *
 static xmlChar *call_BAD_CAST_OnConst(char const *str)
 {
@@ -114,26 +95,273 @@ static void updateListElementIds(std::map<int, ABWListElement *> &listElements)
   }
 }
 
+static bool isBodySection(xmlTextReaderPtr reader)
+{
+  xmlChar *const type = xmlTextReaderGetAttribute(reader, call_BAD_CAST_OnConst("type"));
+  const bool isBody = !type || (xmlStrncmp(type, call_BAD_CAST_OnConst("header"), 6) && xmlStrncmp(type, call_BAD_CAST_OnConst("footer"), 6));
+  if (type)
+    xmlFree(type);
+  return isBody;
+}
+
 } // anonymous namespace
 
+/** A run of sections, collected on its own. Sections are numbered by
+    the number of body sections before them, so a header or footer
+    section belongs to the body section after it.
+  */
+struct ABWSectionRange
+{
+  ABWSectionRange(std::size_t first, std::size_t end);
+  ABWSectionRange(const ABWSectionRange &other);
+  ABWSectionRange &operator=(const ABWSectionRange &other);
+
+  std::size_t m_first;
+  // one past the last section, or 0 to collect to the end
+  std::size_t m_end;
+  ABWContentCollector *m_collector;
+  // the id of the first table of each body section
+  const std::vector<int> *m_sectionTableIds;
+  // the state to start with, instead of guessing it
+  bool m_hasStartBoundary;
+  ABWSectionBoundary m_startBoundary;
+  // the state the first section has been collected with
+  ABWSectionBoundary m_assumedBoundary;
+  // the state the range has ended with, if it was cut
+  bool m_isCut;
+  ABWSectionBoundary m_finalBoundary;
+  bool m_isCollected;
+  boost::shared_ptr<const ABWOutputElements> m_elements;
+};
+
+ABWSectionRange::ABWSectionRange(const std::size_t first, const std::size_t end)
+  : m_first(first)
+  , m_end(end)
+  , m_collector(0)
+  , m_sectionTableIds(0)
+  , m_hasStartBoundary(false)
+  , m_startBoundary()
+  , m_assumedBoundary()
+  , m_isCut(false)
+  , m_finalBoundary()
+  , m_isCollected(false)
+  , m_elements()
+{
+}
+
+ABWSectionRange::ABWSectionRange(const ABWSectionRange &other)
+  : m_first(other.m_first)
+  , m_end(other.m_end)
+  , m_collector(other.m_collector)
+  , m_sectionTableIds(other.m_sectionTableIds)
+  , m_hasStartBoundary(other.m_hasStartBoundary)
+  , m_startBoundary(other.m_startBoundary)
+  , m_assumedBoundary(other.m_assumedBoundary)
+  , m_isCut(other.m_isCut)
+  , m_finalBoundary(other.m_finalBoundary)
+  , m_isCollected(other.m_isCollected)
+  , m_elements(other.m_elements)
+{
+}
+
+ABWSectionRange &ABWSectionRange::operator=(const ABWSectionRange &other)
+{
+  m_first = other.m_first;
+  m_end = other.m_end;
+  m_collector = other.m_collector;
+  m_sectionTableIds = other.m_sectionTableIds;
+  m_hasStartBoundary = other.m_hasStartBoundary;
+  m_startBoundary = other.m_startBoundary;
+  m_assumedBoundary = other.m_assumedBoundary;
+  m_isCut = other.m_isCut;
+  m_finalBoundary = other.m_finalBoundary;
+  m_isCollected = other.m_isCollected;
+  m_elements = other.m_elements;
+  return *this;
+}
+
+/** What the passes before the body collect, and the collectors of the
+    body pass.
+  */
+struct ABWDocumentParts
+{
+  ABWDocumentParts();
+  ~ABWDocumentParts();
+
+  std::map<int, int> m_tableSizes;
+  std::map<std::string, ABWData> m_data;
+  std::map<int, ABWListElement *> m_listElements;
+  std::vector<int> m_headerFooterTableIds;
+  std::vector<int> m_sectionTableIds;
+  ABWPropertyCache m_propertyCache;
+  boost::scoped_ptr<ABWContentCollector> m_headerFooterCollector;
+  boost::scoped_ptr<ABWContentCollector> m_contentCollector;
+
+private:
+  ABWDocumentParts(const ABWDocumentParts &);
+  ABWDocumentParts &operator=(const ABWDocumentParts &);
+};
+
+ABWDocumentParts::ABWDocumentParts()
+  : m_tableSizes()
+  , m_data()
+  , m_listElements()
+  , m_headerFooterTableIds()
+  , m_sectionTableIds()
+  , m_propertyCache()
+  , m_headerFooterCollector()
+  , m_contentCollector()
+{
+}
+
+ABWDocumentParts::~ABWDocumentParts()
+{
+  // the collectors may refer to the list elements
+  m_contentCollector.reset();
+  m_headerFooterCollector.reset();
+  clearListElements(m_listElements);
+}
+
 struct ABWParserState
 {
   ABWParserState();
+  ~ABWParserState();
 
   bool m_inMetadata;
   std::string m_currentMetadataKey;
+  bool m_skipBodySections;
+  // set if the text of the document is not used by the pass in progress
+  bool m_skipText;
+  // set if the embedded data are used by the pass in progress
+  bool m_collectData;
+  std::string m_text;
+  unsigned long m_mergedTextNodes;
+  // where the body sections start, if they are recorded
+  std::vector<unsigned long> *m_sectionOffsets;
+  ABWSectionRange *m_sectionRange;
+  std::size_t m_bodySections;
+  bool m_isInSectionRange;
+  // the reader of the pass in progress and the result of its last move
+  xmlTextReaderPtr m_reader;
+  int m_readerStatus;
+  // set if the last node has been skipped together with its children
+  bool m_isElementSkipped;
+  // the document being parsed node by node
+  boost::scoped_ptr<ABWDocumentParts> m_parts;
+
+private:
+  ABWParserState(const ABWParserState &);
+  ABWParserState &operator=(const ABWParserState &);
 };
 
 ABWParserState::ABWParserState()
   : m_inMetadata(false)
   , m_currentMetadataKey()
+  , m_skipBodySections(false)
+  , m_skipText(false)
+  , m_collectData(false)
+  , m_text()
+  , m_mergedTextNodes(0)
+  , m_sectionOffsets(0)
+  , m_sectionRange(0)
+  , m_bodySections(0)
+  , m_isInSectionRange(false)
+  , m_reader(0)
+  , m_readerStatus(0)
+  , m_isElementSkipped(false)
+  , m_parts()
+{
+}
+
+ABWParserState::~ABWParserState()
+{
+  if (m_reader)
+    xmlFreeTextReader(m_reader);
+}
+
+namespace
+{
+
+/** The parts of a document that all section ranges share. */
+struct SharedParts
+{
+  SharedParts(const std::vector<unsigned char> &document, const ABWParseOptions &options,
+              unsigned long memoryLimit, const std::map<int, int> &tableSizes,
+              const std::map<std::string, ABWData> &data, const std::map<int, ABWListElement *> &listElements);
+
+  const std::vector<unsigned char> &m_document;
+  const ABWParseOptions &m_options;
+  // the memory limit of the events of a range
+  const unsigned long m_memoryLimit;
+  const std::map<int, int> &m_tableSizes;
+  const std::map<std::string, ABWData> &m_data;
+  const std::map<int, ABWListElement *> &m_listElements;
+};
+
+SharedParts::SharedParts(const std::vector<unsigned char> &document, const ABWParseOptions &options,
+                         const unsigned long memoryLimit, const std::map<int, int> &tableSizes,
+                         const std::map<std::string, ABWData> &data, const std::map<int, ABWListElement *> &listElements)
+  : m_document(document)
+  , m_options(options)
+  , m_memoryLimit(memoryLimit)
+  , m_tableSizes(tableSizes)
+  , m_data(data)
+  , m_listElements(listElements)
 {
 }
 
+class SectionRangeTask : public ABWTask
+{
+public:
+  SectionRangeTask(const SharedParts &parts, ABWSectionRange &range)
+    : m_parts(parts)
+    , m_range(range)
+  {
+  }
+
+  void run()
+  {
+    m_range.m_isCollected = false;
+    m_range.m_isCut = false;
+    m_range.m_elements.reset();
+    try
+    {
+      ABWMemoryStream input(&m_parts.m_document[0], m_parts.m_document.size());
+      ABWParser parser(&input, 0, m_parts.m_options);
+      ABWPropertyCache propertyCache;
+      ABWContentCollector collector(0, m_parts.m_tableSizes, m_parts.m_data, m_parts.m_listElements, propertyCache);
+      collector.setCompactEvents(m_parts.m_options.getCompactEvents());
+      collector.setMemoryLimit(m_parts.m_memoryLimit);
+      if (m_range.m_first > 0)
+        collector.continueDocument();
+      m_range.m_collector = &collector;
+      m_range.m_isCollected = parser.collectSectionRange(m_range);
+      m_range.m_collector = 0;
+      if (m_range.m_isCollected)
+        m_range.m_elements = collector.getOutputElements();
+    }
+    catch (...)
+    {
+      m_range.m_collector = 0;
+      m_range.m_isCollected = false;
+    }
+  }
+
+private:
+  SectionRangeTask(const SectionRangeTask &);
+  SectionRangeTask &operator=(const SectionRangeTask &);
+
+  const SharedParts &m_parts;
+  ABWSectionRange &m_range;
+};
+
+} // anonymous namespace
+
 } // namespace libabw
 
-libabw::ABWParser::ABWParser(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *iface)
-  : m_input(input), m_iface(iface), m_collector(0), m_state(new ABWParserState())
+libabw::ABWParser::ABWParser(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *iface,
+                             const ABWParseOptions &options)
+  : m_input(input), m_iface(iface), m_collector(0), m_state(new ABWParserState()), m_options(options)
 {
 }
 
@@ -142,93 +370,455 @@ libabw::ABWParser::~ABWParser()
 }
 
 bool libabw::ABWParser::parse()
+{
+  return collect(0);
+}
+
+bool libabw::ABWParser::load(boost::shared_ptr<const ABWOutputElements> &elements)
+{
+  return collect(&elements);
+}
+
+bool libabw::ABWParser::startParsing()
 {
   if (!m_input)
     return false;
 
-  std::map<int, ABWListElement *> listElements;
   try
   {
-    std::map<int, int> tableSizes;
-    std::map<std::string, ABWData> data;
-    ABWStylesCollector stylesCollector(tableSizes, data, listElements);
-    m_collector = &stylesCollector;
-    m_input->seek(0, librevenge::RVNG_SEEK_SET);
-    if (!processXmlDocument(m_input))
-    {
-      clearListElements(listElements);
+    m_state->m_parts.reset(new ABWDocumentParts());
+    // the events are written on the caller's thread
+    return collectStyles(*m_state->m_parts) && startBody(*m_state->m_parts, m_iface, false);
+  }
+  catch (...)
+  {
+    return false;
+  }
+}
+
+bool libabw::ABWParser::parseNextNode()
+{
+  if (!m_state->m_reader)
+    return false;
+  if (processNextXmlNode())
+    return true;
+  finishXmlDocument();
+  return false;
+}
+
+bool libabw::ABWParser::collect(boost::shared_ptr<const ABWOutputElements> *const elements)
+{
+  if (!m_input)
+    return false;
+
+  try
+  {
+    ABWDocumentParts parts;
+    std::vector<unsigned long> sectionOffsets;
+    if (m_options.getThreadCount() > 1 && ABWThread::isSupported())
+      m_state->m_sectionOffsets = &sectionOffsets;
+    const bool isRead = collectStyles(parts);
+    m_state->m_sectionOffsets = 0;
+    if (!isRead)
       return false;
-    }
-    updateListElementIds(listElements);
-    ABWContentCollector contentCollector(m_iface, tableSizes, data, listElements);
-    m_collector = &contentCollector;
-    m_input->seek(0, librevenge::RVNG_SEEK_SET);
-    if (!processXmlDocument(m_input))
+
+    if (sectionOffsets.size() > 1 && sectionOffsets.size() == parts.m_sectionTableIds.size())
     {
-      clearListElements(listElements);
-      return false;
+      boost::shared_ptr<const ABWOutputElements> collected;
+      if (collectInParallel(parts.m_tableSizes, parts.m_data, parts.m_listElements, parts.m_sectionTableIds, sectionOffsets, collected))
+      {
+        if (elements)
+          *elements = collected;
+        else
+          collected->write(m_iface);
+        return true;
+      }
+      ABW_DEBUG_MSG(("ABWParser::collect: collecting the sections in parallel failed, collecting them in one go\n"));
     }
 
-    clearListElements(listElements);
+    if (!startBody(parts, elements ? 0 : m_iface, m_options.getPipelinedOutput()))
+      return false;
+    while (processNextXmlNode())
+    {
+    }
+    finishXmlDocument();
+    ABW_DEBUG_MSG(("ABWParser::collect: props cache: %lu hits, %lu misses\n", parts.m_propertyCache.getHits(), parts.m_propertyCache.getMisses()));
+    ABW_DEBUG_MSG(("ABWParser::collect: %lu text nodes merged into preceding ones\n", m_state->m_mergedTextNodes));
+    if (elements)
+      *elements = parts.m_contentCollector->getOutputElements();
     return true;
   }
   catch (...)
   {
-    clearListElements(listElements);
     return false;
   }
 }
 
-bool libabw::ABWParser::processXmlDocument(librevenge::RVNGInputStream *input)
+bool libabw::ABWParser::collectStyles(ABWDocumentParts &parts)
 {
-  if (!input)
+  if (scanStyles(parts))
+  {
+    updateListElementIds(parts.m_listElements);
+    return true;
+  }
+  ABW_DEBUG_MSG(("ABWParser::collectStyles: the document could not be scanned, reading it with libxml\n"));
+
+  ABWStylesCollector stylesCollector(parts.m_tableSizes, parts.m_data, parts.m_listElements,
+                                     parts.m_headerFooterTableIds, parts.m_sectionTableIds, parts.m_propertyCache);
+  const bool isRead = readStyles(stylesCollector, m_state->m_sectionOffsets);
+  if (isRead)
+    updateListElementIds(parts.m_listElements);
+  return isRead;
+}
+
+bool libabw::ABWParser::readStyles(ABWStylesCollector &collector, std::vector<unsigned long> *const sectionOffsets)
+{
+  if (!m_input)
     return false;
 
-  xmlTextReaderPtr reader = xmlReaderForStream(input);
-  if (!reader)
+  std::vector<unsigned long> *const savedSectionOffsets = m_state->m_sectionOffsets;
+  m_state->m_sectionOffsets = sectionOffsets;
+  m_collector = &collector;
+  // neither text nor metadata are collected with the styles, but data are
+  m_state->m_skipText = true;
+  m_state->m_collectData = true;
+  m_input->seek(0, librevenge::RVNG_SEEK_SET);
+  const bool isRead = processXmlDocument(m_input);
+  m_state->m_skipText = false;
+  m_state->m_collectData = false;
+  m_collector = 0;
+  m_state->m_sectionOffsets = savedSectionOffsets;
+  return isRead;
+}
+
+bool libabw::ABWParser::scanStyles(ABWDocumentParts &parts)
+{
+  // What is collected is only taken if the whole document has been
+  // scanned. The property cache only caches, so it is shared.
+  ABWDocumentParts scanned;
+  std::vector<unsigned long> sectionOffsets;
+  bool isScanned = false;
+  {
+    ABWStylesCollector stylesCollector(scanned.m_tableSizes, scanned.m_data, scanned.m_listElements,
+                                       scanned.m_headerFooterTableIds, scanned.m_sectionTableIds, parts.m_propertyCache);
+    m_input->seek(0, librevenge::RVNG_SEEK_SET);
+    ABWStylesScanner scanner(m_input, stylesCollector);
+    isScanned = scanner.scan(m_state->m_sectionOffsets ? &sectionOffsets : 0);
+  }
+  if (!isScanned)
     return false;
-  int ret = xmlTextReaderRead(reader);
-  while (1 == ret)
+
+  parts.m_tableSizes.swap(scanned.m_tableSizes);
+  parts.m_data.swap(scanned.m_data);
+  parts.m_listElements.swap(scanned.m_listElements);
+  parts.m_headerFooterTableIds.swap(scanned.m_headerFooterTableIds);
+  parts.m_sectionTableIds.swap(scanned.m_sectionTableIds);
+  if (m_state->m_sectionOffsets)
+    m_state->m_sectionOffsets->swap(sectionOffsets);
+  return true;
+}
+
+bool libabw::ABWParser::startBody(ABWDocumentParts &parts, librevenge::RVNGTextInterface *const iface, const bool pipelined)
+{
+  // With an interface, the body is written out as it is parsed. Headers and
+  // footers have to be known when the first page span is opened, but
+  // AbiWord puts them at the end of the document, so they are
+  // collected first in a pass that skips the body sections.
+  const bool hasHeadersOrFooters = iface && !parts.m_headerFooterTableIds.empty();
+  if (hasHeadersOrFooters)
+  {
+    parts.m_headerFooterCollector.reset(new ABWContentCollector(0, parts.m_tableSizes, parts.m_data, parts.m_listElements, parts.m_propertyCache));
+    parts.m_headerFooterCollector->setCompactEvents(m_options.getCompactEvents());
+    parts.m_headerFooterCollector->setHeaderFooterTableIds(parts.m_headerFooterTableIds);
+    m_collector = parts.m_headerFooterCollector.get();
+    m_state->m_skipBodySections = true;
+    m_input->seek(0, librevenge::RVNG_SEEK_SET);
+    const bool ok = processXmlDocument(m_input);
+    m_state->m_skipBodySections = false;
+    if (!ok)
+      return false;
+  }
+
+  parts.m_contentCollector.reset(new ABWContentCollector(iface, parts.m_tableSizes, parts.m_data, parts.m_listElements, parts.m_propertyCache));
+  parts.m_contentCollector->setCompactEvents(m_options.getCompactEvents());
+  parts.m_contentCollector->setMemoryLimit(m_options.getMemoryLimit());
+  if (iface)
+    parts.m_contentCollector->startStreaming(parts.m_headerFooterCollector.get(), pipelined);
+  m_collector = parts.m_contentCollector.get();
+  m_state->m_mergedTextNodes = 0;
+  m_input->seek(0, librevenge::RVNG_SEEK_SET);
+  return startXmlDocument(m_input);
+}
+
+bool libabw::ABWParser::collectInParallel(const std::map<int, int> &tableSizes, const std::map<std::string, ABWData> &data,
+                                          const std::map<int, ABWListElement *> &listElements,
+                                          const std::vector<int> &sectionTableIds, const std::vector<unsigned long> &sectionOffsets,
+                                          boost::shared_ptr<const ABWOutputElements> &elements)
+{
+  // Every range is read by its own reader, so the document has to be
+  // in memory. It is not kept there if that is more than allowed.
+  std::vector<unsigned char> document;
+  const unsigned long memoryLimit = m_options.getMemoryLimit();
+  m_input->seek(0, librevenge::RVNG_SEEK_SET);
+  while (!m_input->isEnd())
   {
-    int tokenType = xmlTextReaderNodeType(reader);
-    if (XML_READER_TYPE_SIGNIFICANT_WHITESPACE != tokenType)
-      processXmlNode(reader);
+    unsigned long numBytesRead = 0;
+    const unsigned char *const buffer = m_input->read(65536, numBytesRead);
+    if (!buffer || !numBytesRead)
+      break;
+    if (memoryLimit && document.size() + numBytesRead > memoryLimit)
+      return false;
+    document.insert(document.end(), buffer, buffer + numBytesRead);
+  }
+  if (document.empty())
+    return false;
 
-    ret = xmlTextReaderRead(reader);
+  // split the sections into ranges of about the same size
+  const std::size_t rangeCount = std::min<std::size_t>(m_options.getThreadCount(), sectionOffsets.size());
+  std::vector<ABWSectionRange> ranges;
+  std::size_t first = 0;
+  for (std::size_t i = 1; i < rangeCount; ++i)
+  {
+    const unsigned long offset = (unsigned long)(document.size() / rangeCount * i);
+    std::size_t end = std::size_t(std::lower_bound(sectionOffsets.begin(), sectionOffsets.end(), offset) - sectionOffsets.begin());
+    if (end <= first)
+      continue;
+    if (end >= sectionOffsets.size())
+      break;
+    ranges.push_back(ABWSectionRange(first, end));
+    first = end;
   }
-  xmlFreeTextReader(reader);
+  ranges.push_back(ABWSectionRange(first, 0));
+  if (ranges.size() < 2)
+    return false;
 
-  if (m_collector)
-    m_collector->endDocument();
+  // the ranges are collected at the same time, so they share the limit
+  const SharedParts parts(document, m_options, memoryLimit / ranges.size(), tableSizes, data, listElements);
+  std::vector<boost::shared_ptr<SectionRangeTask> > tasks;
+  for (std::vector<ABWSectionRange>::iterator iter = ranges.begin(); iter != ranges.end(); ++iter)
+  {
+    iter->m_sectionTableIds = &sectionTableIds;
+    tasks.push_back(boost::shared_ptr<SectionRangeTask>(new SectionRangeTask(parts, *iter)));
+  }
+  // libxml has to set up its global state before it is used by more threads
+  xmlInitParser();
+  {
+    std::vector<boost::shared_ptr<ABWThread> > threads;
+    for (std::size_t i = 1; i < tasks.size(); ++i)
+    {
+      threads.push_back(boost::shared_ptr<ABWThread>(new ABWThread()));
+      threads.back()->start(*tasks[i]);
+    }
+    tasks[0]->run();
+  }
+
+  // A range has been collected right only if the state it started with
+  // is the one the range before it has ended with. If the guess was
+  // wrong, it is collected again, starting with the right state.
+  unsigned recollected = 0;
+  for (std::size_t i = 0; i < ranges.size(); ++i)
+  {
+    if (i > 0 && ranges[i].m_isCollected && ranges[i].m_assumedBoundary != ranges[i - 1].m_finalBoundary)
+    {
+      ranges[i].m_hasStartBoundary = true;
+      ranges[i].m_startBoundary = ranges[i - 1].m_finalBoundary;
+      tasks[i]->run();
+      ++recollected;
+    }
+    if (!ranges[i].m_isCollected || !ranges[i].m_elements)
+      return false;
+    // a range can only be followed by another one at a clean cut
+    if (i + 1 < ranges.size() && (!ranges[i].m_isCut || !ranges[i].m_finalBoundary.m_isClean))
+    {
+      ABW_DEBUG_MSG(("ABWParser::collectInParallel: range %lu does not end at a clean cut\n", (unsigned long)i));
+      return false;
+    }
+  }
+  ABW_DEBUG_MSG(("ABWParser::collectInParallel: %lu ranges, %u collected again\n", (unsigned long)ranges.size(), recollected));
+
+  boost::shared_ptr<ABWOutputElements> combined(new ABWOutputElements());
+  combined->setMemoryLimit(memoryLimit);
+  for (std::vector<ABWSectionRange>::iterator iter = ranges.begin(); iter != ranges.end(); ++iter)
+  {
+    combined->append(*iter->m_elements);
+    iter->m_elements.reset();
+  }
+  elements = combined;
   return true;
 }
 
-void libabw::ABWParser::processXmlNode(xmlTextReaderPtr reader)
+bool libabw::ABWParser::collectSectionRange(ABWSectionRange &range)
 {
-  if (!reader)
-    return;
-  int tokenId = getElementToken(reader);
+  if (!m_input || !range.m_collector)
+    return false;
+
+  m_collector = range.m_collector;
+  m_state->m_sectionRange = &range;
+  m_state->m_bodySections = 0;
+  m_state->m_isInSectionRange = false;
+  m_input->seek(0, librevenge::RVNG_SEEK_SET);
+  const bool isCollected = processXmlDocument(m_input);
+  m_state->m_sectionRange = 0;
+  m_collector = 0;
+  return isCollected;
+}
+
+bool libabw::ABWParser::processXmlDocument(librevenge::RVNGInputStream *input)
+{
+  if (!startXmlDocument(input))
+    return false;
+  while (processNextXmlNode())
+  {
+  }
+  finishXmlDocument();
+  return true;
+}
+
+bool libabw::ABWParser::startXmlDocument(librevenge::RVNGInputStream *input)
+{
+  if (!input)
+    return false;
+
+  if (m_state->m_reader)
+    xmlFreeTextReader(m_state->m_reader);
+  m_state->m_reader = xmlReaderForStream(input);
+  if (!m_state->m_reader)
+    return false;
+  m_state->m_inMetadata = false;
+  m_state->m_currentMetadataKey.clear();
+  m_state->m_readerStatus = xmlTextReaderRead(m_state->m_reader);
+  return true;
+}
+
+bool libabw::ABWParser::processNextXmlNode()
+{
+  xmlTextReaderPtr reader = m_state->m_reader;
+  if (!reader || 1 != m_state->m_readerStatus)
+    return false;
+
   int tokenType = xmlTextReaderNodeType(reader);
-  int emptyToken = xmlTextReaderIsEmptyElement(reader);
-  if (XML_READER_TYPE_TEXT == tokenType)
+  // libxml may split a run of text into several nodes, e.g., around
+  // comments; they are passed on as one text once something else comes.
+  if (XML_READER_TYPE_TEXT != tokenType && XML_READER_TYPE_COMMENT != tokenType
+      && XML_READER_TYPE_PROCESSING_INSTRUCTION != tokenType && XML_READER_TYPE_SIGNIFICANT_WHITESPACE != tokenType)
+    flushText();
+  if (XML_READER_TYPE_ELEMENT == tokenType
+      && (m_state->m_skipBodySections || m_state->m_sectionOffsets || m_state->m_sectionRange)
+      && XML_SECTION == getElementToken(reader))
   {
-    const char *text = (const char *)xmlTextReaderConstValue(reader);
-    ABW_DEBUG_MSG(("ABWParser::processXmlNode: text %s\n", text));
-    if (m_state->m_inMetadata)
+    const bool isBody = isBodySection(reader);
+    if (m_state->m_skipBodySections && isBody)
+    {
+      m_state->m_readerStatus = xmlTextReaderNext(reader);
+      return 1 == m_state->m_readerStatus;
+    }
+    if (m_state->m_sectionOffsets && isBody)
+      m_state->m_sectionOffsets->push_back((unsigned long)xmlTextReaderByteConsumed(reader));
+    if (m_state->m_sectionRange)
     {
-      if (m_state->m_currentMetadataKey.empty())
+      ABWSectionRange &range = *m_state->m_sectionRange;
+      const std::size_t section = m_state->m_bodySections;
+      if (isBody)
+        ++m_state->m_bodySections;
+      if (section < range.m_first)
+      {
+        // only the properties of the sections before the range matter
+        readSection(reader);
+        m_state->m_readerStatus = xmlTextReaderNext(reader);
+        return 1 == m_state->m_readerStatus;
+      }
+      if (range.m_end && section >= range.m_end)
       {
-        ABW_DEBUG_MSG(("there is no key for metadata entry '%s'\n", text));
+        range.m_finalBoundary = range.m_collector->getSectionBoundary();
+        range.m_isCut = true;
+        m_state->m_readerStatus = 0;
+        return false;
       }
-      else
+      if (!m_state->m_isInSectionRange)
       {
-        m_collector->addMetadataEntry(m_state->m_currentMetadataKey.c_str(), text);
-        m_state->m_currentMetadataKey.clear();
+        m_state->m_isInSectionRange = true;
+        if (range.m_first > 0)
+        {
+          ABWSectionBoundary boundary = range.m_collector->getSectionBoundary();
+          if (range.m_hasStartBoundary)
+            boundary = range.m_startBoundary;
+          else
+          {
+            // the sections before have most likely been written out
+            boundary.m_isPageSpanOpened = true;
+            if (range.m_sectionTableIds && range.m_first < range.m_sectionTableIds->size())
+              boundary.m_tableCounter = (*range.m_sectionTableIds)[range.m_first];
+          }
+          range.m_collector->setSectionBoundary(boundary);
+          range.m_assumedBoundary = range.m_collector->getSectionBoundary();
+        }
       }
     }
+  }
+  if (XML_READER_TYPE_SIGNIFICANT_WHITESPACE != tokenType)
+    processXmlNode(reader);
+  if (m_state->m_isElementSkipped)
+  {
+    // the reader is at the node after the element already
+    m_state->m_isElementSkipped = false;
+    return 1 == m_state->m_readerStatus;
+  }
+
+  m_state->m_readerStatus = xmlTextReaderRead(reader);
+  return 1 == m_state->m_readerStatus;
+}
+
+void libabw::ABWParser::finishXmlDocument()
+{
+  if (m_state->m_reader)
+    xmlFreeTextReader(m_state->m_reader);
+  m_state->m_reader = 0;
+  flushText();
+
+  if (m_collector && !(m_state->m_sectionRange && m_state->m_sectionRange->m_isCut))
+    m_collector->endDocument();
+}
+
+void libabw::ABWParser::flushText()
+{
+  if (m_state->m_text.empty())
+    return;
+  const char *const text = m_state->m_text.c_str();
+  ABW_DEBUG_MSG(("ABWParser::flushText: text %s\n", text));
+  if (m_state->m_inMetadata)
+  {
+    if (m_state->m_currentMetadataKey.empty())
+    {
+      ABW_DEBUG_MSG(("there is no key for metadata entry '%s'\n", text));
+    }
     else
     {
-      m_collector->insertText(text);
+      m_collector->addMetadataEntry(m_state->m_currentMetadataKey.c_str(), text);
+      m_state->m_currentMetadataKey.clear();
+    }
+  }
+  else
+  {
+    m_collector->insertText(text);
+  }
+  m_state->m_text.clear();
+}
+
+void libabw::ABWParser::processXmlNode(xmlTextReaderPtr reader)
+{
+  if (!reader)
+    return;
+  int tokenId = getElementToken(reader);
+  int tokenType = xmlTextReaderNodeType(reader);
+  int emptyToken = xmlTextReaderIsEmptyElement(reader);
+  if (XML_READER_TYPE_TEXT == tokenType && !m_state->m_skipText)
+  {
+    const char *text = (const char *)xmlTextReaderConstValue(reader);
+    if (text)
+    {
+      if (!m_state->m_text.empty())
+        ++m_state->m_mergedTextNodes;
+      m_state->m_text.append(text);
     }
   }
   switch (tokenId)
@@ -248,16 +838,11 @@ void libabw::ABWParser::processXmlNode(xmlTextReaderPtr reader)
       readM(reader);
     break;
   case XML_HISTORY:
-    if (XML_READER_TYPE_ELEMENT == tokenType)
-      readHistory(reader);
-    break;
   case XML_REVISIONS:
-    if (XML_READER_TYPE_ELEMENT == tokenType)
-      readRevisions(reader);
-    break;
   case XML_IGNOREDWORDS:
+    // nothing in these is used
     if (XML_READER_TYPE_ELEMENT == tokenType)
-      readIgnoredWords(reader);
+      skipElement(reader);
     break;
   case XML_S:
     if (XML_READER_TYPE_ELEMENT == tokenType)
@@ -279,8 +864,11 @@ void libabw::ABWParser::processXmlNode(xmlTextReaderPtr reader)
         m_collector->endSection();
     break;
   case XML_D:
-    if (XML_READER_TYPE_ELEMENT == tokenType)
+    // the data are only collected with the styles, an empty <d/> has none
+    if (XML_READER_TYPE_ELEMENT == tokenType && m_state->m_collectData && emptyToken <= 0)
       readD(reader);
+    else if (XML_READER_TYPE_ELEMENT == tokenType && emptyToken <= 0)
+      skipElement(reader);
     break;
   case XML_P:
     if (XML_READER_TYPE_ELEMENT == tokenType)
@@ -395,74 +983,11 @@ void libabw::ABWParser::readM(xmlTextReaderPtr reader)
   }
 }
 
-void libabw::ABWParser::readHistory(xmlTextReaderPtr reader)
+void libabw::ABWParser::skipElement(xmlTextReaderPtr reader)
 {
-  int ret = 1;
-  int tokenId = XML_TOKEN_INVALID;
-  int tokenType = -1;
-  do
-  {
-    ret = xmlTextReaderRead(reader);
-    tokenId = getElementToken(reader);
-    if (XML_TOKEN_INVALID == tokenId)
-    {
-      ABW_DEBUG_MSG(("ABWParser::readHistory: unknown token %s\n", xmlTextReaderConstName(reader)));
-    }
-    tokenType = xmlTextReaderNodeType(reader);
-    switch (tokenId)
-    {
-    default:
-      break;
-    }
-  }
-  while ((XML_HISTORY != tokenId || XML_READER_TYPE_END_ELEMENT != tokenType) && 1 == ret);
-}
-
-void libabw::ABWParser::readRevisions(xmlTextReaderPtr reader)
-{
-  int ret = 1;
-  int tokenId = XML_TOKEN_INVALID;
-  int tokenType = -1;
-  do
-  {
-    ret = xmlTextReaderRead(reader);
-    tokenId = getElementToken(reader);
-    if (XML_TOKEN_INVALID == tokenId)
-    {
-      ABW_DEBUG_MSG(("ABWParser::readRevisions: unknown token %s\n", xmlTextReaderConstName(reader)));
-    }
-    tokenType = xmlTextReaderNodeType(reader);
-    (void)tokenType;
-    switch (tokenId)
-    {
-    default:
-      break;
-    }
-  }
-  while ((XML_REVISIONS != tokenId || XML_READER_TYPE_END_ELEMENT != tokenType) && 1 == ret);
-}
-
-void libabw::ABWParser::readIgnoredWords(xmlTextReaderPtr reader)
-{
-  int ret = 1;
-  int tokenId = XML_TOKEN_INVALID;
-  int tokenType = -1;
-  do
-  {
-    ret = xmlTextReaderRead(reader);
-    tokenId = getElementToken(reader);
-    if (XML_TOKEN_INVALID == tokenId)
-    {
-      ABW_DEBUG_MSG(("ABWParser::readIgnoreWords: unknown token %s\n", xmlTextReaderConstName(reader)));
-    }
-    tokenType = xmlTextReaderNodeType(reader);
-    switch (tokenId)
-    {
-    default:
-      break;
-    }
-  }
-  while ((XML_IGNOREDWORDS != tokenId || XML_READER_TYPE_END_ELEMENT != tokenType) && 1 == ret);
+  // moves past the end of the element without looking at what is in it
+  m_state->m_readerStatus = xmlTextReaderNext(reader);
+  m_state->m_isElementSkipped = true;
 }
 
 void libabw::ABWParser::readPageSize(xmlTextReaderPtr reader)
@@ -569,13 +1094,11 @@ void libabw::ABWParser::readD(xmlTextReaderPtr reader)
       const xmlChar *data = xmlTextReaderConstValue(reader);
       if (data)
       {
-        librevenge::RVNGBinaryData binaryData;
-        if (base64)
-          binaryData.appendBase64Data((const char *)data);
-        else
-          binaryData.append(data, (unsigned long) xmlStrlen(data));
+        ABWData abwData;
+        abwData.m_mimeType = mimeType ? (const char *)mimeType : "";
+        getStoredData((const char *)data, base64, abwData);
         if (m_collector)
-          m_collector->collectData((const char *)name, (const char *)mimeType, binaryData);
+          m_collector->collectData((const char *)name, abwData);
       }
       break;
     }
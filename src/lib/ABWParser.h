@@ -10,24 +10,66 @@
 #ifndef __ABWPARSER_H__
 #define __ABWPARSER_H__
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <librevenge/librevenge.h>
+#include <libabw/ABWParseOptions.h>
 #include "ABWXMLHelper.h"
 
 namespace libabw
 {
 
 class ABWCollector;
+struct ABWData;
+struct ABWDocumentParts;
+struct ABWListElement;
+class ABWOutputElements;
 struct ABWParserState;
+struct ABWSectionRange;
+class ABWStylesCollector;
 
 class ABWParser
 {
 public:
-  explicit ABWParser(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *iface);
+  explicit ABWParser(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *iface,
+                     const ABWParseOptions &options = ABWParseOptions());
   virtual ~ABWParser();
   bool parse();
 
+  /** Collects the whole document into @c elements, without writing
+      anything to the interface. Body events past the memory limit of the
+      options are moved to a temporary file.
+    */
+  bool load(boost::shared_ptr<const ABWOutputElements> &elements);
+
+  /** Collects the sections of @c range with its collector, after
+      reading the rest of the document up to them.
+    */
+  bool collectSectionRange(ABWSectionRange &range);
+
+  /** Reads what is needed before the body, so that the body can be
+      parsed with parseNextNode. Its events are written to the interface
+      as they come.
+    */
+  bool startParsing();
+
+  /** Parses the next XML node of the body. Returns false once the end
+      of the document has been reached.
+    */
+  bool parseNextNode();
+
+  /** Reads what comes before the body into @c collector with libxml, as
+      is done for documents that ABWStylesScanner cannot read. If
+      @c sectionOffsets is set, where the body sections start is added
+      to it; libxml only tells that roughly.
+    */
+  bool readStyles(ABWStylesCollector &collector, std::vector<unsigned long> *sectionOffsets);
+
 private:
   ABWParser();
   ABWParser(const ABWParser &);
@@ -36,17 +78,27 @@ private:
   // Helper functions
 
   int getElementToken(xmlTextReaderPtr reader);
+  bool collect(boost::shared_ptr<const ABWOutputElements> *elements);
+  bool collectInParallel(const std::map<int, int> &tableSizes, const std::map<std::string, ABWData> &data,
+                         const std::map<int, ABWListElement *> &listElements,
+                         const std::vector<int> &sectionTableIds, const std::vector<unsigned long> &sectionOffsets,
+                         boost::shared_ptr<const ABWOutputElements> &elements);
+  bool collectStyles(ABWDocumentParts &parts);
+  bool scanStyles(ABWDocumentParts &parts);
+  bool startBody(ABWDocumentParts &parts, librevenge::RVNGTextInterface *iface, bool pipelined);
 
   // Functions to read the AWML document structure
 
   bool processXmlDocument(librevenge::RVNGInputStream *input);
+  bool startXmlDocument(librevenge::RVNGInputStream *input);
+  bool processNextXmlNode();
+  void finishXmlDocument();
   void processXmlNode(xmlTextReaderPtr reader);
+  void flushText();
 
   void readAbiword(xmlTextReaderPtr reader);
   void readM(xmlTextReaderPtr reader);
-  void readHistory(xmlTextReaderPtr reader);
-  void readRevisions(xmlTextReaderPtr reader);
-  void readIgnoredWords(xmlTextReaderPtr reader);
+  void skipElement(xmlTextReaderPtr reader);
   void readPageSize(xmlTextReaderPtr reader);
   void readSection(xmlTextReaderPtr reader);
   void readA(xmlTextReaderPtr reader);
@@ -66,6 +118,7 @@ private:
   librevenge::RVNGTextInterface *m_iface;
   ABWCollector *m_collector;
   boost::scoped_ptr<ABWParserState> m_state;
+  const ABWParseOptions m_options;
 };
 
 } // namespace libabw
@@ -0,0 +1,300 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "ABWPropertyMap.h"
+
+namespace libabw
+{
+
+namespace
+{
+
+#include "prophash.h"
+
+bool isSpace(const char c)
+{
+  return ' ' == c || '\t' == c || '\n' == c || '\v' == c || '\f' == c || '\r' == c;
+}
+
+int compareKeys(const char *key, std::size_t keyLength, const char *name, std::size_t nameLength)
+{
+  const int cmp = memcmp(key, name, keyLength < nameLength ? keyLength : nameLength);
+  if (cmp)
+    return cmp;
+  if (keyLength == nameLength)
+    return 0;
+  return keyLength < nameLength ? -1 : 1;
+}
+
+std::size_t hashString(const char *str)
+{
+  // FNV-1a
+  std::size_t hash = 2166136261U;
+  for (; *str; ++str)
+  {
+    hash ^= static_cast<unsigned char>(*str);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+} // anonymous namespace
+
+} // namespace libabw
+
+libabw::ABWPropertyMap::ABWPropertyMap()
+  : m_known(), m_knownCount(0), m_entries(), m_buffer()
+{
+}
+
+void libabw::ABWPropertyMap::clear()
+{
+  std::fill(m_known, m_known + PROP_TOKEN_COUNT, 0);
+  m_knownCount = 0;
+  m_entries.clear();
+  m_buffer.clear();
+}
+
+bool libabw::ABWPropertyMap::empty() const
+{
+  return !m_knownCount && m_entries.empty();
+}
+
+void libabw::ABWPropertyMap::set(const char *name, std::size_t nameLength, const char *value, std::size_t valueLength)
+{
+  const int id = getPropertyId(name, nameLength);
+  if (PROP_TOKEN_INVALID != id)
+  {
+    if (!m_known[id - 1])
+      ++m_knownCount;
+    m_known[id - 1] = store(value, valueLength) + 1;
+    return;
+  }
+
+  std::vector<Entry>::iterator it = lowerBound(name, nameLength);
+  if (it != m_entries.end() && matches(*it, name, nameLength))
+  {
+    it->m_value = store(value, valueLength);
+  }
+  else
+  {
+    const std::vector<Entry>::difference_type pos = it - m_entries.begin();
+    const std::size_t key = store(name, nameLength);
+    const std::size_t val = store(value, valueLength);
+    m_entries.insert(m_entries.begin() + pos, Entry(key, nameLength, val));
+  }
+}
+
+void libabw::ABWPropertyMap::set(const char *name, const char *value)
+{
+  if (name && value)
+    set(name, strlen(name), value, strlen(value));
+}
+
+void libabw::ABWPropertyMap::set(const int id, const char *value)
+{
+  if (0 < id && PROP_TOKEN_COUNT >= id && value)
+  {
+    if (!m_known[id - 1])
+      ++m_knownCount;
+    m_known[id - 1] = store(value, strlen(value)) + 1;
+  }
+}
+
+void libabw::ABWPropertyMap::merge(const ABWPropertyMap &other)
+{
+  if (&other == this)
+    return;
+  for (int id = 1; id <= PROP_TOKEN_COUNT; ++id)
+  {
+    if (other.m_known[id - 1])
+      set(id, other.m_buffer.data() + other.m_known[id - 1] - 1);
+  }
+  for (std::vector<Entry>::const_iterator it = other.m_entries.begin(); it != other.m_entries.end(); ++it)
+  {
+    const char *const value = other.m_buffer.data() + it->m_value;
+    set(other.m_buffer.data() + it->m_key, it->m_keyLength, value, strlen(value));
+  }
+}
+
+const char *libabw::ABWPropertyMap::find(const char *name) const
+{
+  if (!name)
+    return 0;
+  const std::size_t nameLength = strlen(name);
+  const int id = getPropertyId(name, nameLength);
+  if (PROP_TOKEN_INVALID != id)
+    return find(id);
+  std::vector<Entry>::const_iterator it = lowerBound(name, nameLength);
+  if (it != m_entries.end() && matches(*it, name, nameLength))
+    return m_buffer.data() + it->m_value;
+  return 0;
+}
+
+const char *libabw::ABWPropertyMap::find(const int id) const
+{
+  if (0 < id && PROP_TOKEN_COUNT >= id && m_known[id - 1])
+    return m_buffer.data() + m_known[id - 1] - 1;
+  return 0;
+}
+
+int libabw::ABWPropertyMap::getPropertyId(const char *name, std::size_t nameLength)
+{
+  const proptoken *token = Perfect_Hash::in_word_set(name, (unsigned int)nameLength);
+  if (token)
+    return token->tokenId;
+  return PROP_TOKEN_INVALID;
+}
+
+std::vector<libabw::ABWPropertyMap::Entry>::iterator libabw::ABWPropertyMap::lowerBound(const char *name, std::size_t nameLength)
+{
+  const ABWPropertyMap &self = *this;
+  return m_entries.begin() + (self.lowerBound(name, nameLength) - m_entries.begin());
+}
+
+std::vector<libabw::ABWPropertyMap::Entry>::const_iterator libabw::ABWPropertyMap::lowerBound(const char *name, std::size_t nameLength) const
+{
+  std::vector<Entry>::const_iterator first = m_entries.begin();
+  std::vector<Entry>::difference_type count = m_entries.end() - first;
+  while (count > 0)
+  {
+    const std::vector<Entry>::difference_type step = count / 2;
+    std::vector<Entry>::const_iterator it = first + step;
+    if (compareKeys(m_buffer.data() + it->m_key, it->m_keyLength, name, nameLength) < 0)
+    {
+      first = ++it;
+      count -= step + 1;
+    }
+    else
+      count = step;
+  }
+  return first;
+}
+
+bool libabw::ABWPropertyMap::matches(const Entry &entry, const char *name, std::size_t nameLength) const
+{
+  return entry.m_keyLength == nameLength && !memcmp(m_buffer.data() + entry.m_key, name, nameLength);
+}
+
+std::size_t libabw::ABWPropertyMap::store(const char *str, std::size_t length)
+{
+  const std::size_t offset = m_buffer.size();
+  m_buffer.append(str, length);
+  m_buffer.push_back('\0');
+  return offset;
+}
+
+std::size_t libabw::ABWPropertyCache::Hash::operator()(const std::string &key) const
+{
+  return hashString(key.c_str());
+}
+
+std::size_t libabw::ABWPropertyCache::Hash::operator()(const char *key) const
+{
+  return hashString(key);
+}
+
+bool libabw::ABWPropertyCache::Equal::operator()(const std::string &left, const std::string &right) const
+{
+  return left == right;
+}
+
+bool libabw::ABWPropertyCache::Equal::operator()(const char *left, const std::string &right) const
+{
+  return right == left;
+}
+
+bool libabw::ABWPropertyCache::Equal::operator()(const std::string &left, const char *right) const
+{
+  return left == right;
+}
+
+libabw::ABWPropertyCache::ABWPropertyCache()
+  : m_map(), m_hits(0), m_misses(0)
+{
+}
+
+const libabw::ABWPropertyMap &libabw::ABWPropertyCache::get(const char *props)
+{
+  if (!props)
+    props = "";
+
+  Map_t::const_iterator it = m_map.find(props, Hash(), Equal());
+  if (it != m_map.end())
+  {
+    ++m_hits;
+    return it->second;
+  }
+
+  ++m_misses;
+  ABWPropertyMap &properties = m_map[props];
+  parsePropString(props, properties);
+  return properties;
+}
+
+unsigned long libabw::ABWPropertyCache::getHits() const
+{
+  return m_hits;
+}
+
+unsigned long libabw::ABWPropertyCache::getMisses() const
+{
+  return m_misses;
+}
+
+void libabw::parsePropString(const char *str, std::size_t len, ABWPropertyMap &props)
+{
+  if (!str)
+    return;
+
+  const char *const end = str + len;
+  const char *item = str;
+  while (item != end)
+  {
+    const char *itemEnd = static_cast<const char *>(memchr(item, ';', std::size_t(end - item)));
+    if (!itemEnd)
+      itemEnd = end;
+
+    const char *first = item;
+    const char *last = itemEnd;
+    while (first != last && isSpace(*first))
+      ++first;
+    while (first != last && isSpace(*(last - 1)))
+      --last;
+
+    // Only "name:value" is accepted. Runs of colons count as one
+    // separator, so "name::value" is fine, but "a:b:c" is not.
+    const char *colon = static_cast<const char *>(memchr(first, ':', std::size_t(last - first)));
+    if (colon)
+    {
+      const char *value = colon;
+      while (value != last && ':' == *value)
+        ++value;
+      if (!memchr(value, ':', std::size_t(last - value)))
+        props.set(first, std::size_t(colon - first), value, std::size_t(last - value));
+    }
+
+    item = itemEnd == end ? end : itemEnd + 1;
+  }
+}
+
+void libabw::parsePropString(const char *str, ABWPropertyMap &props)
+{
+  if (str)
+    parsePropString(str, strlen(str), props);
+}
+
+void libabw::parsePropString(const std::string &str, ABWPropertyMap &props)
+{
+  parsePropString(str.data(), str.size(), props);
+}
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
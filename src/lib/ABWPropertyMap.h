@@ -0,0 +1,135 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWPROPERTYMAP_H__
+#define __ABWPROPERTYMAP_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include "props.h"
+
+namespace libabw
+{
+
+/** A flat table of AbiWord properties.
+
+    All keys and values live in a single character buffer, each one
+    terminated by a NUL. The properties libabw knows about (listed in
+    props.txt) are stored in a dense array indexed by their id; other
+    properties go to a side table kept sorted by key.
+  */
+class ABWPropertyMap
+{
+public:
+  ABWPropertyMap();
+
+  void clear();
+  bool empty() const;
+
+  void set(const char *name, std::size_t nameLength, const char *value, std::size_t valueLength);
+  void set(const char *name, const char *value);
+  void set(int id, const char *value);
+
+  /** Copies all properties of @c other into this map, replacing the
+      values of properties that are set in both.
+    */
+  void merge(const ABWPropertyMap &other);
+
+  /** Returns the value of property @c name, or 0 if it is not set.
+
+      The returned string is only valid until the map is modified.
+    */
+  const char *find(const char *name) const;
+  const char *find(int id) const;
+
+  /** Returns the id of a known property, or PROP_TOKEN_INVALID.
+    */
+  static int getPropertyId(const char *name, std::size_t nameLength);
+
+private:
+  struct Entry
+  {
+    Entry(std::size_t key, std::size_t keyLength, std::size_t value)
+      : m_key(key), m_keyLength(keyLength), m_value(value) {}
+
+    std::size_t m_key;
+    std::size_t m_keyLength;
+    std::size_t m_value;
+  };
+
+  std::vector<Entry>::iterator lowerBound(const char *name, std::size_t nameLength);
+  std::vector<Entry>::const_iterator lowerBound(const char *name, std::size_t nameLength) const;
+  bool matches(const Entry &entry, const char *name, std::size_t nameLength) const;
+  std::size_t store(const char *str, std::size_t length);
+
+  // offset of the value + 1, or 0 if the property is not set
+  std::size_t m_known[PROP_TOKEN_COUNT];
+  std::size_t m_knownCount;
+  std::vector<Entry> m_entries;
+  std::string m_buffer;
+};
+
+/** Parses props strings, each distinct string only once.
+
+    AbiWord repeats the same props strings over and over again (every span
+    of a run-on paragraph, every cell of a table...). One cache is shared
+    by all passes over a document. The returned maps stay valid for the
+    lifetime of the cache.
+  */
+class ABWPropertyCache
+{
+  struct Hash
+  {
+    std::size_t operator()(const std::string &key) const;
+    std::size_t operator()(const char *key) const;
+  };
+
+  struct Equal
+  {
+    bool operator()(const std::string &left, const std::string &right) const;
+    bool operator()(const char *left, const std::string &right) const;
+    bool operator()(const std::string &left, const char *right) const;
+  };
+
+  typedef boost::unordered_map<std::string, ABWPropertyMap, Hash, Equal> Map_t;
+
+public:
+  ABWPropertyCache();
+
+  /** Returns the parsed form of @c props. A null @c props gives an empty map.
+    */
+  const ABWPropertyMap &get(const char *props);
+
+  unsigned long getHits() const;
+  unsigned long getMisses() const;
+
+private:
+  ABWPropertyCache(const ABWPropertyCache &);
+  ABWPropertyCache &operator=(const ABWPropertyCache &);
+
+  Map_t m_map;
+  unsigned long m_hits;
+  unsigned long m_misses;
+};
+
+/** Parses a props="..." string of the form "name: value; name: value"
+    into @c props. Items that are not exactly one name and one value
+    are ignored.
+  */
+void parsePropString(const char *str, std::size_t len, ABWPropertyMap &props);
+void parsePropString(const char *str, ABWPropertyMap &props);
+void parsePropString(const std::string &str, ABWPropertyMap &props);
+
+} // namespace libabw
+
+#endif /* __ABWPROPERTYMAP_H__ */
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
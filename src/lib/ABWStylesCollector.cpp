@@ -7,6 +7,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include <string.h>
 #include <boost/spirit/include/classic.hpp>
 #include <boost/algorithm/string.hpp>
 #include <librevenge/librevenge.h>
@@ -114,7 +115,7 @@ static void appendUCS4(librevenge::RVNGString &str, unsigned ucs4)
 } // namespace libabw
 
 libabw::ABWStylesTableState::ABWStylesTableState() :
-  m_currentCellProperties(),
+  m_currentCellProperties(0),
   m_currentTableWidth(0),
   m_currentTableRow(-1),
   m_currentTableId(-1) {}
@@ -137,12 +138,18 @@ libabw::ABWStylesParsingState::~ABWStylesParsingState() {}
 
 libabw::ABWStylesCollector::ABWStylesCollector(std::map<int, int> &tableSizes,
                                                std::map<std::string, ABWData> &data,
-                                               std::map<int, ABWListElement *> &listElements) :
+                                               std::map<int, ABWListElement *> &listElements,
+                                               std::vector<int> &headerFooterTableIds,
+                                               std::vector<int> &sectionTableIds,
+                                               ABWPropertyCache &propertyCache) :
   m_ps(new ABWStylesParsingState),
   m_tableSizes(tableSizes),
   m_data(data),
   m_tableCounter(0),
-  m_listElements(listElements) {}
+  m_listElements(listElements),
+  m_headerFooterTableIds(headerFooterTableIds),
+  m_sectionTableIds(sectionTableIds),
+  m_propertyCache(propertyCache) {}
 
 libabw::ABWStylesCollector::~ABWStylesCollector()
 {
@@ -155,6 +162,7 @@ void libabw::ABWStylesCollector::openTable(const char *)
   m_ps->m_tableStates.top().m_currentTableId = m_tableCounter++;
   m_ps->m_tableStates.top().m_currentTableRow = -1;
   m_ps->m_tableStates.top().m_currentTableWidth = 0;
+  m_ps->m_tableStates.top().m_currentCellProperties = &m_propertyCache.get(0);
 }
 
 void libabw::ABWStylesCollector::closeTable()
@@ -169,10 +177,9 @@ void libabw::ABWStylesCollector::openCell(const char *props)
 {
   if (!m_ps->m_tableStates.empty())
   {
-    if (props)
-      parsePropString(props, m_ps->m_tableStates.top().m_currentCellProperties);
+    m_ps->m_tableStates.top().m_currentCellProperties = &m_propertyCache.get(props);
     int currentRow(0);
-    if (!findInt(_findCellProperty("top-attach"), currentRow))
+    if (!findInt(_findCellProperty(PROP_TOP_ATTACH), currentRow))
       currentRow = m_ps->m_tableStates.top().m_currentTableRow + 1;
     while (m_ps->m_tableStates.top().m_currentTableRow < currentRow)
       m_ps->m_tableStates.top().m_currentTableRow++;
@@ -181,7 +188,7 @@ void libabw::ABWStylesCollector::openCell(const char *props)
     {
       int leftAttach(0);
       int rightAttach(0);
-      if (findInt(_findCellProperty("left-attach"), leftAttach) && findInt(_findCellProperty("right-attach"), rightAttach))
+      if (findInt(_findCellProperty(PROP_LEFT_ATTACH), leftAttach) && findInt(_findCellProperty(PROP_RIGHT_ATTACH), rightAttach))
         m_ps->m_tableStates.top().m_currentTableWidth += rightAttach - leftAttach;
       else
         m_ps->m_tableStates.top().m_currentTableWidth++;
@@ -192,22 +199,34 @@ void libabw::ABWStylesCollector::openCell(const char *props)
 void libabw::ABWStylesCollector::closeCell()
 {
   if (!m_ps->m_tableStates.empty())
-    m_ps->m_tableStates.top().m_currentCellProperties.clear();
+    m_ps->m_tableStates.top().m_currentCellProperties = &m_propertyCache.get(0);
 }
 
-std::string libabw::ABWStylesCollector::_findCellProperty(const char *name)
+std::string libabw::ABWStylesCollector::_findCellProperty(const int id)
 {
-  ABWPropertyMap::const_iterator iter = m_ps->m_tableStates.top().m_currentCellProperties.find(name);
-  if (iter != m_ps->m_tableStates.top().m_currentCellProperties.end())
-    return iter->second;
-  return std::string();
+  const char *const value = m_ps->m_tableStates.top().m_currentCellProperties->find(id);
+  return value ? value : std::string();
 }
 
-void libabw::ABWStylesCollector::collectData(const char *name, const char *mimeType, const librevenge::RVNGBinaryData &data)
+void libabw::ABWStylesCollector::collectSectionProperties(const char *, const char *, const char *, const char *,
+                                                          const char *, const char *, const char *, const char *,
+                                                          const char *)
+{
+  // the id of the first table in this body section
+  m_sectionTableIds.push_back(m_tableCounter);
+}
+
+void libabw::ABWStylesCollector::collectHeaderFooter(const char *, const char *)
+{
+  // the id of the first table in this header or footer section
+  m_headerFooterTableIds.push_back(m_tableCounter);
+}
+
+void libabw::ABWStylesCollector::collectData(const char *name, const ABWData &data)
 {
   if (!name)
     return;
-  m_data[name] = ABWData(mimeType ? mimeType : "", data);
+  m_data[name] = data;
 }
 
 void libabw::ABWStylesCollector::_processList(int id, const char *listDelim, int parentid, int startValue, int type)
@@ -336,9 +355,7 @@ void libabw::ABWStylesCollector::collectList(const char *id, const char *, const
 
 void libabw::ABWStylesCollector::collectParagraphProperties(const char *level, const char *listid, const char *parentid, const char * /* style */, const char *props)
 {
-  ABWPropertyMap properties;
-  if (props)
-    parsePropString(props, properties);
+  const ABWPropertyMap &properties = m_propertyCache.get(props);
 
   int intParentId(0);
   if (!parentid || !findInt(parentid, intParentId) || intParentId < 0)
@@ -350,55 +367,55 @@ void libabw::ABWStylesCollector::collectParagraphProperties(const char *level, c
   std::map<int, ABWListElement *>::iterator iter = m_listElements.find(intListId);
   if (iter == m_listElements.end() || !iter->second)
   {
-    ABWPropertyMap::const_iterator i = properties.find("list-style");
+    const char *i = properties.find(PROP_LIST_STYLE);
     int listStyle(NOT_A_LIST);
-    if (i != properties.end())
+    if (i)
     {
-      if (i->second == "Numbered List")
+      if (!strcmp(i, "Numbered List"))
         listStyle = NUMBERED_LIST;
-      else if (i->second == "Lower Case List")
+      else if (!strcmp(i, "Lower Case List"))
         listStyle = LOWERCASE_LIST;
-      else if (i->second == "Upper Case List")
+      else if (!strcmp(i, "Upper Case List"))
         listStyle = UPPERCASE_LIST;
-      else if (i->second == "Lower Roman List")
+      else if (!strcmp(i, "Lower Roman List"))
         listStyle = LOWERROMAN_LIST;
-      else if (i->second == "Upper Roman List")
+      else if (!strcmp(i, "Upper Roman List"))
         listStyle = UPPERROMAN_LIST;
-      else if (i->second == "Hebrew List")
+      else if (!strcmp(i, "Hebrew List"))
         listStyle = HEBREW_LIST;
-      else if (i->second == "Arabic List")
+      else if (!strcmp(i, "Arabic List"))
         listStyle = ARABICNUMBERED_LIST;
-      else if (i->second == "Bullet List")
+      else if (!strcmp(i, "Bullet List"))
         listStyle = BULLETED_LIST;
-      else if (i->second == "Dashed List")
+      else if (!strcmp(i, "Dashed List"))
         listStyle = DASHED_LIST;
-      else if (i->second == "Square List")
+      else if (!strcmp(i, "Square List"))
         listStyle = SQUARE_LIST;
-      else if (i->second == "Triangle List")
+      else if (!strcmp(i, "Triangle List"))
         listStyle = TRIANGLE_LIST;
-      else if (i->second == "Diamond List")
+      else if (!strcmp(i, "Diamond List"))
         listStyle = DIAMOND_LIST;
-      else if (i->second == "Star List")
+      else if (!strcmp(i, "Star List"))
         listStyle = STAR_LIST;
-      else if (i->second == "Implies List")
+      else if (!strcmp(i, "Implies List"))
         listStyle = IMPLIES_LIST;
-      else if (i->second == "Tick List")
+      else if (!strcmp(i, "Tick List"))
         listStyle = TICK_LIST;
-      else if (i->second == "Box List")
+      else if (!strcmp(i, "Box List"))
         listStyle = BOX_LIST;
-      else if (i->second == "Hand List")
+      else if (!strcmp(i, "Hand List"))
         listStyle = HAND_LIST;
-      else if (i->second == "Heart List")
+      else if (!strcmp(i, "Heart List"))
         listStyle = HEART_LIST;
-      else if (i->second == "Arrowhead List")
+      else if (!strcmp(i, "Arrowhead List"))
         listStyle = ARROWHEAD_LIST;
       else
         listStyle = NOT_A_LIST;
     }
-    i = properties.find("start-value");
+    i = properties.find(PROP_START_VALUE);
     std::string startValue;
-    if (i != properties.end())
-      startValue = i->second;
+    if (i)
+      startValue = i;
     int intStartValue(0);
     if (startValue.empty() || findInt(startValue, intStartValue) || intStartValue < 0)
       intStartValue = 0;
@@ -412,14 +429,14 @@ void libabw::ABWStylesCollector::collectParagraphProperties(const char *level, c
     if (!level || !findInt(level, listElement->m_listLevel) || listElement->m_listLevel < 0)
       listElement->m_listLevel = 0;
 
-    ABWPropertyMap::const_iterator i = properties.find("margin-left");
+    const char *i = properties.find(PROP_MARGIN_LEFT);
     ABWUnit unit(ABW_NONE);
     double marginLeft(0.0);
-    if (i == properties.end() || !findDouble(i->second, marginLeft, unit) || unit != ABW_IN)
+    if (!i || !findDouble(i, marginLeft, unit) || unit != ABW_IN)
       marginLeft = 0.0;
-    i = properties.find("text-indent");
+    i = properties.find(PROP_TEXT_INDENT);
     double textIndent(0.0);
-    if (i == properties.end() || !findDouble(i->second, textIndent, unit) || unit != ABW_IN)
+    if (!i || !findDouble(i, textIndent, unit) || unit != ABW_IN)
       textIndent = 0.0;
     listElement->m_minLabelWidth = -textIndent;
     listElement->m_spaceBefore = marginLeft + textIndent;
@@ -11,6 +11,7 @@
 #define __ABWSTYLESCOLLECTOR_H__
 
 #include <stack>
+#include <vector>
 #include <librevenge/librevenge.h>
 #include "ABWCollector.h"
 
@@ -23,11 +24,15 @@ struct ABWStylesTableState
   ABWStylesTableState(const ABWStylesTableState &ts);
   ~ABWStylesTableState();
 
-  ABWPropertyMap m_currentCellProperties;
+  // owned by the property cache
+  const ABWPropertyMap *m_currentCellProperties;
 
   int m_currentTableWidth;
   int m_currentTableRow;
   int m_currentTableId;
+
+private:
+  ABWStylesTableState &operator=(const ABWStylesTableState &);
 };
 
 struct ABWStylesParsingState
@@ -44,7 +49,10 @@ class ABWStylesCollector : public ABWCollector
 public:
   ABWStylesCollector(std::map<int, int> &tableSizes,
                      std::map<std::string, ABWData> &data,
-                     std::map<int, ABWListElement *> &listElements);
+                     std::map<int, ABWListElement *> &listElements,
+                     std::vector<int> &headerFooterTableIds,
+                     std::vector<int> &sectionTableIds,
+                     ABWPropertyCache &propertyCache);
   virtual ~ABWStylesCollector();
 
   // collector functions
@@ -55,7 +63,7 @@ public:
                                   const char *style, const char *props);
   void collectSectionProperties(const char *, const char *, const char *, const char *,
                                 const char *, const char *, const char *, const char *,
-                                const char *) {}
+                                const char *);
   void collectCharacterProperties(const char *, const char *) {}
   void collectPageSize(const char *, const char *, const char *, const char *) {}
   void closeParagraphOrListElement() {}
@@ -75,8 +83,8 @@ public:
   void insertText(const char *) {}
   void insertImage(const char *, const char *) {}
 
-  void collectData(const char *name, const char *mimeType, const librevenge::RVNGBinaryData &data);
-  void collectHeaderFooter(const char *, const char *) {}
+  void collectData(const char *name, const ABWData &data);
+  void collectHeaderFooter(const char *, const char *);
   void collectList(const char *id, const char *listDecimal, const char *listDelim,
                    const char *parentid, const char *startValue, const char *type);
 
@@ -91,7 +99,7 @@ private:
   ABWStylesCollector(const ABWStylesCollector &);
   ABWStylesCollector &operator=(const ABWStylesCollector &);
 
-  std::string _findCellProperty(const char *name);
+  std::string _findCellProperty(int id);
   void _processList(int id, const char *listDelim, int parentid, int startValue, int type);
 
   ABWStylesParsingState *m_ps;
@@ -99,6 +107,9 @@ private:
   std::map<std::string, ABWData> &m_data;
   int m_tableCounter;
   std::map<int, ABWListElement *> &m_listElements;
+  std::vector<int> &m_headerFooterTableIds;
+  std::vector<int> &m_sectionTableIds;
+  ABWPropertyCache &m_propertyCache;
 };
 
 } // namespace libabw
@@ -0,0 +1,966 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined __SSE2__ && defined __GNUC__
+#include <emmintrin.h>
+#endif
+
+#include <boost/algorithm/string.hpp>
+#include <libxml/parserInternals.h>
+#include "ABWStylesScanner.h"
+#include "ABWDataStore.h"
+#include "ABWStylesCollector.h"
+#include "libabw_internal.h"
+
+namespace libabw
+{
+
+namespace
+{
+
+// libxml refuses longer names and text and deeper nesting, unless it is
+// told to read huge documents. As it does not count quite the same way,
+// anything close to that is left to it.
+const std::size_t MAX_NAME_LENGTH = XML_MAX_NAME_LENGTH / 2;
+const std::size_t MAX_TEXT_LENGTH = XML_MAX_TEXT_LENGTH / 2;
+const std::size_t MAX_DEPTH = 128;
+
+enum Element
+{
+  ELEMENT_OTHER,
+  ELEMENT_CELL,
+  ELEMENT_D,
+  ELEMENT_L,
+  ELEMENT_P,
+  ELEMENT_SECTION,
+  ELEMENT_TABLE,
+  // an element whose content is not read at all
+  ELEMENT_IGNORED
+};
+
+Element getElement(const char *const name, const std::size_t length)
+{
+  switch (length)
+  {
+  case 1:
+    switch (name[0])
+    {
+    case 'd':
+      return ELEMENT_D;
+    case 'l':
+      return ELEMENT_L;
+    case 'p':
+      return ELEMENT_P;
+    default:
+      break;
+    }
+    break;
+  case 4:
+    if (!memcmp(name, "cell", 4))
+      return ELEMENT_CELL;
+    break;
+  case 5:
+    if (!memcmp(name, "table", 5))
+      return ELEMENT_TABLE;
+    break;
+  case 7:
+    if (!memcmp(name, "section", 7))
+      return ELEMENT_SECTION;
+    if (!memcmp(name, "history", 7))
+      return ELEMENT_IGNORED;
+    break;
+  case 9:
+    if (!memcmp(name, "revisions", 9))
+      return ELEMENT_IGNORED;
+    break;
+  case 12:
+    if (!memcmp(name, "ignoredwords", 12))
+      return ELEMENT_IGNORED;
+    break;
+  default:
+    break;
+  }
+  return ELEMENT_OTHER;
+}
+
+bool isBlank(const char c)
+{
+  return ' ' == c || '\t' == c || '\n' == c || '\r' == c;
+}
+
+// Names with other characters than these are left to libxml.
+bool isNameStartChar(const char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || '_' == c || ':' == c;
+}
+
+bool isNameChar(const char c)
+{
+  return isNameStartChar(c) || (c >= '0' && c <= '9') || '-' == c || '.' == c;
+}
+
+bool isXmlChar(const unsigned long c)
+{
+  return 0x9 == c || 0xa == c || 0xd == c || (c >= 0x20 && c <= 0xd7ff)
+         || (c >= 0xe000 && c <= 0xfffd) || (c >= 0x10000 && c <= 0x10ffff);
+}
+
+void appendUTF8(std::string &text, const unsigned long c)
+{
+  if (c < 0x80)
+    text.push_back(char(c));
+  else if (c < 0x800)
+  {
+    text.push_back(char(0xc0 | (c >> 6)));
+    text.push_back(char(0x80 | (c & 0x3f)));
+  }
+  else if (c < 0x10000)
+  {
+    text.push_back(char(0xe0 | (c >> 12)));
+    text.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+    text.push_back(char(0x80 | (c & 0x3f)));
+  }
+  else
+  {
+    text.push_back(char(0xf0 | (c >> 18)));
+    text.push_back(char(0x80 | ((c >> 12) & 0x3f)));
+    text.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+    text.push_back(char(0x80 | (c & 0x3f)));
+  }
+}
+
+/* Returns the length of the UTF-8 sequence that starts with a non-ASCII
+ * byte at @a pos, 0 if it is not a character XML allows, or -1 if it
+ * does not end before @a end.
+ */
+int getCharLength(const char *const pos, const char *const end)
+{
+  const unsigned char first = (unsigned char) *pos;
+  int length = 0;
+  unsigned long c = 0;
+  if (first < 0xc2)
+    return 0;
+  else if (first < 0xe0)
+  {
+    length = 2;
+    c = first & 0x1f;
+  }
+  else if (first < 0xf0)
+  {
+    length = 3;
+    c = first & 0x0f;
+  }
+  else if (first < 0xf5)
+  {
+    length = 4;
+    c = first & 0x07;
+  }
+  else
+    return 0;
+  if (end - pos < length)
+    return -1;
+  for (int i = 1; i < length; ++i)
+  {
+    const unsigned char next = (unsigned char) pos[i];
+    if (0x80 != (next & 0xc0))
+      return 0;
+    c = (c << 6) | (next & 0x3f);
+  }
+  // overlong sequences
+  if ((3 == length && c < 0x800) || (4 == length && c < 0x10000))
+    return 0;
+  return isXmlChar(c) ? length : 0;
+}
+
+/* Returns the first character in [pos, end) that cannot be taken as it
+ * is: @a stop, '<', '&', ']', a control character other than a tab or a
+ * line feed, or the first byte of a UTF-8 sequence. Tabs and line feeds
+ * are returned too if @a withBlanks is set.
+ */
+const char *findSpecial(const char *pos, const char *const end, const char stop, const bool withBlanks)
+{
+#if defined __SSE2__ && defined __GNUC__
+  {
+    const __m128i stops = _mm_set1_epi8(stop);
+    const __m128i lessThans = _mm_set1_epi8('<');
+    const __m128i ampersands = _mm_set1_epi8('&');
+    const __m128i brackets = _mm_set1_epi8(']');
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i lineFeeds = _mm_set1_epi8('\n');
+    const __m128i allowedBlanks = withBlanks ? _mm_setzero_si128() : _mm_set1_epi8(char(0xff));
+    for (; end - pos >= 16; pos += 16)
+    {
+      const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+      // as signed bytes, everything from 0x80 on is less than a space too
+      const __m128i blanks = _mm_and_si128(allowedBlanks, _mm_or_si128(_mm_cmpeq_epi8(current, tabs), _mm_cmpeq_epi8(current, lineFeeds)));
+      const __m128i found = _mm_or_si128(
+                              _mm_or_si128(_mm_cmpeq_epi8(current, stops), _mm_cmpeq_epi8(current, lessThans)),
+                              _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(current, ampersands), _mm_cmpeq_epi8(current, brackets)),
+                                           _mm_andnot_si128(blanks, _mm_cmplt_epi8(current, spaces))));
+      const int mask = _mm_movemask_epi8(found);
+      if (mask)
+        return pos + __builtin_ctz(unsigned(mask));
+    }
+  }
+#endif
+  for (; pos != end; ++pos)
+  {
+    const unsigned char c = (unsigned char) *pos;
+    if (c == (unsigned char) stop || '<' == c || '&' == c || ']' == c || c >= 0x80
+        || (c < 0x20 && (withBlanks || ('\t' != c && '\n' != c))))
+      return pos;
+  }
+  return end;
+}
+
+} // anonymous namespace
+
+ABWStylesScanner::ABWStylesScanner(librevenge::RVNGInputStream *const input, ABWStylesCollector &collector)
+  : m_input(input)
+  , m_collector(collector)
+  , m_sectionOffsets(0)
+  , m_buffer()
+  , m_pos(0)
+  , m_offset(0)
+  , m_isAtStart(true)
+  , m_elementNames()
+  , m_elementStarts()
+  , m_hasRoot(false)
+  , m_hasDoctype(false)
+  , m_textLength(0)
+  , m_skipDepth(0)
+  , m_attributes()
+  , m_attributeCount(0)
+  , m_isInData(false)
+  , m_hasDataName(false)
+  , m_dataName()
+  , m_dataMimeType()
+  , m_isDataBase64(false)
+  , m_dataText()
+  , m_hasDataCData(false)
+  , m_dataTrailer()
+{
+}
+
+bool ABWStylesScanner::scan(std::vector<unsigned long> *const sectionOffsets)
+{
+  if (!m_input)
+    return false;
+
+  m_sectionOffsets = sectionOffsets;
+  if (!readMore())
+    return false;
+  // a byte order mark is only allowed for UTF-8
+  if (m_buffer.size() >= 3 && !memcmp(&m_buffer[0], "\xef\xbb\xbf", 3))
+    m_pos = 3;
+
+  while (true)
+  {
+    Status status = STATUS_MORE;
+    if (m_pos != m_buffer.size())
+    {
+      const char *const begin = &m_buffer[0];
+      const char *const end = begin + m_buffer.size();
+      const unsigned long position = m_offset + (unsigned long) m_pos;
+      if ('<' == begin[m_pos])
+        status = scanMarkup(begin, end);
+      else
+        status = scanText(begin, end);
+      if (m_offset + m_pos != position)
+        m_isAtStart = false;
+    }
+    if (STATUS_FAILED == status)
+      return false;
+    if (STATUS_MORE == status && !readMore())
+      break;
+  }
+  return m_pos == m_buffer.size() && m_hasRoot && m_elementStarts.empty();
+}
+
+bool ABWStylesScanner::readMore()
+{
+  // what has been scanned is not needed any more
+  if (m_pos)
+  {
+    m_buffer.erase(m_buffer.begin(), m_buffer.begin() + std::ptrdiff_t(m_pos));
+    m_offset += (unsigned long) m_pos;
+    m_pos = 0;
+  }
+  if (m_input->isEnd())
+    return false;
+  // a long tag is read again from its start every time, so the reads
+  // get longer with it
+  unsigned long numBytesRead = 0;
+  const unsigned char *const data = m_input->read(std::max<unsigned long>(65536, (unsigned long) m_buffer.size()), numBytesRead);
+  if (!data || !numBytesRead)
+    return false;
+  m_buffer.insert(m_buffer.end(), data, data + numBytesRead);
+  return true;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanChars(const char *&pos, const char *const end, const char stop,
+                                                     std::string *const decoded, const bool isAttribute)
+{
+  while (true)
+  {
+    const char *const special = findSpecial(pos, end, stop, isAttribute && decoded);
+    if (decoded)
+      decoded->append(pos, special);
+    pos = special;
+    if (pos == end)
+      return STATUS_MORE;
+    const char c = *pos;
+    if (stop == c)
+      return STATUS_DONE;
+    switch (c)
+    {
+    case '<':
+      return STATUS_FAILED;
+    case '&':
+    {
+      const Status status = scanReference(pos, end, decoded);
+      if (STATUS_DONE != status)
+        return status;
+      break;
+    }
+    case ']':
+      if (!isAttribute)
+      {
+        if (end - pos < 3)
+          return STATUS_MORE;
+        if (']' == pos[1] && '>' == pos[2])
+          return STATUS_FAILED;
+      }
+      if (decoded)
+        decoded->push_back(c);
+      ++pos;
+      break;
+    // line breaks are normalized to line feeds, and white space in
+    // attribute values to spaces
+    case '\r':
+      if (end - pos < 2)
+        return STATUS_MORE;
+      if (decoded)
+        decoded->push_back(isAttribute ? ' ' : '\n');
+      pos += '\n' == pos[1] ? 2 : 1;
+      break;
+    case '\t':
+    case '\n':
+      if (decoded)
+        decoded->push_back(isAttribute ? ' ' : c);
+      ++pos;
+      break;
+    default:
+    {
+      if ((unsigned char) c < 0x80)
+        return STATUS_FAILED;
+      const int length = getCharLength(pos, end);
+      if (length < 0)
+        return STATUS_MORE;
+      if (!length)
+        return STATUS_FAILED;
+      if (decoded)
+        decoded->append(pos, std::size_t(length));
+      pos += length;
+      break;
+    }
+    }
+  }
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanReference(const char *&pos, const char *const end, std::string *const decoded)
+{
+  // the longest reference that is not padded with zeros is &#1114111;
+  const std::size_t maxLength = 32;
+  const char *const semicolon = static_cast<const char *>(memchr(pos, ';', std::min<std::size_t>(std::size_t(end - pos), maxLength)));
+  if (!semicolon)
+    return std::size_t(end - pos) < maxLength ? STATUS_MORE : STATUS_FAILED;
+
+  const char *const name = pos + 1;
+  const std::size_t length = std::size_t(semicolon - name);
+  unsigned long c = 0;
+  if (length > 1 && '#' == name[0])
+  {
+    const bool isHex = 'x' == name[1];
+    const char *digit = name + (isHex ? 2 : 1);
+    if (digit == semicolon)
+      return STATUS_FAILED;
+    for (; digit != semicolon; ++digit)
+    {
+      unsigned long value = 0;
+      if (*digit >= '0' && *digit <= '9')
+        value = (unsigned long)(*digit - '0');
+      else if (isHex && *digit >= 'a' && *digit <= 'f')
+        value = (unsigned long)(*digit - 'a' + 10);
+      else if (isHex && *digit >= 'A' && *digit <= 'F')
+        value = (unsigned long)(*digit - 'A' + 10);
+      else
+        return STATUS_FAILED;
+      c = c * (isHex ? 16 : 10) + value;
+      if (c > 0x10ffff)
+        return STATUS_FAILED;
+    }
+    if (!isXmlChar(c))
+      return STATUS_FAILED;
+  }
+  else if (2 == length && !memcmp(name, "lt", 2))
+    c = '<';
+  else if (2 == length && !memcmp(name, "gt", 2))
+    c = '>';
+  else if (3 == length && !memcmp(name, "amp", 3))
+    c = '&';
+  else if (4 == length && !memcmp(name, "apos", 4))
+    c = '\'';
+  else if (4 == length && !memcmp(name, "quot", 4))
+    c = '"';
+  else
+    // entities would have to be declared in the DTD
+    return STATUS_FAILED;
+
+  if (decoded)
+    appendUTF8(*decoded, c);
+  pos = semicolon + 1;
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::checkChars(const char *&pos, const char *const end, const char stop)
+{
+  while (true)
+  {
+    pos = findSpecial(pos, end, stop, false);
+    if (pos == end)
+      return STATUS_MORE;
+    const char c = *pos;
+    if (stop == c)
+      return STATUS_DONE;
+    if ('<' == c || '&' == c || ']' == c || '\r' == c)
+      ++pos;
+    else if ((unsigned char) c < 0x80)
+      return STATUS_FAILED;
+    else
+    {
+      const int length = getCharLength(pos, end);
+      if (length < 0)
+        return STATUS_MORE;
+      if (!length)
+        return STATUS_FAILED;
+      pos += length;
+    }
+  }
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanText(const char *const begin, const char *const end)
+{
+  const char *pos = begin + m_pos;
+  if (m_elementStarts.empty())
+  {
+    // only white space may come before and after the root element
+    while (pos != end && isBlank(*pos))
+      ++pos;
+    m_pos = std::size_t(pos - begin);
+    if (pos == end)
+      return STATUS_MORE;
+    return '<' == *pos ? STATUS_DONE : STATUS_FAILED;
+  }
+
+  const char *const start = pos;
+  std::string *decoded = 0;
+  if (m_isInData)
+    decoded = m_hasDataCData ? &m_dataTrailer : &m_dataText;
+  const Status status = scanChars(pos, end, '<', decoded, false);
+  m_pos = std::size_t(pos - begin);
+  m_textLength += std::size_t(pos - start);
+  if (m_textLength > MAX_TEXT_LENGTH)
+    return STATUS_FAILED;
+  if (m_isInData && m_hasDataCData && std::string::npos != m_dataTrailer.find_first_not_of(" \t\n\r"))
+    return STATUS_FAILED;
+  return status;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanMarkup(const char *const begin, const char *const end)
+{
+  const char *const pos = begin + m_pos;
+  if (end - pos < 2)
+    return STATUS_MORE;
+  m_textLength = 0;
+  switch (pos[1])
+  {
+  case '/':
+    return scanEndTag(begin, end);
+  case '?':
+    return scanProcessingInstruction(begin, end);
+  case '!':
+    if (end - pos < 4)
+      return STATUS_MORE;
+    if ('-' == pos[2] && '-' == pos[3])
+      return scanComment(begin, end);
+    if (end - pos < 9)
+      return STATUS_MORE;
+    if (!memcmp(pos + 2, "DOCTYPE", 7))
+      return scanDoctype(begin, end);
+    if (!memcmp(pos + 2, "[CDATA[", 7))
+      return scanCData(begin, end);
+    return STATUS_FAILED;
+  default:
+    return scanStartTag(begin, end);
+  }
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanStartTag(const char *const begin, const char *const end)
+{
+  const char *pos = begin + m_pos + 1;
+  const char *const name = pos;
+  if (pos == end)
+    return STATUS_MORE;
+  if (!isNameStartChar(*pos))
+    return STATUS_FAILED;
+  while (pos != end && isNameChar(*pos))
+    ++pos;
+  if (pos == end)
+    return STATUS_MORE;
+  const std::size_t nameLength = std::size_t(pos - name);
+  // elements in namespaces are not looked for
+  if (nameLength > MAX_NAME_LENGTH || memchr(name, ':', nameLength))
+    return STATUS_FAILED;
+  // there is only one root element, and <d> contains only text
+  if ((m_hasRoot && m_elementStarts.empty()) || m_isInData || m_elementStarts.size() >= MAX_DEPTH)
+    return STATUS_FAILED;
+
+  const Element element = getElement(name, nameLength);
+  const bool isRead = !m_skipDepth && ELEMENT_OTHER != element && ELEMENT_IGNORED != element;
+  const Status status = scanAttributes(pos, end, isRead);
+  if (STATUS_DONE != status)
+    return status;
+  bool isEmpty = false;
+  if ('/' == *pos)
+  {
+    if (end - pos < 2)
+      return STATUS_MORE;
+    if ('>' != pos[1])
+      return STATUS_FAILED;
+    isEmpty = true;
+    pos += 2;
+  }
+  else if ('>' == *pos)
+    ++pos;
+  else
+    return STATUS_FAILED;
+
+  const unsigned long offset = m_offset + (unsigned long) m_pos;
+  m_pos = std::size_t(pos - begin);
+  m_hasRoot = true;
+  if (!isEmpty)
+  {
+    m_elementStarts.push_back(m_elementNames.size());
+    m_elementNames.append(name, nameLength);
+  }
+  if (!m_skipDepth)
+    startElement(element, isEmpty, offset);
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanEndTag(const char *const begin, const char *const end)
+{
+  const char *pos = begin + m_pos + 2;
+  const char *const name = pos;
+  while (pos != end && isNameChar(*pos))
+    ++pos;
+  const std::size_t nameLength = std::size_t(pos - name);
+  while (pos != end && isBlank(*pos))
+    ++pos;
+  if (pos == end)
+    return STATUS_MORE;
+  if ('>' != *pos || m_elementStarts.empty())
+    return STATUS_FAILED;
+  const std::size_t start = m_elementStarts.back();
+  if (m_elementNames.size() - start != nameLength || m_elementNames.compare(start, nameLength, name, nameLength))
+    return STATUS_FAILED;
+
+  m_elementStarts.pop_back();
+  m_elementNames.resize(start);
+  m_pos = std::size_t(pos + 1 - begin);
+  if (m_skipDepth)
+  {
+    if (m_elementStarts.size() < m_skipDepth)
+      m_skipDepth = 0;
+    return STATUS_DONE;
+  }
+  endElement(getElement(name, nameLength));
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanXmlDeclaration(const char *const begin, const char *const end)
+{
+  const char *pos = begin + m_pos + 5;
+  const Status status = scanAttributes(pos, end, true);
+  if (STATUS_DONE != status)
+    return status;
+  if ('?' != *pos)
+    return STATUS_FAILED;
+  if (end - pos < 2)
+    return STATUS_MORE;
+  if ('>' != pos[1])
+    return STATUS_FAILED;
+
+  // libxml would read the document in another encoding than UTF-8
+  std::size_t i = 0;
+  if (i == m_attributeCount || "version" != m_attributes[i++].first)
+    return STATUS_FAILED;
+  if (i < m_attributeCount && "encoding" == m_attributes[i].first)
+  {
+    if (!boost::algorithm::iequals(m_attributes[i].second, "UTF-8"))
+      return STATUS_FAILED;
+    ++i;
+  }
+  if (i < m_attributeCount && "standalone" == m_attributes[i].first)
+  {
+    if ("yes" != m_attributes[i].second && "no" != m_attributes[i].second)
+      return STATUS_FAILED;
+    ++i;
+  }
+  if (i != m_attributeCount)
+    return STATUS_FAILED;
+
+  m_pos = std::size_t(pos + 2 - begin);
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanProcessingInstruction(const char *const begin, const char *const end)
+{
+  const char *pos = begin + m_pos + 2;
+  const char *const target = pos;
+  if (pos == end)
+    return STATUS_MORE;
+  if (!isNameStartChar(*pos))
+    return STATUS_FAILED;
+  while (pos != end && isNameChar(*pos))
+    ++pos;
+  if (pos == end)
+    return STATUS_MORE;
+  if (3 == pos - target && boost::algorithm::iequals(std::string(target, 3), "xml"))
+  {
+    // the XML declaration is only allowed at the start
+    if (m_isAtStart && !memcmp(target, "xml", 3))
+      return scanXmlDeclaration(begin, end);
+    return STATUS_FAILED;
+  }
+  if (m_isInData || ('?' != *pos && !isBlank(*pos)))
+    return STATUS_FAILED;
+
+  while (true)
+  {
+    const Status status = checkChars(pos, end, '?');
+    if (STATUS_DONE != status)
+      return status;
+    if (end - pos < 2)
+      return STATUS_MORE;
+    if ('>' == pos[1])
+      break;
+    ++pos;
+  }
+  m_pos = std::size_t(pos + 2 - begin);
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanComment(const char *const begin, const char *const end)
+{
+  if (m_isInData)
+    return STATUS_FAILED;
+  const char *pos = begin + m_pos + 4;
+  while (true)
+  {
+    const Status status = checkChars(pos, end, '-');
+    if (STATUS_DONE != status)
+      return status;
+    if (end - pos < 3)
+      return STATUS_MORE;
+    // "--" may only end the comment
+    if ('-' == pos[1])
+    {
+      if ('>' != pos[2])
+        return STATUS_FAILED;
+      break;
+    }
+    ++pos;
+  }
+  m_pos = std::size_t(pos + 3 - begin);
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanCData(const char *const begin, const char *const end)
+{
+  // AbiWord writes SVG pictures as CDATA; any other use is left to libxml
+  if (!m_isInData || m_hasDataCData || std::string::npos != m_dataText.find_first_not_of(" \t\n\r"))
+    return STATUS_FAILED;
+  m_dataText.clear();
+  const char *pos = begin + m_pos + 9;
+  while (true)
+  {
+    const char *const special = findSpecial(pos, end, ']', false);
+    m_dataText.append(pos, special);
+    pos = special;
+    if (pos == end)
+      return STATUS_MORE;
+    const char c = *pos;
+    if (']' == c)
+    {
+      if (end - pos < 3)
+        return STATUS_MORE;
+      if (']' == pos[1] && '>' == pos[2])
+        break;
+      m_dataText.push_back(c);
+      ++pos;
+    }
+    // unlike in text, libxml keeps carriage returns in CDATA sections
+    else if ('<' == c || '&' == c || '\r' == c)
+    {
+      m_dataText.push_back(c);
+      ++pos;
+    }
+    else if ((unsigned char) c < 0x80)
+      return STATUS_FAILED;
+    else
+    {
+      const int length = getCharLength(pos, end);
+      if (length < 0)
+        return STATUS_MORE;
+      if (!length)
+        return STATUS_FAILED;
+      m_dataText.append(pos, std::size_t(length));
+      pos += length;
+    }
+  }
+  // libxml would take even white space only from a CDATA section
+  if (m_dataText.size() > MAX_TEXT_LENGTH || std::string::npos == m_dataText.find_first_not_of(" \t\n\r"))
+    return STATUS_FAILED;
+  m_hasDataCData = true;
+  m_pos = std::size_t(pos + 3 - begin);
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanDoctype(const char *const begin, const char *const end)
+{
+  if (m_hasRoot || m_hasDoctype)
+    return STATUS_FAILED;
+  const char *pos = begin + m_pos + 9;
+  if (pos == end)
+    return STATUS_MORE;
+  if (!isBlank(*pos))
+    return STATUS_FAILED;
+  char quote = 0;
+  for (; pos != end; ++pos)
+  {
+    const char c = *pos;
+    if ((unsigned char) c >= 0x80 || ((unsigned char) c < 0x20 && !isBlank(c)))
+      return STATUS_FAILED;
+    if (quote)
+    {
+      if (quote == c)
+        quote = 0;
+    }
+    else if ('"' == c || '\'' == c)
+      quote = c;
+    else if ('>' == c)
+      break;
+    // the internal subset may declare entities
+    else if ('[' == c)
+      return STATUS_FAILED;
+  }
+  if (pos == end)
+    return STATUS_MORE;
+  m_hasDoctype = true;
+  m_pos = std::size_t(pos + 1 - begin);
+  return STATUS_DONE;
+}
+
+ABWStylesScanner::Status ABWStylesScanner::scanAttributes(const char *&pos, const char *const end, const bool keepValues)
+{
+  m_attributeCount = 0;
+  while (true)
+  {
+    const char *const previous = pos;
+    while (pos != end && isBlank(*pos))
+      ++pos;
+    if (pos == end)
+      return STATUS_MORE;
+    if ('>' == *pos || '/' == *pos || '?' == *pos)
+      return STATUS_DONE;
+    // attributes have to be separated by white space
+    if (pos == previous || !isNameStartChar(*pos))
+      return STATUS_FAILED;
+
+    const char *const name = pos;
+    while (pos != end && isNameChar(*pos))
+      ++pos;
+    const std::size_t nameLength = std::size_t(pos - name);
+    while (pos != end && isBlank(*pos))
+      ++pos;
+    if (pos == end)
+      return STATUS_MORE;
+    if ('=' != *pos)
+      return STATUS_FAILED;
+    ++pos;
+    while (pos != end && isBlank(*pos))
+      ++pos;
+    if (pos == end)
+      return STATUS_MORE;
+    const char quote = *pos;
+    if ('"' != quote && '\'' != quote)
+      return STATUS_FAILED;
+    ++pos;
+
+    if (m_attributes.size() == m_attributeCount)
+      m_attributes.push_back(std::pair<std::string, std::string>());
+    std::pair<std::string, std::string> &attribute = m_attributes[m_attributeCount];
+    attribute.first.assign(name, nameLength);
+    attribute.second.clear();
+    const char *const value = pos;
+    const Status status = scanChars(pos, end, quote, keepValues ? &attribute.second : 0, true);
+    if (STATUS_DONE != status)
+      return status;
+    if (nameLength > MAX_NAME_LENGTH || std::size_t(pos - value) > MAX_TEXT_LENGTH)
+      return STATUS_FAILED;
+    ++pos;
+
+    // Attributes in namespaces are the same if their local names are
+    // the same and the prefixes stand for the same namespace. That is
+    // not checked, so all of them with the same local name are left to
+    // libxml.
+    const std::size_t colon = attribute.first.find(':');
+    for (std::size_t i = 0; i < m_attributeCount; ++i)
+    {
+      const std::string &other = m_attributes[i].first;
+      if (other == attribute.first)
+        return STATUS_FAILED;
+      const std::size_t otherColon = other.find(':');
+      if (std::string::npos != colon && std::string::npos != otherColon
+          && !other.compare(otherColon, std::string::npos, attribute.first, colon, std::string::npos))
+        return STATUS_FAILED;
+    }
+    ++m_attributeCount;
+  }
+}
+
+void ABWStylesScanner::startElement(const int element, const bool isEmpty, const unsigned long offset)
+{
+  switch (element)
+  {
+  case ELEMENT_CELL:
+    m_collector.openCell(getAttribute("props"));
+    if (isEmpty)
+      m_collector.closeCell();
+    break;
+  case ELEMENT_D:
+  {
+    // an empty <d/> has no data
+    if (isEmpty)
+      break;
+    const char *const name = getAttribute("name");
+    const char *const mimeType = getAttribute("mime-type");
+    const char *const base64 = getAttribute("base64");
+    m_hasDataName = 0 != name;
+    m_dataName = name ? name : "";
+    m_dataMimeType = mimeType ? mimeType : "";
+    m_isDataBase64 = false;
+    if (base64)
+      findBool(base64, m_isDataBase64);
+    m_dataText.clear();
+    m_hasDataCData = false;
+    m_dataTrailer.clear();
+    m_isInData = true;
+    break;
+  }
+  case ELEMENT_L:
+  {
+    const char *const listDecimal = getAttribute("list-decimal");
+    m_collector.collectList(getAttribute("id"), listDecimal ? listDecimal : "NULL", getAttribute("list-delim"),
+                            getAttribute("parentid"), getAttribute("start-value"), getAttribute("type"));
+    break;
+  }
+  case ELEMENT_P:
+    // the list id is taken for the parent id, as ABWParser::readP does
+    m_collector.collectParagraphProperties(getAttribute("level"), getAttribute("listid"), getAttribute("listid"),
+                                           getAttribute("style"), getAttribute("props"));
+    break;
+  case ELEMENT_SECTION:
+  {
+    const char *const type = getAttribute("type");
+    if (!type || (strncmp(type, "header", 6) && strncmp(type, "footer", 6)))
+    {
+      if (m_sectionOffsets)
+        m_sectionOffsets->push_back(offset);
+      m_collector.collectSectionProperties(getAttribute("footer"), getAttribute("footer-even"),
+                                           getAttribute("footer-first"), getAttribute("footer-last"),
+                                           getAttribute("header"), getAttribute("header-even"),
+                                           getAttribute("header-first"), getAttribute("header-last"),
+                                           getAttribute("props"));
+    }
+    else
+      m_collector.collectHeaderFooter(getAttribute("id"), type);
+    break;
+  }
+  case ELEMENT_TABLE:
+    m_collector.openTable(getAttribute("props"));
+    if (isEmpty)
+      m_collector.closeTable();
+    break;
+  case ELEMENT_IGNORED:
+    if (!isEmpty)
+      m_skipDepth = m_elementStarts.size();
+    break;
+  default:
+    break;
+  }
+}
+
+void ABWStylesScanner::endElement(const int element)
+{
+  switch (element)
+  {
+  case ELEMENT_CELL:
+    m_collector.closeCell();
+    break;
+  case ELEMENT_D:
+    m_isInData = false;
+    // libxml does not take text of white space only for a text node
+    if (m_hasDataCData || std::string::npos != m_dataText.find_first_not_of(" \t\n\r"))
+    {
+      ABWData data;
+      data.m_mimeType = m_dataMimeType.c_str();
+      getStoredData(m_dataText.c_str(), m_isDataBase64, data);
+      m_collector.collectData(m_hasDataName ? m_dataName.c_str() : 0, data);
+    }
+    m_dataText.clear();
+    break;
+  case ELEMENT_TABLE:
+    m_collector.closeTable();
+    break;
+  default:
+    break;
+  }
+}
+
+const char *ABWStylesScanner::getAttribute(const char *const name) const
+{
+  for (std::size_t i = 0; i < m_attributeCount; ++i)
+  {
+    if (m_attributes[i].first == name)
+      return m_attributes[i].second.c_str();
+  }
+  return 0;
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWSTYLESSCANNER_H__
+#define __ABWSTYLESSCANNER_H__
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <librevenge-stream/librevenge-stream.h>
+
+namespace libabw
+{
+
+class ABWStylesCollector;
+
+/** Reads what ABWStylesCollector needs from a document without libxml:
+  * the <l>, <p>, <d>, <section>, <table> and <cell> elements. It handles
+  * the plain UTF-8 XML AbiWord writes and gives up on anything else,
+  * e.g., CDATA sections outside of <d>, entities other than the predefined ones,
+  * prefixed element names, a DTD with declarations or anything that is
+  * not well-formed. Such documents have to be read with libxml.
+  */
+class ABWStylesScanner
+{
+public:
+  ABWStylesScanner(librevenge::RVNGInputStream *input, ABWStylesCollector &collector);
+
+  /** Scans the document from the current position of the input stream.
+    * Returns false if it has to be read with libxml; the collector may
+    * have been told about a part of it then.
+    * @param sectionOffsets If set, where the body sections start
+    */
+  bool scan(std::vector<unsigned long> *sectionOffsets);
+
+private:
+  enum Status
+  {
+    STATUS_DONE,
+    STATUS_MORE,
+    STATUS_FAILED
+  };
+
+  ABWStylesScanner(const ABWStylesScanner &);
+  ABWStylesScanner &operator=(const ABWStylesScanner &);
+
+  bool readMore();
+
+  static Status scanChars(const char *&pos, const char *end, char stop, std::string *decoded, bool isAttribute);
+  static Status scanReference(const char *&pos, const char *end, std::string *decoded);
+  static Status checkChars(const char *&pos, const char *end, char stop);
+
+  Status scanText(const char *begin, const char *end);
+  Status scanMarkup(const char *begin, const char *end);
+  Status scanStartTag(const char *begin, const char *end);
+  Status scanEndTag(const char *begin, const char *end);
+  Status scanXmlDeclaration(const char *begin, const char *end);
+  Status scanProcessingInstruction(const char *begin, const char *end);
+  Status scanComment(const char *begin, const char *end);
+  Status scanCData(const char *begin, const char *end);
+  Status scanDoctype(const char *begin, const char *end);
+  Status scanAttributes(const char *&pos, const char *end, bool keepValues);
+
+  void startElement(int element, bool isEmpty, unsigned long offset);
+  void endElement(int element);
+  const char *getAttribute(const char *name) const;
+
+  librevenge::RVNGInputStream *m_input;
+  ABWStylesCollector &m_collector;
+  std::vector<unsigned long> *m_sectionOffsets;
+
+  // the part of the document read, but not scanned yet, starts at m_pos
+  std::vector<char> m_buffer;
+  std::size_t m_pos;
+  // where m_buffer starts in the document
+  unsigned long m_offset;
+  // set until something has been scanned
+  bool m_isAtStart;
+
+  // the names of the open elements, one after another
+  std::string m_elementNames;
+  std::vector<std::size_t> m_elementStarts;
+  bool m_hasRoot;
+  bool m_hasDoctype;
+  // the length of the text since the last markup
+  std::size_t m_textLength;
+  // the number of open elements once the element whose content is
+  // skipped has been opened, or 0
+  std::size_t m_skipDepth;
+
+  // the attributes of the last start tag
+  std::vector<std::pair<std::string, std::string> > m_attributes;
+  std::size_t m_attributeCount;
+
+  // the <d> element being read
+  bool m_isInData;
+  bool m_hasDataName;
+  std::string m_dataName;
+  std::string m_dataMimeType;
+  bool m_isDataBase64;
+  std::string m_dataText;
+  // set if the data are in a CDATA section, which may only be
+  // surrounded by white space
+  bool m_hasDataCData;
+  std::string m_dataTrailer;
+};
+
+} // namespace libabw
+
+#endif /* __ABWSTYLESSCANNER_H__ */
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,212 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef ENABLE_THREADS
+#include <pthread.h>
+#endif
+
+#include "ABWThread.h"
+#include "libabw_internal.h"
+
+namespace libabw
+{
+
+namespace
+{
+
+#ifdef ENABLE_THREADS
+extern "C" void *runTask(void *task)
+{
+  static_cast<ABWTask *>(task)->run();
+  return 0;
+}
+#endif
+
+}
+
+struct ABWThread::Impl
+{
+  Impl();
+
+#ifdef ENABLE_THREADS
+  pthread_t m_thread;
+#endif
+  bool m_isRunning;
+};
+
+ABWThread::Impl::Impl()
+#ifdef ENABLE_THREADS
+  : m_thread()
+  , m_isRunning(false)
+#else
+  : m_isRunning(false)
+#endif
+{
+}
+
+ABWThread::ABWThread()
+  : m_impl(new Impl())
+{
+}
+
+ABWThread::~ABWThread()
+{
+  join();
+}
+
+void ABWThread::start(ABWTask &task)
+{
+  if (tryStart(task))
+    return;
+  ABW_DEBUG_MSG(("ABWThread::start: could not create a thread, running the task here\n"));
+  task.run();
+}
+
+bool ABWThread::tryStart(ABWTask &task)
+{
+  join();
+#ifdef ENABLE_THREADS
+  if (pthread_create(&m_impl->m_thread, 0, runTask, &task) == 0)
+  {
+    m_impl->m_isRunning = true;
+    return true;
+  }
+#else
+  (void)task;
+#endif
+  return false;
+}
+
+void ABWThread::join()
+{
+#ifdef ENABLE_THREADS
+  if (m_impl->m_isRunning)
+    pthread_join(m_impl->m_thread, 0);
+#endif
+  m_impl->m_isRunning = false;
+}
+
+bool ABWThread::isSupported()
+{
+#ifdef ENABLE_THREADS
+  return true;
+#else
+  return false;
+#endif
+}
+
+struct ABWMutex::Impl
+{
+  Impl();
+  ~Impl();
+
+#ifdef ENABLE_THREADS
+  pthread_mutex_t m_mutex;
+#endif
+};
+
+ABWMutex::Impl::Impl()
+#ifdef ENABLE_THREADS
+  : m_mutex()
+#endif
+{
+#ifdef ENABLE_THREADS
+  pthread_mutex_init(&m_mutex, 0);
+#endif
+}
+
+ABWMutex::Impl::~Impl()
+{
+#ifdef ENABLE_THREADS
+  pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+ABWMutex::ABWMutex()
+  : m_impl(new Impl())
+{
+}
+
+ABWMutex::~ABWMutex()
+{
+}
+
+void ABWMutex::lock()
+{
+#ifdef ENABLE_THREADS
+  pthread_mutex_lock(&m_impl->m_mutex);
+#endif
+}
+
+void ABWMutex::unlock()
+{
+#ifdef ENABLE_THREADS
+  pthread_mutex_unlock(&m_impl->m_mutex);
+#endif
+}
+
+struct ABWCondition::Impl
+{
+  Impl();
+  ~Impl();
+
+#ifdef ENABLE_THREADS
+  pthread_cond_t m_condition;
+#endif
+};
+
+ABWCondition::Impl::Impl()
+#ifdef ENABLE_THREADS
+  : m_condition()
+#endif
+{
+#ifdef ENABLE_THREADS
+  pthread_cond_init(&m_condition, 0);
+#endif
+}
+
+ABWCondition::Impl::~Impl()
+{
+#ifdef ENABLE_THREADS
+  pthread_cond_destroy(&m_condition);
+#endif
+}
+
+ABWCondition::ABWCondition()
+  : m_impl(new Impl())
+{
+}
+
+ABWCondition::~ABWCondition()
+{
+}
+
+void ABWCondition::wait(ABWMutex &mutex)
+{
+#ifdef ENABLE_THREADS
+  pthread_cond_wait(&m_impl->m_condition, &mutex.m_impl->m_mutex);
+#else
+  (void)mutex;
+#endif
+}
+
+void ABWCondition::notifyAll()
+{
+#ifdef ENABLE_THREADS
+  pthread_cond_broadcast(&m_impl->m_condition);
+#endif
+}
+
+} // namespace libabw
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef __ABWTHREAD_H__
+#define __ABWTHREAD_H__
+
+#include <boost/scoped_ptr.hpp>
+
+namespace libabw
+{
+
+/** Something to run on an ABWThread. */
+class ABWTask
+{
+public:
+  virtual ~ABWTask() {}
+  virtual void run() = 0;
+};
+
+/** A thread running one task. Without thread support, the task is run
+  * right away in start().
+  */
+class ABWThread
+{
+public:
+  ABWThread();
+  /// Waits for the task to finish.
+  ~ABWThread();
+
+  void start(ABWTask &task);
+  /** Starts the task on a thread of its own. Unlike start(), it does not
+    * run the task if there is no thread for it, but returns false.
+    */
+  bool tryStart(ABWTask &task);
+  void join();
+
+  /// Whether tasks really run in parallel.
+  static bool isSupported();
+
+private:
+  ABWThread(const ABWThread &);
+  ABWThread &operator=(const ABWThread &);
+
+  struct Impl;
+  boost::scoped_ptr<Impl> m_impl;
+};
+
+class ABWCondition;
+
+/** A mutex. Without thread support, it does nothing. */
+class ABWMutex
+{
+  friend class ABWCondition;
+
+public:
+  ABWMutex();
+  ~ABWMutex();
+
+  void lock();
+  void unlock();
+
+private:
+  ABWMutex(const ABWMutex &);
+  ABWMutex &operator=(const ABWMutex &);
+
+  struct Impl;
+  boost::scoped_ptr<Impl> m_impl;
+};
+
+/** Holds a mutex locked while it exists. */
+class ABWMutexLock
+{
+public:
+  explicit ABWMutexLock(ABWMutex &mutex)
+    : m_mutex(mutex)
+  {
+    m_mutex.lock();
+  }
+  ~ABWMutexLock()
+  {
+    m_mutex.unlock();
+  }
+
+private:
+  ABWMutexLock(const ABWMutexLock &);
+  ABWMutexLock &operator=(const ABWMutexLock &);
+
+  ABWMutex &m_mutex;
+};
+
+/** A condition variable, to wait for with a locked ABWMutex. */
+class ABWCondition
+{
+public:
+  ABWCondition();
+  ~ABWCondition();
+
+  void wait(ABWMutex &mutex);
+  void notifyAll();
+
+private:
+  ABWCondition(const ABWCondition &);
+  ABWCondition &operator=(const ABWCondition &);
+
+  struct Impl;
+  boost::scoped_ptr<Impl> m_impl;
+};
+
+} // namespace libabw
+
+#endif // __ABWTHREAD_H__
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
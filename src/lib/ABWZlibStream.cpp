@@ -11,8 +11,12 @@
 #include "ABWZlibStream.h"
 #include <string.h>  // for memcpy
 #include <stdio.h>
+#include "ABWHash.h"
+#include "ABWThread.h"
+#include "libabw_internal.h"
 
 #define BLOCK_SIZE 16384
+#define PIPELINE_BLOCK_SIZE 65536
 
 namespace libabw
 {
@@ -20,7 +24,105 @@ namespace libabw
 namespace
 {
 
-static bool getInflatedBuffer(librevenge::RVNGInputStream *input, std::vector<unsigned char> &buffer)
+/* Stores inflated data in memory until they grow past memoryLimit;
+ * everything from then on goes to a temporary file.
+ */
+class InflatedSink
+{
+public:
+  InflatedSink(std::vector<unsigned char> &buffer, unsigned long memoryLimit)
+    : m_buffer(buffer), m_memoryLimit(memoryLimit), m_size(0), m_file(0) {}
+  ~InflatedSink()
+  {
+    if (m_file)
+      fclose(m_file);
+  }
+
+  bool append(const unsigned char *data, unsigned long length)
+  {
+    if (!m_file && m_memoryLimit && m_size + length > m_memoryLimit)
+    {
+      m_file = tmpfile();
+      if (m_file)
+      {
+        ABW_DEBUG_MSG(("InflatedSink::append: spilling inflated data to a temporary file after %lu bytes\n", m_size));
+        if (!m_buffer.empty() && fwrite(&m_buffer[0], 1, m_buffer.size(), m_file) != m_buffer.size())
+          return false;
+        std::vector<unsigned char>().swap(m_buffer);
+      }
+    }
+    m_size += length;
+    if (m_file)
+      return fwrite(data, 1, length, m_file) == length;
+    m_buffer.insert(m_buffer.end(), data, data + length);
+    return true;
+  }
+
+  unsigned long size() const
+  {
+    return m_size;
+  }
+
+  FILE *release()
+  {
+    FILE *const file = m_file;
+    m_file = 0;
+    return file;
+  }
+
+private:
+  InflatedSink(const InflatedSink &);
+  InflatedSink &operator=(const InflatedSink &);
+
+  std::vector<unsigned char> &m_buffer;
+  const unsigned long m_memoryLimit;
+  unsigned long m_size;
+  FILE *m_file;
+};
+
+/* Drops inflated data that are only hashed. */
+class NullSink
+{
+public:
+  bool append(const unsigned char *, unsigned long)
+  {
+    return true;
+  }
+};
+
+/* Hashes the rest of input with hash and, if it is given, inputHash. */
+static void hashInput(librevenge::RVNGInputStream *input, ABWHash &hash, ABWSha256 *inputHash = 0)
+{
+  while (!input->isEnd())
+  {
+    unsigned long numBytesRead(0);
+    const unsigned char *const p = input->read(BLOCK_SIZE, numBytesRead);
+    if (!p || !numBytesRead)
+      break;
+    hash.update(p, numBytesRead);
+    if (inputHash)
+      inputHash->update(p, numBytesRead);
+  }
+}
+
+static bool isGzip(librevenge::RVNGInputStream *input)
+{
+  if (!input)
+    return false;
+  unsigned long numBytesRead(0);
+  const unsigned char *const p = input->read(2, numBytesRead);
+  const bool gzip = p && numBytesRead == 2 && p[0] == 0x1f && p[1] == 0x8b;
+  input->seek(0, librevenge::RVNG_SEEK_SET);
+  return gzip;
+}
+
+/* Inflates input into sink. If dataHash or contentHash are given, the
+ * compressed or the inflated data are hashed on the way. If dataHash is
+ * given, inputHash may be given too, to hash the input with SHA-256 too.
+ */
+template<class Sink>
+static bool getInflatedBuffer(librevenge::RVNGInputStream *input, Sink &sink,
+                              ABWHash *dataHash = 0, ABWHash *contentHash = 0, ABWSha256 *inputHash = 0)
 {
   int ret;
   z_stream strm;
@@ -43,6 +145,10 @@ static bool getInflatedBuffer(librevenge::RVNGInputStream *input, std::vector<un
     strm.avail_in = uInt(numBytesRead);
     if (!strm.avail_in)
       break;
+    if (dataHash)
+      dataHash->update(p, numBytesRead);
+    if (inputHash)
+      inputHash->update(p, numBytesRead);
     memcpy(in, p, strm.avail_in);
     strm.next_in = in;
 
@@ -62,14 +168,22 @@ static bool getInflatedBuffer(librevenge::RVNGInputStream *input, std::vector<un
       default:
         break;
       }
-      for (unsigned i = 0; i < BLOCK_SIZE - strm.avail_out; ++i)
-        buffer.push_back(out[i]);
+      if (contentHash)
+        contentHash->update(out, BLOCK_SIZE - strm.avail_out);
+      if (!sink.append(out, BLOCK_SIZE - strm.avail_out))
+      {
+        (void)inflateEnd(&strm);
+        return false;
+      }
     }
     while (!strm.avail_out);
   }
   while (Z_STREAM_END != ret);
 
   (void)inflateEnd(&strm);
+  // anything after the compressed data is a part of the input too
+  if (dataHash && Z_STREAM_END == ret)
+    hashInput(input, *dataHash, inputHash);
   input->seek(0, librevenge::RVNG_SEEK_SET);
   if (Z_STREAM_END == ret)
     return true;
@@ -78,13 +192,169 @@ static bool getInflatedBuffer(librevenge::RVNGInputStream *input, std::vector<un
 
 }
 
-ABWZlibStream::ABWZlibStream(librevenge::RVNGInputStream *input) :
+/* Inflated data of a pipelined stream. They are stored in blocks that
+ * never move, so the reader can use the blocks that have been filled
+ * while the inflating thread goes on with the next ones.
+ */
+struct ABWZlibStream::Pipeline : public ABWTask
+{
+  Pipeline(librevenge::RVNGInputStream *input, ABWHash *dataHash, ABWHash *contentHash);
+  ~Pipeline();
+
+  void run();
+
+  /** Waits until at least @a size bytes have been inflated, or until
+    * there will be no more, and returns how many there are. 0 if the
+    * data could not be inflated.
+    */
+  unsigned long waitFor(unsigned long size);
+  const unsigned char *getData(unsigned long offset) const
+  {
+    return m_readerBlocks[offset / PIPELINE_BLOCK_SIZE] + offset % PIPELINE_BLOCK_SIZE;
+  }
+
+  // used by the inflating thread
+  bool append(const unsigned char *data, unsigned long length);
+
+  librevenge::RVNGInputStream *const m_input;
+  // used by the inflating thread until it is done
+  ABWHash *const m_dataHash;
+  ABWHash *const m_contentHash;
+
+  // shared with the inflating thread, guarded by m_mutex
+  ABWMutex m_mutex;
+  ABWCondition m_condition;
+  std::vector<unsigned char *> m_blocks;
+  unsigned long m_size;
+  bool m_isDone;
+  bool m_isOk;
+  bool m_isCancelled;
+
+  // the state seen by the reader
+  std::vector<unsigned char *> m_readerBlocks;
+  unsigned long m_readerSize;
+  bool m_isReaderDone;
+
+  ABWThread m_thread;
+
+private:
+  Pipeline(const Pipeline &);
+  Pipeline &operator=(const Pipeline &);
+};
+
+ABWZlibStream::Pipeline::Pipeline(librevenge::RVNGInputStream *const input, ABWHash *const dataHash, ABWHash *const contentHash)
+  : ABWTask()
+  , m_input(input)
+  , m_dataHash(dataHash)
+  , m_contentHash(contentHash)
+  , m_mutex()
+  , m_condition()
+  , m_blocks()
+  , m_size(0)
+  , m_isDone(false)
+  , m_isOk(false)
+  , m_isCancelled(false)
+  , m_readerBlocks()
+  , m_readerSize(0)
+  , m_isReaderDone(false)
+  , m_thread()
+{
+}
+
+ABWZlibStream::Pipeline::~Pipeline()
+{
+  {
+    ABWMutexLock lock(m_mutex);
+    m_isCancelled = true;
+  }
+  m_thread.join();
+  for (std::vector<unsigned char *>::iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+    delete[] *iter;
+}
+
+void ABWZlibStream::Pipeline::run()
+{
+  const bool ok = getInflatedBuffer(m_input, *this, m_dataHash, m_contentHash);
+  ABWMutexLock lock(m_mutex);
+  m_isOk = ok;
+  m_isDone = true;
+  m_condition.notifyAll();
+}
+
+bool ABWZlibStream::Pipeline::append(const unsigned char *data, unsigned long length)
+{
+  // Only this thread changes the blocks and the size, so it can read
+  // them without locking. The reader does not look past m_size.
+  unsigned long size = m_size;
+  std::vector<unsigned char *> newBlocks;
+  while (length)
+  {
+    const unsigned long offset = size % PIPELINE_BLOCK_SIZE;
+    unsigned char *block = 0;
+    if (!offset)
+    {
+      block = new unsigned char[PIPELINE_BLOCK_SIZE];
+      newBlocks.push_back(block);
+    }
+    else
+      block = m_blocks.back();
+    const unsigned long count = length < PIPELINE_BLOCK_SIZE - offset ? length : PIPELINE_BLOCK_SIZE - offset;
+    memcpy(block + offset, data, count);
+    data += count;
+    length -= count;
+    size += count;
+  }
+
+  ABWMutexLock lock(m_mutex);
+  m_blocks.insert(m_blocks.end(), newBlocks.begin(), newBlocks.end());
+  m_size = size;
+  m_condition.notifyAll();
+  return !m_isCancelled;
+}
+
+unsigned long ABWZlibStream::Pipeline::waitFor(const unsigned long size)
+{
+  if (m_isReaderDone || m_readerSize >= size)
+    return m_readerSize;
+
+  ABWMutexLock lock(m_mutex);
+  while (!m_isDone && m_size < size)
+    m_condition.wait(m_mutex);
+  m_readerBlocks.insert(m_readerBlocks.end(), m_blocks.begin() + long(m_readerBlocks.size()), m_blocks.end());
+  m_readerSize = m_size;
+  if (m_isDone)
+  {
+    m_isReaderDone = true;
+    if (!m_isOk)
+    {
+      ABW_DEBUG_MSG(("ABWZlibStream::Pipeline::waitFor: the data could not be inflated\n"));
+      m_readerSize = 0;
+    }
+  }
+  return m_readerSize;
+}
+
+ABWZlibStream::ABWZlibStream(librevenge::RVNGInputStream *input, unsigned long memoryLimit, bool pipelined,
+                             bool fingerprinted) :
   librevenge::RVNGInputStream(),
   m_input(0),
   m_offset(0),
-  m_buffer()
+  m_size(0),
+  m_buffer(),
+  m_file(0),
+  m_dataHash(fingerprinted ? new ABWHash() : 0),
+  m_contentHash(fingerprinted ? new ABWHash() : 0),
+  m_pipeline()
 {
-  if (!getInflatedBuffer(input, m_buffer))
+  if (pipelined && !memoryLimit && ABWThread::isSupported() && isGzip(input))
+  {
+    m_pipeline.reset(new Pipeline(input, m_dataHash.get(), m_contentHash.get()));
+    m_pipeline->m_thread.start(*m_pipeline);
+    return;
+  }
+
+  InflatedSink sink(m_buffer, memoryLimit);
+  if (!getInflatedBuffer(input, sink, m_dataHash.get(), m_contentHash.get()))
   {
     if (input)
     {
@@ -94,6 +364,75 @@ ABWZlibStream::ABWZlibStream(librevenge::RVNGInputStream *input) :
     else
       m_buffer.clear();
   }
+  else
+  {
+    m_size = sink.size();
+    m_file = sink.release();
+  }
+}
+
+ABWZlibStream::~ABWZlibStream()
+{
+  m_pipeline.reset();
+  if (m_file)
+    fclose(m_file);
+}
+
+bool ABWZlibStream::fingerprint(librevenge::RVNGInputStream *const input, std::string &dataDigest, std::string &contentDigest,
+                                ABWSha256 *const inputHash)
+{
+  if (!input)
+    return false;
+  input->seek(0, librevenge::RVNG_SEEK_SET);
+  ABWHash dataHash;
+  ABWHash contentHash;
+  ABWSha256 inflatedInputHash;
+  NullSink sink;
+  if (getInflatedBuffer(input, sink, &dataHash, &contentHash, inputHash ? &inflatedInputHash : 0))
+  {
+    dataDigest = dataHash.getDigest();
+    contentDigest = contentHash.getDigest();
+    if (inputHash)
+      *inputHash = inflatedInputHash;
+    return true;
+  }
+
+  // not compressed, or not readable as such
+  input->seek(0, librevenge::RVNG_SEEK_SET);
+  dataHash = ABWHash();
+  hashInput(input, dataHash, inputHash);
+  input->seek(0, librevenge::RVNG_SEEK_SET);
+  dataDigest = contentDigest = dataHash.getDigest();
+  return true;
+}
+
+bool ABWZlibStream::getDigests(std::string &dataDigest, std::string &contentDigest)
+{
+  if (!m_dataHash)
+    return false;
+
+  if (m_input)
+  {
+    // the data are not inflated, so they are hashed only now
+    const long offset = m_input->tell();
+    ABWHash hash;
+    m_input->seek(0, librevenge::RVNG_SEEK_SET);
+    hashInput(m_input, hash);
+    m_input->seek(offset, librevenge::RVNG_SEEK_SET);
+    dataDigest = contentDigest = hash.getDigest();
+    return true;
+  }
+
+  if (m_pipeline)
+  {
+    m_pipeline->waitFor((unsigned long)-1);
+    ABWMutexLock lock(m_pipeline->m_mutex);
+    if (!m_pipeline->m_isOk)
+      return false;
+  }
+  dataDigest = m_dataHash->getDigest();
+  contentDigest = m_contentHash->getDigest();
+  return true;
 }
 
 const unsigned char *ABWZlibStream::read(unsigned long numBytes, unsigned long &numBytesRead)
@@ -106,12 +445,23 @@ const unsigned char *ABWZlibStream::read(unsigned long numBytes, unsigned long &
   if (numBytes == 0)
     return 0;
 
+  if (m_pipeline)
+  {
+    // a read cannot go past the end of a block
+    const unsigned long blockRest = PIPELINE_BLOCK_SIZE - (unsigned long)m_offset % PIPELINE_BLOCK_SIZE;
+    if (numBytes > blockRest)
+      numBytes = blockRest;
+    m_size = m_pipeline->waitFor((unsigned long)m_offset + numBytes);
+    if ((unsigned long)m_offset > m_size)
+      m_offset = (long)m_size;
+  }
+
   unsigned long numBytesToRead;
 
-  if (((unsigned long)m_offset+numBytes) < m_buffer.size())
+  if (((unsigned long)m_offset+numBytes) < m_size)
     numBytesToRead = numBytes;
   else
-    numBytesToRead = m_buffer.size() - (unsigned long)m_offset;
+    numBytesToRead = m_size - (unsigned long)m_offset;
 
   numBytesRead = numBytesToRead; // about as paranoid as we can be..
 
@@ -121,6 +471,22 @@ const unsigned char *ABWZlibStream::read(unsigned long numBytes, unsigned long &
   long oldOffset = m_offset;
   m_offset += numBytesToRead;
 
+  if (m_pipeline)
+    return m_pipeline->getData((unsigned long)oldOffset);
+
+  if (m_file)
+  {
+    // m_buffer only holds the data of the last read
+    m_buffer.resize(numBytesToRead);
+    if (fseek(m_file, oldOffset, SEEK_SET) != 0 || fread(&m_buffer[0], 1, numBytesToRead, m_file) != numBytesToRead)
+    {
+      m_offset = oldOffset;
+      numBytesRead = 0;
+      return 0;
+    }
+    return &m_buffer[0];
+  }
+
   return &m_buffer[size_t(oldOffset)];
 }
 
@@ -134,20 +500,35 @@ int ABWZlibStream::seek(long offset, librevenge::RVNG_SEEK_TYPE seekType)
   else if (seekType == librevenge::RVNG_SEEK_SET)
     m_offset = offset;
 
+  if (m_pipeline && m_offset > 0)
+    m_size = m_pipeline->waitFor((unsigned long)m_offset);
+
   if (m_offset < 0)
   {
     m_offset = 0;
     return 1;
   }
-  if ((long)m_offset > (long)m_buffer.size())
+  if ((long)m_offset > (long)m_size)
   {
-    m_offset = (long) m_buffer.size();
+    m_offset = (long) m_size;
     return 1;
   }
 
   return 0;
 }
 
+unsigned long ABWZlibStream::getSize() const
+{
+  if (!m_input)
+    return m_size;
+
+  const long offset = m_input->tell();
+  m_input->seek(0, librevenge::RVNG_SEEK_END);
+  const long size = m_input->tell();
+  m_input->seek(offset, librevenge::RVNG_SEEK_SET);
+  return size > 0 ? (unsigned long)size : 0;
+}
+
 long ABWZlibStream::tell()
 {
   if (m_input)
@@ -161,7 +542,10 @@ bool ABWZlibStream::isEnd()
   if (m_input)
     return m_input->isEnd();
 
-  if ((long)m_offset >= (long)m_buffer.size())
+  if (m_pipeline)
+    m_size = m_pipeline->waitFor((unsigned long)m_offset + 1);
+
+  if ((long)m_offset >= (long)m_size)
     return true;
 
   return false;
@@ -10,17 +10,44 @@
 #ifndef __ABWZLIBSTREAM_H__
 #define __ABWZLIBSTREAM_H__
 
+#include <stdio.h>
+#include <string>
 #include <vector>
+#include <boost/scoped_ptr.hpp>
 #include <librevenge-stream/librevenge-stream.h>
 
 namespace libabw
 {
 
+class ABWHash;
+class ABWSha256;
+
 class ABWZlibStream : public librevenge::RVNGInputStream
 {
 public:
-  ABWZlibStream(librevenge::RVNGInputStream *input);
-  ~ABWZlibStream() {}
+  /** Inflates @a input if it is gzip compressed. If @a memoryLimit is
+    * not 0, inflated data past that many bytes are kept in a temporary
+    * file instead of in memory. If @a pipelined is set and there is no
+    * memory limit, @a input is inflated on another thread and the data
+    * can be read as soon as they are inflated. If @a fingerprinted is
+    * set, compressed data are hashed while they are inflated.
+    */
+  ABWZlibStream(librevenge::RVNGInputStream *input, unsigned long memoryLimit = 0, bool pipelined = false,
+                bool fingerprinted = false);
+  ~ABWZlibStream();
+
+  /** Hashes @a input and its inflated data, without keeping them.
+    * Returns false if it cannot be read. If @a inputHash is set, @a input
+    * is added to it in the same pass.
+    */
+  static bool fingerprint(librevenge::RVNGInputStream *input, std::string &dataDigest, std::string &contentDigest,
+                          ABWSha256 *inputHash = 0);
+
+  /** Returns the hashes of the input and of the inflated data, like
+    * fingerprint. The stream must have been created fingerprinted.
+    * Waits until all of a pipelined stream has been inflated.
+    */
+  bool getDigests(std::string &dataDigest, std::string &contentDigest);
 
   bool isStructured()
   {
@@ -50,14 +77,21 @@ public:
   int seek(long offset, librevenge::RVNG_SEEK_TYPE seekType);
   long tell();
   bool isEnd();
-  unsigned long getSize() const
-  {
-    return m_buffer.size();
-  }
+  /** Returns the size of the data, or of the data inflated so far if
+    * the stream is pipelined.
+    */
+  unsigned long getSize() const;
+  struct Pipeline;
+
 private:
   librevenge::RVNGInputStream *m_input;
   volatile long m_offset;
+  unsigned long m_size;
   std::vector<unsigned char> m_buffer;
+  FILE *m_file;
+  boost::scoped_ptr<ABWHash> m_dataHash;
+  boost::scoped_ptr<ABWHash> m_contentHash;
+  boost::scoped_ptr<Pipeline> m_pipeline;
   ABWZlibStream(const ABWZlibStream &);
   ABWZlibStream &operator=(const ABWZlibStream &);
 };
@@ -9,6 +9,10 @@
 
 #include <libabw/libabw.h>
 #include "ABWXMLHelper.h"
+#include "ABWDataStore.h"
+#include "ABWDocumentCache.h"
+#include "ABWDocumentHandleImpl.h"
+#include "ABWFingerprintImpl.h"
 #include "ABWParser.h"
 #include "ABWZlibStream.h"
 #include "libabw_internal.h"
@@ -20,6 +24,49 @@ static xmlChar *call_BAD_CAST_OnConst(char const *str)
 {
   return BAD_CAST(const_cast<char *>(str));
 }
+
+/* Collects the whole document into elements. The cache directory of the
+ * options is tried first, and the collected document is kept there. The
+ * digests are taken if the options ask for a fingerprint. If textInterface
+ * is set and the document data are larger than the memory limit, the
+ * document is not collected, but written to textInterface as it is parsed,
+ * and it is not kept.
+ */
+static bool loadDocument(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *textInterface,
+                         const ABWParseOptions &options, boost::shared_ptr<const ABWOutputElements> &elements,
+                         std::string &dataDigest, std::string &contentDigest)
+{
+  const bool isFingerprinted = 0 != options.getFingerprint();
+  ABWDocumentCache cache(options);
+  const bool isCached = cache.isEnabled()
+                        && cache.setDocument(input, isFingerprinted ? &dataDigest : 0, isFingerprinted ? &contentDigest : 0);
+  if (isCached)
+  {
+    elements = cache.load();
+    if (elements)
+      return true;
+  }
+  input->seek(0, librevenge::RVNG_SEEK_SET);
+  // the digests have been taken with the name of the cache file already
+  ABWZlibStream stream(input, options.getMemoryLimit(), options.getPipelinedInflate(), isFingerprinted && !isCached);
+  const unsigned long memoryLimit = options.getMemoryLimit();
+  if (textInterface && memoryLimit && stream.getSize() > memoryLimit)
+  {
+    ABW_DEBUG_MSG(("loadDocument: the document is larger than the memory limit, it is not kept\n"));
+    ABWParser parser(&stream, textInterface, options);
+    if (!parser.parse())
+      return false;
+  }
+  else
+  {
+    ABWParser parser(&stream, 0, options);
+    if (!parser.load(elements))
+      return false;
+    if (isCached)
+      cache.store(*elements);
+  }
+  return !isFingerprinted || isCached || stream.getDigests(dataDigest, contentDigest);
+}
 }
 
 /**
@@ -136,4 +183,144 @@ catch (...)
   return false;
 }
 
+/**
+Parses the input stream content like parse(input, textInterface), with
+settings that change how it is done.
+\param input The input stream
+\param textInterface A librevenge::RVNGTextInterface implementation
+\param options The settings to use
+\return A value that indicates whether the conversion was successful
+*/
+ABWAPI bool libabw::AbiDocument::parse(librevenge::RVNGInputStream *input, librevenge::RVNGTextInterface *textInterface, const ABWParseOptions &options) try
+{
+  ABW_DEBUG_MSG(("AbiDocument::parse: memory limit %lu\n", options.getMemoryLimit()));
+  ABWFingerprint *const fingerprint = options.getFingerprint();
+  if (fingerprint)
+    *fingerprint = ABWFingerprint();
+  if (!input)
+    return false;
+  std::string dataDigest;
+  std::string contentDigest;
+  if (options.getCacheDirectory()[0])
+  {
+    // the document has to be collected to be kept, so it is not streamed
+    // unless it is too large for that
+    boost::shared_ptr<const ABWOutputElements> elements;
+    if (!libabw::loadDocument(input, textInterface, options, elements, dataDigest, contentDigest))
+      return false;
+    if (textInterface && elements)
+      elements->write(textInterface);
+  }
+  else
+  {
+    input->seek(0, librevenge::RVNG_SEEK_SET);
+    libabw::ABWZlibStream stream(input, options.getMemoryLimit(), options.getPipelinedInflate(), 0 != fingerprint);
+    libabw::ABWParser parser(&stream, textInterface, options);
+    if (!parser.parse())
+      return false;
+    if (fingerprint && !stream.getDigests(dataDigest, contentDigest))
+      return false;
+  }
+  if (fingerprint)
+  {
+    fingerprint->m_impl->m_dataDigest = dataDigest;
+    fingerprint->m_impl->m_contentDigest = contentDigest;
+  }
+  return true;
+}
+catch (...)
+{
+  return false;
+}
+
+/**
+Parses the input stream content and keeps the result, so it can be written
+to any number of librevenge::RVNGTextInterface implementations later. If a
+memory limit is set in the options of load(input, options), the body of a
+result larger than that is kept in a temporary file instead of in memory.
+\param input The input stream
+\return The parsed document, owned by the caller, or NULL if the document
+could not be parsed
+*/
+ABWAPI libabw::ABWDocumentHandle *libabw::AbiDocument::load(librevenge::RVNGInputStream *input)
+{
+  return load(input, ABWParseOptions());
+}
+
+/**
+Parses the input stream content like load(input), with settings that change
+how it is done.
+\param input The input stream
+\param options The settings to use
+\return The parsed document, owned by the caller, or NULL if the document
+could not be parsed
+*/
+ABWAPI libabw::ABWDocumentHandle *libabw::AbiDocument::load(librevenge::RVNGInputStream *input, const ABWParseOptions &options) try
+{
+  ABW_DEBUG_MSG(("AbiDocument::load\n"));
+  ABWFingerprint *const fingerprint = options.getFingerprint();
+  if (fingerprint)
+    *fingerprint = ABWFingerprint();
+  if (!input)
+    return 0;
+  boost::shared_ptr<const ABWOutputElements> elements;
+  std::string dataDigest;
+  std::string contentDigest;
+  if (!libabw::loadDocument(input, 0, options, elements, dataDigest, contentDigest))
+    return 0;
+  if (fingerprint)
+  {
+    fingerprint->m_impl->m_dataDigest = dataDigest;
+    fingerprint->m_impl->m_contentDigest = contentDigest;
+  }
+  ABWDocumentHandle::Impl *const impl = new ABWDocumentHandle::Impl();
+  impl->m_elements = elements;
+  return new ABWDocumentHandle(impl);
+}
+catch (...)
+{
+  return 0;
+}
+
+/**
+Hashes the input stream content and, if it is compressed, the inflated
+document, without parsing it. This is the fingerprint that
+ABWParseOptions::setFingerprint gets while a document is parsed.
+\param input The input stream
+\param fingerprint Gets the hashes
+\return Whether the input stream could be read
+*/
+ABWAPI bool libabw::AbiDocument::fingerprint(librevenge::RVNGInputStream *input, ABWFingerprint &fingerprint) try
+{
+  ABW_DEBUG_MSG(("AbiDocument::fingerprint\n"));
+  fingerprint = ABWFingerprint();
+  std::string dataDigest;
+  std::string contentDigest;
+  if (!ABWZlibStream::fingerprint(input, dataDigest, contentDigest))
+    return false;
+  fingerprint.m_impl->m_dataDigest = dataDigest;
+  fingerprint.m_impl->m_contentDigest = contentDigest;
+  return true;
+}
+catch (...)
+{
+  return false;
+}
+
+/**
+Sets how many bytes of embedded data, e.g., pictures, may be kept between
+parses, or 0 for none, which is the default. The data are kept in a store
+that all parses of the process share. Data found there are not decoded
+again, and all documents that contain the same picture share its memory.
+When data are added, those used least recently are dropped until the store
+is within the limit. A lower limit drops data right away; 0 empties the
+store. Parses that are running keep the data they have got.
+\param limit The size of the store in bytes
+*/
+ABWAPI void libabw::AbiDocument::setSharedDataLimit(const unsigned long limit)
+{
+  ABW_DEBUG_MSG(("AbiDocument::setSharedDataLimit: %lu\n", limit));
+  libabw::setSharedDataLimit(limit);
+}
+
 /* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -28,6 +28,11 @@
 $ARGV0 = shift @ARGV;
 $ARGV1 = shift @ARGV;
 $ARGV2 = shift @ARGV;
+$ARGV3 = shift @ARGV;
+
+# prefix of the generated constants; the XML tokens use the default
+$prefix = defined($ARGV3) ? $ARGV3 : "XML";
+$struct = lc($prefix)."token";
 
 open ( TOKENS, $ARGV0 ) || die "can't open token file: $!";
 my %tokens;
@@ -40,7 +45,7 @@ while ( defined ($line = <TOKENS>) )
         @token = split(/\s+/,$line);
         if ( not defined ($token[1]) )
         {
-            $token[1] = "XML_".$token[0];
+            $token[1] = $prefix."_".$token[0];
             $token[1] =~ tr/\-\.\:/___/;
             $token[1] =~ s/\+/PLUS/g;
             $token[1] =~ s/\-/MINUS/g;
@@ -58,14 +63,14 @@ print ( GPERF "%language=C++\n" );
 print ( GPERF "%global-table\n" );
 print ( GPERF "%null-strings\n" );
 print ( GPERF "%struct-type\n" );
-print ( GPERF "struct xmltoken\n" );
+print ( GPERF "struct $struct\n" );
 print ( GPERF "{\n" );
 print ( GPERF "  const char *name;\n  int tokenId;\n" );
 print ( GPERF "};\n" );
 print ( GPERF "%%\n" );
 
-print ( HXX "#ifndef __ABWXMLTOKENS_HXX__\n" );
-print ( HXX "#define __ABWXMLTOKENS_HXX__\n" );
+print ( HXX "#ifndef __ABW".$prefix."TOKENS_HXX__\n" );
+print ( HXX "#define __ABW".$prefix."TOKENS_HXX__\n" );
 print ( HXX "\n" );
 
 $i = 0;
@@ -77,9 +82,9 @@ foreach( sort(keys(%tokens)) )
 }
 print ( GPERF "%%\n" );
 print ( HXX "\n" );
-print ( HXX "const int XML_TOKEN_COUNT = $i;\n" );
+print ( HXX "const int ".$prefix."_TOKEN_COUNT = $i;\n" );
 print ( HXX "\n" );
-print ( HXX "const int XML_TOKEN_INVALID = -1;\n" );
+print ( HXX "const int ".$prefix."_TOKEN_INVALID = -1;\n" );
 print ( HXX "\n" );
 print ( HXX "#endif\n" );
 close ( HXX );
@@ -0,0 +1,257 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/* Checks findInt, findDouble and findBool against the results of the
+ * boost::spirit grammars they replaced. The expected doubles are those
+ * the grammars gave, printed with all their digits, so they are compared
+ * exactly.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "ABWCollector.h"
+
+namespace
+{
+
+struct IntCase
+{
+  const char *str;
+  bool isValid;
+  int value;
+};
+
+const IntCase INT_CASES[] =
+{
+  { "0", true, 0 },
+  { "42", true, 42 },
+  { "-42", true, -42 },
+  { "+42", true, 42 },
+  { " 7 ", true, 7 },
+  { "\t-3\n", true, -3 },
+  { "007", true, 7 },
+  { "2147483647", true, 2147483647 },
+  { "-2147483648", true, -2147483647 - 1 },
+  // out of range
+  { "2147483648", false, 0 },
+  { "-2147483649", false, 0 },
+  // trailing or leading junk
+  { "12a", false, 0 },
+  { "a12", false, 0 },
+  { "1 2", false, 0 },
+  { "1.5", false, 0 },
+  { "0x10", false, 0 },
+  // no number
+  { "", false, 0 },
+  { "   ", false, 0 },
+  { "-", false, 0 },
+  { "+", false, 0 },
+  { "- 5", false, 0 }
+};
+
+struct DoubleCase
+{
+  const char *str;
+  bool isValid;
+  double value;
+  libabw::ABWUnit unit;
+};
+
+// a number without a unit is taken for a fraction
+const DoubleCase DOUBLE_CASES[] =
+{
+  { "1", true, 1, libabw::ABW_PERCENT },
+  { "0", true, 0, libabw::ABW_PERCENT },
+  { "-0", true, -0.0, libabw::ABW_PERCENT },
+  { "1.5", true, 1.5, libabw::ABW_PERCENT },
+  { "5.", true, 5, libabw::ABW_PERCENT },
+  { "0.1", true, 0.10000000000000001, libabw::ABW_PERCENT },
+  { "3.14159265358979", true, 3.14159265358979, libabw::ABW_PERCENT },
+  { "100000000000000000000", true, 1e+20, libabw::ABW_PERCENT },
+  // every unit, converted to inches
+  { "1in", true, 1, libabw::ABW_IN },
+  { "1inch", true, 1, libabw::ABW_IN },
+  { " 3 in ", true, 3, libabw::ABW_IN },
+  { "2.54cm", true, 1, libabw::ABW_IN },
+  { "-2.54cm", true, -1, libabw::ABW_IN },
+  { "-.25cm", true, -0.098425196850393692, libabw::ABW_IN },
+  { "0.000001cm", true, 3.9370078740157475e-07, libabw::ABW_IN },
+  { "25.4mm", true, 1, libabw::ABW_IN },
+  { "12.7 mm", true, 0.5, libabw::ABW_IN },
+  { "6pi", true, 1, libabw::ABW_IN },
+  { "1.5pi", true, 0.25, libabw::ABW_IN },
+  { "72pt", true, 1, libabw::ABW_IN },
+  { "36 pt", true, 0.5, libabw::ABW_IN },
+  { "123456789.123456789pt", true, 1714677.6267146775, libabw::ABW_IN },
+  { "72px", true, 1, libabw::ABW_IN },
+  { "9px", true, 0.125, libabw::ABW_IN },
+  { "50%", true, 0.5, libabw::ABW_PERCENT },
+  { "12.5 %", true, 0.125, libabw::ABW_PERCENT },
+  // signs and exponents
+  { "-1.5in", true, -1.5, libabw::ABW_IN },
+  { "+.5in", true, 0.5, libabw::ABW_IN },
+  { "1e2pt", true, 1.3888888888888888, libabw::ABW_IN },
+  { "1E+2px", true, 1.3888888888888888, libabw::ABW_IN },
+  { "2.5e-1in", true, 0.25, libabw::ABW_IN },
+  { "-1e-3mm", true, -3.9370078740157485e-05, libabw::ABW_IN },
+  { "12e3", true, 12000, libabw::ABW_PERCENT },
+  { "1e", false, 0, libabw::ABW_NONE },
+  { "1e+", false, 0, libabw::ABW_NONE },
+  { "1ein", false, 0, libabw::ABW_NONE },
+  { "e5", false, 0, libabw::ABW_NONE },
+  // trailing junk
+  { "1x", false, 0, libabw::ABW_NONE },
+  { "3cmx", false, 0, libabw::ABW_NONE },
+  { "3 c m", false, 0, libabw::ABW_NONE },
+  { "1.2.3", false, 0, libabw::ABW_NONE },
+  { "12pt;", false, 0, libabw::ABW_NONE },
+  { "1in 2in", false, 0, libabw::ABW_NONE },
+  { "1 .5in", false, 0, libabw::ABW_NONE },
+  { "1. 5in", false, 0, libabw::ABW_NONE },
+  // no number
+  { "", false, 0, libabw::ABW_NONE },
+  { "  ", false, 0, libabw::ABW_NONE },
+  { ".", false, 0, libabw::ABW_NONE },
+  { "-", false, 0, libabw::ABW_NONE },
+  { "+", false, 0, libabw::ABW_NONE },
+  { "- 1in", false, 0, libabw::ABW_NONE },
+  { "in", false, 0, libabw::ABW_NONE },
+  { "%", false, 0, libabw::ABW_NONE }
+};
+
+struct BoolCase
+{
+  const char *str;
+  bool isValid;
+  bool value;
+};
+
+const BoolCase BOOL_CASES[] =
+{
+  { "true", true, true },
+  { "false", true, false },
+  { "yes", true, true },
+  { "no", true, false },
+  { "TRUE", true, true },
+  { "FALSE", true, false },
+  { " true ", true, true },
+  { "\tno\n", true, false },
+  { "True", false, false },
+  { "truex", false, false },
+  { "tru", false, false },
+  { "yes no", false, false },
+  { "1", false, false },
+  { "0", false, false },
+  { "", false, false },
+  { "  ", false, false }
+};
+
+unsigned checkInts()
+{
+  unsigned failures = 0;
+  for (std::size_t i = 0; i < sizeof(INT_CASES) / sizeof(INT_CASES[0]); ++i)
+  {
+    const IntCase &c = INT_CASES[i];
+    int value = 0;
+    const bool isValid = libabw::findInt(c.str, value);
+    int stringValue = 0;
+    const bool isStringValid = libabw::findInt(std::string(c.str), stringValue);
+    if (isValid != c.isValid || isStringValid != isValid || (isValid && (value != c.value || stringValue != value)))
+    {
+      fprintf(stderr, "findInt(\"%s\"): got %d %d, expected %d %d\n", c.str, int(isValid), value, int(c.isValid), c.value);
+      ++failures;
+    }
+  }
+  return failures;
+}
+
+unsigned checkDoubles()
+{
+  unsigned failures = 0;
+  for (std::size_t i = 0; i < sizeof(DOUBLE_CASES) / sizeof(DOUBLE_CASES[0]); ++i)
+  {
+    const DoubleCase &c = DOUBLE_CASES[i];
+    double value = 0;
+    libabw::ABWUnit unit = libabw::ABW_NONE;
+    const bool isValid = libabw::findDouble(c.str, value, unit);
+    double stringValue = 0;
+    libabw::ABWUnit stringUnit = libabw::ABW_NONE;
+    const bool isStringValid = libabw::findDouble(std::string(c.str), stringValue, stringUnit);
+    if (isValid != c.isValid || isStringValid != isValid
+        || (isValid && (value != c.value || unit != c.unit || stringValue != value || stringUnit != unit)))
+    {
+      fprintf(stderr, "findDouble(\"%s\"): got %d %.17g %d, expected %d %.17g %d\n",
+              c.str, int(isValid), value, int(unit), int(c.isValid), c.value, int(c.unit));
+      ++failures;
+    }
+  }
+  return failures;
+}
+
+unsigned checkBools()
+{
+  unsigned failures = 0;
+  for (std::size_t i = 0; i < sizeof(BOOL_CASES) / sizeof(BOOL_CASES[0]); ++i)
+  {
+    const BoolCase &c = BOOL_CASES[i];
+    bool value = false;
+    const bool isValid = libabw::findBool(c.str, value);
+    if (isValid != c.isValid || (isValid && value != c.value))
+    {
+      fprintf(stderr, "findBool(\"%s\"): got %d %d, expected %d %d\n", c.str, int(isValid), int(value), int(c.isValid), int(c.value));
+      ++failures;
+    }
+  }
+  return failures;
+}
+
+/* Only the given length of a string is parsed, and nothing is taken
+ * from nowhere.
+ */
+unsigned checkLengths()
+{
+  unsigned failures = 0;
+  int intValue = 0;
+  if (!libabw::findInt("12;34", 2, intValue) || intValue != 12 || libabw::findInt("12;34", 3, intValue))
+  {
+    fprintf(stderr, "findInt: the length is not kept to\n");
+    ++failures;
+  }
+  double value = 0;
+  libabw::ABWUnit unit = libabw::ABW_NONE;
+  if (!libabw::findDouble("72pt; 1in", 4, value, unit) || value != 1 || unit != libabw::ABW_IN
+      || libabw::findDouble("72pt; 1in", 5, value, unit))
+  {
+    fprintf(stderr, "findDouble: the length is not kept to\n");
+    ++failures;
+  }
+  const char *const null = 0;
+  bool boolValue = false;
+  if (libabw::findInt(null, intValue) || libabw::findDouble(null, value, unit) || libabw::findBool(null, boolValue)
+      || libabw::findInt("1", 0, intValue) || libabw::findDouble("1", 0, value, unit))
+  {
+    fprintf(stderr, "a missing or empty string is taken for a number\n");
+    ++failures;
+  }
+  return failures;
+}
+
+}
+
+int main()
+{
+  const unsigned failures = checkInts() + checkDoubles() + checkBools() + checkLengths();
+  printf("numbers: %u failures\n", failures);
+  return failures ? 1 : 0;
+}
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */
@@ -0,0 +1,343 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * This file is part of the libabw project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/* Checks that ABWStylesScanner collects the same as reading the document
+ * with libxml does, on a few samples and on many mutations of them. The
+ * section offsets libxml gives are only rough, so those of the scanner are
+ * checked to point at the sections instead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <librevenge/librevenge.h>
+#include "ABWCollector.h"
+#include "ABWMemoryStream.h"
+#include "ABWParser.h"
+#include "ABWPropertyMap.h"
+#include "ABWStylesCollector.h"
+#include "ABWStylesScanner.h"
+
+namespace
+{
+
+const char *const PROLOGUE =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<!DOCTYPE abiword PUBLIC \"-//ABISOURCE//DTD AWML 1.0 Strict//EN\" \"http://www.abisource.com/awml.dtd\">\n";
+
+const char *const ROOT =
+  "<abiword template=\"false\" xmlns:fo=\"http://www.w3.org/1999/XSL/Format\" xmlns=\"http://www.abisource.com/awml.dtd\""
+  " xmlns:awml=\"http://www.abisource.com/awml.dtd\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" fileformat=\"1.1\""
+  " version=\"3.0.0\" xml:space=\"preserve\" props=\"dom-dir:ltr; lang:en-US\">\n";
+
+const char *const SAMPLES[] =
+{
+  // lists, tables and the data
+  "<metadata>\n<m key=\"dc.title\">Lists &amp; tables</m>\n</metadata>\n"
+  "<history version=\"2\"><version id=\"1\" started=\"1\" uid=\"y\" auto=\"0\" top-xid=\"5\"/></history>\n"
+  "<revisions><r id=\"1\" time-started=\"1\">rev <p listid=\"9\">x</p></r></revisions>\n"
+  "<styles>\n<s type=\"P\" name=\"Normal\" props=\"font-size:12pt; margin-left:0pt\"/>\n</styles>\n"
+  "<lists>\n<l id=\"1\" parentid=\"0\" type=\"0\" start-value=\"1\" list-delim=\"%L.\" list-decimal=\".\"/>\n"
+  "<l id=\"2\" parentid=\"1\" type=\"5\" start-value=\"0\" list-delim=\"%L\" list-decimal=\"NULL\"/>\n"
+  "<l id=\"3\" parentid=\"0\" type=\"3\" start-value=\"4\" list-delim=\"(%L)\"/>\n</lists>\n"
+  "<pagesize pagetype=\"A4\" orientation=\"portrait\" width=\"210.0\" height=\"297.0\" units=\"mm\" page-scale=\"1.0\"/>\n"
+  "<section props=\"page-margin-top:1in; page-margin-bottom:1in\">\n"
+  "<p style=\"Normal\" listid=\"1\" level=\"1\" props=\"list-style:Numbered List; margin-left:0.5in\"><c>one</c></p>\n"
+  "<p listid=\"2\" level=\"2\" props=\"list-style:Bullet List; text-indent:-0.3in\">two &#233; &#x1F600;</p>\n"
+  "<p listid=\"3\" level=\"1\" props=\"list-style:Upper Roman List; start-value:4\"/>\n"
+  "<table props=\"table-column-props:1in/2in/\">\n"
+  "<cell props=\"left-attach:0; right-attach:1; top-attach:0; bot-attach:1\"><p>a</p></cell>\n"
+  "<cell props=\"left-attach:1; right-attach:3; top-attach:0; bot-attach:1\"><table><cell props=\"left-attach:0; right-attach:2\"/></table></cell>\n"
+  "</table>\n<p><image dataid=\"img1\" props=\"width:1in; height:1in\"/></p>\n"
+  "</section>\n"
+  "<section props=\"columns:2\">\n<p listid=\"2\" level=\"3\">three</p>\n<table><cell props=\"right-attach:4\"/></table>\n</section>\n"
+  "<data>\n"
+  "<d name=\"img1\" mime-type=\"image/png\" base64=\"yes\">\niVBORw0KGgo=\nAAAADUlIRFI=\n</d>\n"
+  "<d name=\"txt\" mime-type=\"text/plain\" base64=\"no\">x &lt; y\r\nz</d>\n"
+  "<d name=\"svg\" mime-type=\"image/svg+xml\" base64=\"no\">\n<![CDATA[<svg>&amp;\r\n</svg>]]>\n</d>\n"
+  "<d name=\"empty\" mime-type=\"image/png\" base64=\"yes\"/>\n"
+  "<d name=\"blank\" base64=\"yes\">  \n  </d>\n"
+  "</data>\n",
+
+  // headers and footers
+  "<styles><s type=\"C\" name=\"Emphasis\" props=\"font-style:italic\"/></styles>\n"
+  "<section id=\"0\" header=\"1\" footer=\"2\" props=\"page-margin-header:0.5in\">\n"
+  "<p>body<field type=\"page_number\"/></p>\n<table><cell props=\"left-attach:0; right-attach:1\"><p>b</p></cell></table>\n"
+  "</section>\n"
+  "<section id=\"1\" type=\"header\">\n<table><cell props=\"left-attach:0; right-attach:2; top-attach:0\"/>"
+  "<cell props=\"left-attach:2; right-attach:5; top-attach:0\"/></table>\n<p>header</p>\n</section>\n"
+  "<section id=\"2\" type=\"footer\">\n<p>footer<!-- comment --><?pi data?></p>\n<table/>\n</section>\n"
+  "<section id=\"3\" type=\"header-first\"><table><cell props=\"right-attach:2\"/></table></section>\n",
+
+  // nothing but text
+  "<section>\n<p>only text\twith\ttabs</p>\n<p props=\"margin-left:1in\"><c props=\"font-weight:bold\">bold</c></p>\n</section>\n"
+  "<section type=\"footer\" id=\"9\"><p>f</p></section>\n"
+};
+
+// these have to be read with libxml
+const char *const FALLBACK_SAMPLES[] =
+{
+  "<?xml version=\"1.0\"?>\n<!DOCTYPE abiword [<!ENTITY e \"entity\">]>\n"
+  "<abiword><section><p>&e;</p></section></abiword>\n",
+  "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n<abiword><section><p>\xe9</p></section></abiword>\n",
+  "<?xml version=\"1.0\"?>\n<abiword xmlns:q=\"urn:q\"><q:lists/><section><p>x</p></section></abiword>\n",
+  "<?xml version=\"1.0\"?>\n<abiword><section><p><![CDATA[text]]></p></section></abiword>\n"
+};
+
+// well-formed pieces, inserted before a tag
+const char *const FRAGMENTS[] =
+{
+  "<p>a &amp; b &#233; &#x1F600;</p>",
+  "<!-- fine -->",
+  "<?pi data?>",
+  "<p listid='2' level='3' props='margin-left:1in; text-indent:-0.5in'/>",
+  "<table><cell props='left-attach:0; right-attach:3; top-attach:0'/><cell props='left-attach:3; right-attach:4'></cell></table>",
+  "<d name='g' base64='no'>x &lt; y\r\nz</d>",
+  "<d name='h' mime-type='image/svg+xml' base64='no'>\n<![CDATA[<svg>&</svg>]]>\n</d>",
+  "<d name='img2' base64='yes'>QUJD\nREVG</d>",
+  "<d name='e'/>",
+  "<d name='ws'>   \n  </d>",
+  "<l id='7' parentid='1' type='4' list-delim='[%L]'/>",
+  "<p listid='7' level='1'>t</p>",
+  "<section type='footer' id='f9'><table/></section>",
+  "<section type='header' id='1'><table><cell props='right-attach:7'/></table></section>",
+  "<section props='x:y'><p>s</p></section>",
+  "<history><p listid='1'/></history>",
+  "<x a='1' b=\"2\" c = '3'/>",
+  "<y xmlns:q='u' q:a='1'>text\twith\ttabs</y>",
+  "<c props='a&#10;b'>\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80</c>",
+  "\r\n"
+};
+
+// anything, well-formed or not
+const char *const TOKENS[] =
+{
+  "&amp;", "&#10;", "&foo;", "&#0;", "&#xD800;", "&#x110000;", "&", "&#;",
+  "<![CDATA[x]]>", "<![CDATA[]]>", "<!-- a -- b -->", "<!--->", "<?xml version='1.0'?>",
+  "\r", "\t", "\xef\xbb\xbf", "\x01", "\xff", "\xe2\x82", "\xed\xa0\x80", "\xc0\xaf",
+  "<x:p>", "</x:p>", "<p>", "</p>", "<table>", "</table>", "<cell/>", "<section>", "</section>",
+  "<d name='n'>", "</d>", "<d>", "]]>", " a=\"1\" a=\"2\"", " xmlns:a=\"u\" xmlns:b=\"u\" a:x=\"1\" b:x=\"2\"",
+  "<!DOCTYPE x>", "<", ">", "/>", "'", "\"", "=", " ", "<!", "<?", "</", "<![CDATA["
+};
+
+const unsigned MUTATIONS_PER_SAMPLE = 3000;
+
+unsigned long g_random = 1;
+
+unsigned long getRandom(unsigned long limit)
+{
+  g_random = (g_random * 1103515245 + 12345) & 0xffffffff;
+  return limit ? (g_random >> 8) % limit : 0;
+}
+
+template<typename T, std::size_t N>
+std::size_t getSize(T (&)[N])
+{
+  return N;
+}
+
+std::string makeDocument(const char *body)
+{
+  return std::string(PROLOGUE) + ROOT + body + "</abiword>\n";
+}
+
+std::string mutate(const std::string &document)
+{
+  std::string mutated(document);
+  const std::size_t root = mutated.find('>', mutated.find("<abiword")) + 1;
+  for (unsigned long count = getRandom(4) + 1; count > 0; --count)
+  {
+    const std::size_t pos = root + getRandom(mutated.size() - root + 1);
+    const unsigned long kind = getRandom(10);
+    if (kind < 5)
+    {
+      const std::size_t tag = mutated.find('<', pos);
+      if (tag != std::string::npos)
+        mutated.insert(tag, FRAGMENTS[getRandom(getSize(FRAGMENTS))]);
+    }
+    else if (kind < 7)
+      mutated.insert(pos, TOKENS[getRandom(getSize(TOKENS))]);
+    else if (kind == 7)
+      mutated.erase(pos, getRandom(8) + 1);
+    else if (kind == 8 && pos < mutated.size())
+      mutated[pos] = char(getRandom(256));
+    else
+      mutated.erase(pos);
+  }
+  return mutated;
+}
+
+struct Parts
+{
+  Parts()
+    : m_tableSizes(), m_data(), m_listElements(), m_headerFooterTableIds(),
+      m_sectionTableIds(), m_sectionOffsets(), m_propertyCache() {}
+  ~Parts()
+  {
+    for (std::map<int, libabw::ABWListElement *>::iterator iter = m_listElements.begin(); iter != m_listElements.end(); ++iter)
+      delete iter->second;
+  }
+
+  std::map<int, int> m_tableSizes;
+  std::map<std::string, libabw::ABWData> m_data;
+  std::map<int, libabw::ABWListElement *> m_listElements;
+  std::vector<int> m_headerFooterTableIds;
+  std::vector<int> m_sectionTableIds;
+  std::vector<unsigned long> m_sectionOffsets;
+  libabw::ABWPropertyCache m_propertyCache;
+
+private:
+  Parts(const Parts &);
+  Parts &operator=(const Parts &);
+};
+
+std::string dump(const Parts &parts)
+{
+  std::ostringstream out;
+  for (std::map<int, int>::const_iterator iter = parts.m_tableSizes.begin(); iter != parts.m_tableSizes.end(); ++iter)
+    out << "table " << iter->first << ": " << iter->second << "\n";
+  for (std::map<std::string, libabw::ABWData>::const_iterator iter = parts.m_data.begin(); iter != parts.m_data.end(); ++iter)
+  {
+    librevenge::RVNGPropertyList propList;
+    iter->second.writeOut(propList);
+    out << "data " << iter->first << ": " << iter->second.m_mimeType.cstr() << " "
+        << (propList["office:binary-data"] ? propList["office:binary-data"]->getStr().cstr() : "-") << "\n";
+  }
+  for (std::map<int, libabw::ABWListElement *>::const_iterator iter = parts.m_listElements.begin(); iter != parts.m_listElements.end(); ++iter)
+  {
+    out << "list " << iter->first << ":";
+    if (iter->second)
+    {
+      librevenge::RVNGPropertyList propList;
+      iter->second->writeOut(propList);
+      librevenge::RVNGPropertyList::Iter prop(propList);
+      for (prop.rewind(); prop.next();)
+        out << " " << prop.key() << "=" << prop()->getStr().cstr();
+      out << " id=" << iter->second->m_listId << " parent=" << iter->second->m_parentId
+          << " level=" << iter->second->m_listLevel;
+    }
+    out << "\n";
+  }
+  out << "header/footer tables:";
+  for (std::size_t i = 0; i < parts.m_headerFooterTableIds.size(); ++i)
+    out << " " << parts.m_headerFooterTableIds[i];
+  out << "\nsection tables:";
+  for (std::size_t i = 0; i < parts.m_sectionTableIds.size(); ++i)
+    out << " " << parts.m_sectionTableIds[i];
+  out << "\nsections: " << parts.m_sectionOffsets.size() << "\n";
+  return out.str();
+}
+
+bool scan(const std::string &document, Parts &parts)
+{
+  libabw::ABWMemoryStream input(reinterpret_cast<const unsigned char *>(document.data()), document.size());
+  libabw::ABWStylesCollector collector(parts.m_tableSizes, parts.m_data, parts.m_listElements,
+                                       parts.m_headerFooterTableIds, parts.m_sectionTableIds, parts.m_propertyCache);
+  libabw::ABWStylesScanner scanner(&input, collector);
+  return scanner.scan(&parts.m_sectionOffsets);
+}
+
+bool readWithLibxml(const std::string &document, Parts &parts)
+{
+  libabw::ABWMemoryStream input(reinterpret_cast<const unsigned char *>(document.data()), document.size());
+  libabw::ABWStylesCollector collector(parts.m_tableSizes, parts.m_data, parts.m_listElements,
+                                       parts.m_headerFooterTableIds, parts.m_sectionTableIds, parts.m_propertyCache);
+  libabw::ABWParser parser(&input, 0);
+  return parser.readStyles(collector, &parts.m_sectionOffsets);
+}
+
+enum Result
+{
+  RESULT_SAME,
+  RESULT_NOT_SCANNED,
+  RESULT_NOT_READ,
+  RESULT_DIFFERENT
+};
+
+Result check(const std::string &document, const char *name)
+{
+  Parts scanned;
+  if (!scan(document, scanned))
+    return RESULT_NOT_SCANNED;
+  // the scanner does not look at the body, which libxml may not be able to read
+  Parts read;
+  if (!readWithLibxml(document, read))
+    return RESULT_NOT_READ;
+
+  const std::string scannedDump = dump(scanned);
+  const std::string readDump = dump(read);
+  bool isSame = scannedDump == readDump;
+  for (std::size_t i = 0; i < scanned.m_sectionOffsets.size(); ++i)
+  {
+    const unsigned long offset = scanned.m_sectionOffsets[i];
+    if ((i > 0 && offset <= scanned.m_sectionOffsets[i - 1]) || document.compare(offset, 8, "<section") != 0)
+    {
+      fprintf(stderr, "%s: section %u is not at %lu\n", name, unsigned(i), offset);
+      isSame = false;
+    }
+  }
+  if (isSame)
+    return RESULT_SAME;
+
+  fprintf(stderr, "%s: the scanner and libxml differ\n--- scanner\n%s--- libxml\n%s--- document\n%s\n",
+          name, scannedDump.c_str(), readDump.c_str(), document.c_str());
+  return RESULT_DIFFERENT;
+}
+
+}
+
+int main()
+{
+  unsigned failures = 0;
+  unsigned results[RESULT_DIFFERENT + 1] = {0, 0, 0, 0};
+
+  for (std::size_t i = 0; i < getSize(SAMPLES); ++i)
+  {
+    char name[32];
+    sprintf(name, "sample %u", unsigned(i));
+    const std::string document = makeDocument(SAMPLES[i]);
+    const Result result = check(document, name);
+    if (RESULT_SAME != result)
+    {
+      if (RESULT_DIFFERENT != result)
+        fprintf(stderr, "%s: not read\n", name);
+      ++failures;
+    }
+
+    for (unsigned j = 0; j < MUTATIONS_PER_SAMPLE; ++j)
+    {
+      sprintf(name, "sample %u, mutation %u", unsigned(i), j);
+      const Result mutatedResult = check(mutate(document), name);
+      ++results[mutatedResult];
+      if (RESULT_DIFFERENT == mutatedResult)
+        ++failures;
+    }
+  }
+
+  for (std::size_t i = 0; i < getSize(FALLBACK_SAMPLES); ++i)
+  {
+    Parts parts;
+    if (scan(FALLBACK_SAMPLES[i], parts))
+    {
+      fprintf(stderr, "fallback sample %u: scanned\n", unsigned(i));
+      ++failures;
+    }
+  }
+
+  printf("mutations: %u same, %u not scanned, %u not read, %u different\n",
+         results[RESULT_SAME], results[RESULT_NOT_SCANNED], results[RESULT_NOT_READ], results[RESULT_DIFFERENT]);
+  return failures ? 1 : 0;
+}
+
+/* vim:set shiftwidth=2 softtabstop=2 expandtab: */